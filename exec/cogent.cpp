@@ -10,10 +10,15 @@
 #endif
 
 #include "parstream.H"
+#include "MayDay.H"
 #ifdef CH_MPI
 #include "CH_Attach.H"
 #endif
 
+#include <fstream>
+#include <sstream>
+#include <string>
+
 #include "UsingNamespace.H"
 
 inline int checkCommandLineArgs( int a_argc, char* a_argv[] )
@@ -27,6 +32,42 @@ inline int checkCommandLineArgs( int a_argc, char* a_argv[] )
    return 0;
 }
 
+// Returns true if simulation.async_checkpoint is set to true in the input
+// file or on the command line.  The thread support requested from MPI
+// depends on it, so it is read before MPI, and hence ParmParse, is started.
+inline bool asyncCheckpointRequested( int a_argc, char* a_argv[] )
+{
+   const std::string key("simulation.async_checkpoint");
+   bool requested = false;
+
+   std::string text;
+   if (a_argc>1) {
+      std::ifstream in( a_argv[1] );
+      std::string line;
+      while ( std::getline( in, line ) ) {
+         text += line.substr( 0, line.find('#') ) + "\n";
+      }
+   }
+   for (int n=2; n<a_argc; n++) {
+      text += std::string( a_argv[n] ) + "\n";
+   }
+
+   // As in ParmParse, the last definition wins
+   std::string::size_type pos = text.find( key );
+   while ( pos != std::string::npos ) {
+      std::istringstream definition( text.substr( pos + key.size() ) );
+      char equals = 0;
+      std::string value;
+      definition >> equals >> value;
+      if ( equals == '=' ) {
+         requested = ( value == "true" || value == "1" );
+      }
+      pos = text.find( key, pos + key.size() );
+   }
+
+   return requested;
+}
+
 #ifdef with_petsc
 static const char help[] = "COGENT";
 
@@ -42,9 +83,22 @@ bool parseParams( ParmParse &a_pp)
 int main( int a_argc, char* a_argv[] )
 {
 #ifdef CH_MPI
-   // Start MPI
-   MPI_Init( &a_argc, &a_argv );
+   // Start MPI.  Only the master thread of the OpenMP regions calls MPI,
+   // unless the distribution functions of checkpoints are written by a
+   // helper thread, which needs full thread support.
+   const int required_support = asyncCheckpointRequested( a_argc, a_argv )?
+      MPI_THREAD_MULTIPLE: MPI_THREAD_FUNNELED;
+   int thread_support;
+   MPI_Init_thread( &a_argc, &a_argv, required_support, &thread_support );
    setChomboMPIErrorHandler();
+   if (thread_support < required_support) {
+      if (required_support == MPI_THREAD_MULTIPLE) {
+         MayDay::Error( "MPI does not provide MPI_THREAD_MULTIPLE, needed by simulation.async_checkpoint" );
+      }
+      else {
+         MayDay::Error( "MPI does not provide MPI_THREAD_FUNNELED" );
+      }
+   }
 #endif
 
 #ifdef with_petsc
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+
+""" Reads the binary field history file written by the history probes
+(simulation.history_file, "field_history.bin" by default).
+
+By default, writes for probe N the files <field>_hist_<N>.curve (time and
+value, for VisIt) and <field>_hist_<N>.txt (step, time and value), the text
+files written by earlier versions of the code.  With --list, only prints
+the probes.
+
+The file starts with the 8 characters "GKHIST01", the int32 configuration
+dimension and the int32 number of probes, followed for each probe by a
+32-character null-padded label, the int32 component, the int32 flux-surface
+average flag and the int32 grid indices.  Each record is then the int64
+step, the float64 time and the float64 value of every probe.  The file is
+written in the byte order of the machine that ran the simulation.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = b"GKHIST01"
+
+
+class FieldHistory(object):
+    """ The probes and records of a field history file. """
+
+    def __init__(self, filename, byte_order="="):
+        with open(filename, "rb") as stream:
+            data = stream.read()
+
+        if data[:8] != MAGIC:
+            raise ValueError("%s is not a field history file" % filename)
+
+        offset = 8
+        dim, num_probes = struct.unpack_from(byte_order + "ii", data, offset)
+        offset += 8
+
+        self.probes = []
+        for n in range(num_probes):
+            label = data[offset:offset + 32].split(b"\0")[0].decode()
+            offset += 32
+            values = struct.unpack_from(byte_order + "%di" % (2 + dim), data, offset)
+            offset += 4 * (2 + dim)
+            self.probes.append({"label": label,
+                                "field": label.split(".")[0],
+                                "component": values[0],
+                                "flux_surface_average": values[1] != 0,
+                                "indices": list(values[2:])})
+
+        # A trailing partial record (interrupted run) is ignored
+        record = struct.Struct(byte_order + "qd%dd" % num_probes)
+        num_records = (len(data) - offset) // record.size
+        self.steps = []
+        self.times = []
+        self.values = [[] for n in range(num_probes)]
+        for r in range(num_records):
+            values = record.unpack_from(data, offset + r * record.size)
+            self.steps.append(values[0])
+            self.times.append(values[1])
+            for n in range(num_probes):
+                self.values[n].append(values[2 + n])
+
+    def write_text_files(self, directory="."):
+        """ Writes the .curve and .txt files of every probe. """
+        for n, probe in enumerate(self.probes):
+            base = os.path.join(directory, "%s_hist_%d" % (probe["field"], n + 1))
+            location = ", ".join(str(i) for i in probe["indices"])
+
+            with open(base + ".curve", "w") as curve:
+                curve.write("# %s\n" % location)
+                for time, value in zip(self.times, self.values[n]):
+                    curve.write("%.16g %.16g\n" % (time, value))
+
+            with open(base + ".txt", "w") as text:
+                text.write("# step  time  %s at %s\n" % (probe["label"], location))
+                for step, time, value in zip(self.steps, self.times, self.values[n]):
+                    text.write("%d %.16g %.16g\n" % (step, time, value))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("filename", nargs="?", default="field_history.bin",
+                        help="history file (default: field_history.bin)")
+    parser.add_argument("--list", action="store_true",
+                        help="only print the probes and the number of records")
+    parser.add_argument("--directory", default=".",
+                        help="directory of the text files (default: .)")
+    parser.add_argument("--big-endian", action="store_true",
+                        help="the file was written on a big-endian machine")
+    args = parser.parse_args()
+
+    history = FieldHistory(args.filename, ">" if args.big_endian else "<")
+
+    if args.list:
+        for n, probe in enumerate(history.probes):
+            print("%d: %s component %d at %s%s" %
+                  (n + 1, probe["label"], probe["component"], probe["indices"],
+                   " (flux surface average)" if probe["flux_surface_average"] else ""))
+        print("%d records" % len(history.steps))
+    else:
+        history.write_text_files(args.directory)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
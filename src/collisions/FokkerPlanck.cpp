@@ -9,6 +9,7 @@
 #include "KineticFunctionLibrary.H"
 #include "inspect.H"
 #include "ConstFact.H"
+#include "ThreadScratch.H"
 
 #include "FokkerPlanckF_F.H"
 
@@ -22,6 +23,8 @@ FokkerPlanck::FokkerPlanck( ParmParse& a_ppcls, const int a_verbosity )
      m_pcg_tol(1.0e-5),
      m_pcg_maxiter(100),
      m_mult_num(1),
+     m_rosenbluth_solver("hypre"),
+     m_compare_rosenbluth_solvers(false),
      m_nD(5),
      m_update_freq(-1),
      m_it_counter(0),
@@ -657,9 +660,22 @@ void FokkerPlanck::evalRosenbluthPotentials( LevelData<FArrayBox>& a_phi,
    }
 
 
+   //Direct velocity-space solver, whose factorizations are kept across calls
+   RosenbluthDirectSolver* direct_solver = NULL;
+   if ( m_rosenbluth_solver == "direct" ) {
+      const VEL::VelCoordSys& vel_coords = a_phase_geom.velSpaceCoordSys();
+      if ( m_rosenbluth_direct.isNull() ||
+           !m_rosenbluth_direct->conformsTo(vel_coords.domain(), vel_coords.dx(), a_mass) ) {
+         m_rosenbluth_direct = RefCountedPtr<RosenbluthDirectSolver>(
+            new RosenbluthDirectSolver(vel_coords.domain(), vel_coords.dx(), a_mass) );
+      }
+      direct_solver = &(*m_rosenbluth_direct);
+   }
+
    //Calculate Rosenbluth Potentials 
    RosenbluthPotentials RosenbluthPotentials(phi_one, phi_two, a_dfn, a_phase_geom, 
-                                             a_mass, m_pcg_tol, m_pcg_maxiter, m_mult_num, m_verbosity);
+                                             a_mass, m_pcg_tol, m_pcg_maxiter, m_mult_num, m_verbosity,
+                                             direct_solver, m_compare_rosenbluth_solvers);
 
    for (DataIterator dit( a_phi.dataIterator() ); dit.ok(); ++dit) {
       a_phi[dit].copy(phi_one[dit], grids[dit], 0 , grids[dit], 0, 1);
@@ -696,14 +712,20 @@ void FokkerPlanck::evalCoefficients( LevelData<FArrayBox>& a_D,
    FillGhostCells(a_phase_geom, phi_tmp);
    
    const LevelData<FArrayBox>& injected_B = a_phase_geom.getBFieldMagnitude();
-   for (DataIterator dit( a_D.dataIterator() ); dit.ok(); ++dit) {
-      
-      // Check if the have more than 4 cells on a box in MU_DIR 
-      // used for calcuation of second derivatives in mu at mu=0 bnd   
-      const Box& grid_box = grids[dit];
-      if (grid_box.size(3)<5) { 
-       MayDay::Error(" Box size in MU_DIR must be greater that 4 for FP operator calculations");
-      }  
+   DataIterator boxes( a_D.dataIterator() );
+
+   // Check if the have more than 4 cells on a box in MU_DIR 
+   // used for calcuation of second derivatives in mu at mu=0 bnd
+   // (outside of the threaded loop, which must not call MayDay)
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      if (grids[boxes[ibox]].size(3)<5) {
+         MayDay::Error(" Box size in MU_DIR must be greater that 4 for FP operator calculations");
+      }
+   }
+
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
 
       FArrayBox& this_D = a_D[dit];
       const FArrayBox& this_phi_tmp = phi_tmp[dit];
@@ -755,14 +777,20 @@ void FokkerPlanck::computeFlux( LevelData<FluxBox>& a_flux,
    //Compute cell-cenetered collision fluxes (0 comp - vpar_dir, 1 comp - mu_dir)
    LevelData<FArrayBox> flux_cell(grids, 2, IntVect::Zero);
 
-   for (DataIterator dit( a_dfn.dataIterator() ); dit.ok(); ++dit) {
-      
-      // Check if the have more than 4 cells on a box in MU_DIR 
-      // used for calcuation of second derivatives in mu at mu=0 bnd   
-      const Box& grid_box = grids[dit];
-      if (grid_box.size(3)<5) { 
-       MayDay::Error(" Box size in MU_DIR must be greater that 4 for FP operator calculations");
-      }  
+   DataIterator boxes( a_dfn.dataIterator() );
+
+   // Check if the have more than 4 cells on a box in MU_DIR 
+   // used for calcuation of second derivatives in mu at mu=0 bnd
+   // (outside of the threaded loop, which must not call MayDay)
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      if (grids[boxes[ibox]].size(3)<5) {
+         MayDay::Error(" Box size in MU_DIR must be greater that 4 for FP operator calculations");
+      }
+   }
+
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
 
       FArrayBox& this_flux_cell = flux_cell[dit];
       FArrayBox& this_dfn_tmp   = dfn_tmp[dit];
@@ -785,10 +813,19 @@ void FokkerPlanck::computeFlux( LevelData<FluxBox>& a_flux,
    convertToCellFaces(flux_face, flux_cell, a_phase_geom);
 
    //Create final (combined r , theta, mu, and v_par) flux
-   for (DataIterator dit(a_flux.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator face_boxes( a_flux.dataIterator() );
+   ThreadScratch scratch(1);
+   for (int ibox=0; ibox<face_boxes.size(); ibox++) {
+      scratch.reserve(0, grow(flux_cell[face_boxes[ibox]].box(),1), 2);
+   }
+   scratch.allocate();
+#pragma omp parallel for
+   for (int ibox=0; ibox<face_boxes.size(); ibox++) {
+      const DataIndex& dit( face_boxes[ibox] );
       const FArrayBox& this_flux_cell = flux_cell[dit];
 
-      FArrayBox tmp_flux_cell(grow(this_flux_cell.box(),1),2);
+      const Box tmp_box( grow(this_flux_cell.box(),1) );
+      FArrayBox tmp_flux_cell(tmp_box, 2, scratch.get(0, tmp_box, 2));
       tmp_flux_cell.setVal(0.);
       tmp_flux_cell.copy(this_flux_cell);
 
@@ -838,7 +875,10 @@ void FokkerPlanck::computeFluxCellCentered( LevelData<FArrayBox>& a_flux,
    dfn_tmp.exchange();
 
    //Compute cell-cenetered collision fluxes (0 comp - vpar_dir, 1 comp - mu_dir)
-   for (DataIterator dit( a_dfn.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( a_dfn.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       
       FArrayBox& this_flux_cell     = a_flux[dit];
       const FArrayBox& this_dfn_tmp = dfn_tmp[dit];
@@ -869,7 +909,10 @@ void FokkerPlanck::computeDivergence( LevelData<FArrayBox>& a_rhs,
    const int num_mu_cells   = domain_box.size(1);
 
    //Compute cell-cenetered divergence 
-   for (DataIterator dit( a_rhs.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( a_rhs.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       
       const FArrayBox& this_flux = a_flux[dit];
       FArrayBox& this_rhs  = a_rhs[dit];
@@ -1035,6 +1078,11 @@ void FokkerPlanck::parseParameters( ParmParse& a_ppcls )
    a_ppcls.query( "convergence_tolerance", m_pcg_tol );
    a_ppcls.query( "max_interation_number", m_pcg_maxiter);
    a_ppcls.query( "multipole_number", m_mult_num);
+   a_ppcls.query( "rosenbluth_solver", m_rosenbluth_solver);
+   a_ppcls.query( "compare_rosenbluth_solvers", m_compare_rosenbluth_solvers);
+   if ( m_rosenbluth_solver != "hypre" && m_rosenbluth_solver != "direct" ) {
+      MayDay::Error("FokkerPlanck: rosenbluth_solver must be \"hypre\" or \"direct\"");
+   }
 
    KineticFunctionLibrary* library = KineticFunctionLibrary::getInstance();
    std::string function_name;
@@ -1051,6 +1099,8 @@ void FokkerPlanck::printParameters()
       std::cout << "FokkerPlanck collisions parameters:" << std::endl;
       std::cout << "  cls_freq  =  " << m_cls_freq
                 << ", subtract_background = " << m_subtract_background;
+      std::cout << "  rosenbluth_solver = " << m_rosenbluth_solver
+                << ", compare_rosenbluth_solvers = " << m_compare_rosenbluth_solvers << std::endl;
       std::cout << "  Reference Function:" << std::endl;
       m_ref_func->printParameters();
    }
@@ -155,6 +155,32 @@ Real GKCollisions::computeTimeScale( const KineticSpeciesPtrVect& soln )
   return (count ? scale : -1);
 }
 
+void GKCollisions::localTimeScaleData( const KineticSpeciesPtrVect& soln,
+                                       std::vector<Real>&           data )
+{
+  std::map<std::string,int>::iterator it;
+  for (it=m_collision_model_name.begin(); it!=m_collision_model_name.end(); ++it) {
+    m_collision_model[it->second]->localTimeScaleData(soln, data);
+  }
+}
+
+void GKCollisions::computeDtAndTimeScale( const std::vector<Real>& data,
+                                          int&                     offset,
+                                          Real&                    dt,
+                                          Real&                    time_scale )
+{
+  dt = DBL_MAX;
+  Real scale = DBL_MAX;
+  int count = 0;
+  std::map<std::string,int>::iterator it;
+  for (it=m_collision_model_name.begin(); it!=m_collision_model_name.end(); ++it) {
+    dt = Min(dt, data[offset++]);
+    scale = Min(scale, data[offset++]);
+    count++;
+  }
+  time_scale = (count ? scale : -1);
+}
+
 bool GKCollisions::isLinear()
 {
   bool linear_flag = true;
@@ -166,6 +192,17 @@ bool GKCollisions::isLinear()
   return linear_flag;
 }
 
+bool GKCollisions::preTimeStepUsesPhysicalSolution()
+{
+  bool uses_physical = false;
+  std::map<std::string,int>::iterator it;
+  for (it=m_collision_model_name.begin(); it!=m_collision_model_name.end(); ++it) {
+    int index = getCollisionModelIndex( it );
+    uses_physical = (uses_physical || m_collision_model[index]->preTimeStepUsesPhysicalSolution());
+  }
+  return uses_physical;
+}
+
 int GKCollisions::precondMatrixBands()
 {
   int max_bands = 0;
@@ -28,6 +28,8 @@ Krook::Krook( ParmParse& a_ppcls, const int a_verbosity )
    }
 
    m_fixed_cls_freq = (m_cls_freq<0.0) ? false : true ;
+
+   m_ref_dfn.define( m_ref_func );
 }
 
 
@@ -48,9 +50,7 @@ void Krook::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
    const LevelData<FArrayBox>& soln_dfn( soln_species.distributionFunction() );
 
    // Create reference (J*Bstar_par*dfn_init) distribution
-   KineticSpeciesPtr ref_species( soln_species.clone( IntVect::Unit, false ) );
-   m_ref_func->assign( *ref_species, a_time );
-   const LevelData<FArrayBox>& init_dfn( ref_species->distributionFunction() );
+   const LevelData<FArrayBox>& init_dfn( m_ref_dfn.get( soln_species, a_time ) );
 
    //Create reference temperature distribution
    const PhaseGeom& phase_geom = soln_species.phaseSpaceGeometry();
@@ -77,7 +77,11 @@ void Krook::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
    // Compute the difference from the reference (or initial) solution
    const DisjointBoxLayout& grids( soln_dfn.getBoxes() );
    const int n_comp( soln_dfn.nComp() );
-   LevelData<FArrayBox> delta_F( grids, n_comp, IntVect::Zero );
+   if ( !m_delta_F.isDefined() || !(m_delta_F.getBoxes()==grids) || m_delta_F.nComp()!=n_comp ) {
+      m_delta_F.define( grids, n_comp, IntVect::Zero );
+      m_tp_rhs_coll.define( grids, n_comp, IntVect::Zero );
+   }
+   LevelData<FArrayBox>& delta_F( m_delta_F );
    
    for (DataIterator sdit(soln_dfn.dataIterator()); sdit.ok(); ++sdit) {
       delta_F[sdit].copy( soln_dfn[sdit] );
@@ -85,7 +89,7 @@ void Krook::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
    }
    
    // Calculate test-particle (TP) collisional RHS
-   LevelData<FArrayBox> tp_rhs_coll( grids, n_comp, IntVect::Zero );
+   LevelData<FArrayBox>& tp_rhs_coll( m_tp_rhs_coll );
    testPartCollRHS( tp_rhs_coll, delta_F );
    
    // Get right-hand side distribution function for the current species
@@ -478,9 +482,7 @@ void Krook::addReferenceDfn( KineticSpecies& a_result,
 {
    LevelData<FArrayBox>& result_dfn( a_result.distributionFunction() );
          
-   KineticSpeciesPtr ref_species( a_result.clone( IntVect::Unit, false ) );
-   m_ref_func->assign( *ref_species, a_time );
-   const LevelData<FArrayBox>& ref_dfn( ref_species->distributionFunction() );
+   const LevelData<FArrayBox>& ref_dfn( m_ref_dfn.get( a_result, a_time ) );
    for (DataIterator dit(result_dfn.dataIterator()); dit.ok(); ++dit) {
       result_dfn[dit].plus( ref_dfn[dit], a_scale );
    }
@@ -501,6 +503,24 @@ Real Krook::computeDt(const KineticSpeciesPtrVect& soln)
    } 
 }
 
+void Krook::localTimeScaleData(const KineticSpeciesPtrVect& soln,
+                               std::vector<Real>&           data)
+{
+   Real dt = DBL_MAX;
+   if (m_fixed_cls_freq)  dt = 1.0/m_cls_freq;
+   else {
+      Real max_freq = 0.0;
+      const DisjointBoxLayout & grids = m_sc_cls_freq.disjointBoxLayout();
+      for (DataIterator dit(m_sc_cls_freq.dataIterator()); dit.ok(); ++dit) {
+         Box box(grids[dit]);
+         max_freq = Max(max_freq, m_sc_cls_freq[dit].max(box));
+      }
+      if (max_freq > 0.0) dt = 1.0/max_freq;
+   }
+   data.push_back(dt);
+   data.push_back(dt);
+}
+
 Real Krook::TimeScale(const KineticSpeciesPtrVect& soln)
 {
    if (m_fixed_cls_freq)  return 1.0/m_cls_freq;
@@ -7,6 +7,7 @@
 #include "CollisionsF_F.H"
 #include "KineticFunctionLibrary.H"
 #include "ConstFact.H"
+#include "ThreadScratch.H"
 
 
 #include "NamespaceHeader.H" //Should be the last one
@@ -26,6 +27,8 @@ Linearized::Linearized( ParmParse& a_ppcls, const int a_verbosity )
    }
    
    m_fixed_cls_freq = (m_cls_freq<0.0) ? false : true ;
+
+   m_ref_dfn.define( m_ref_func );
 }
 
 Linearized::~Linearized()
@@ -44,9 +47,7 @@ void Linearized::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
    const LevelData<FArrayBox>& soln_dfn( soln_species.distributionFunction() );
    
    // Create reference (J*Bstar_par*dfn_init) distribution
-   KineticSpeciesPtr ref_species( soln_species.clone( IntVect::Unit, false ) );
-   m_ref_func->assign( *ref_species, a_time );
-   const LevelData<FArrayBox>& init_dfn( ref_species->distributionFunction() );
+   const LevelData<FArrayBox>& init_dfn( m_ref_dfn.get( soln_species, a_time ) );
 
    //Create reference temperature distribution
    const PhaseGeom& phase_geom = soln_species.phaseSpaceGeometry();
@@ -73,7 +74,11 @@ void Linearized::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
    // Compute the difference from the reference (or initial) solution
    const DisjointBoxLayout& grids( soln_dfn.getBoxes() );
    const int n_comp( soln_dfn.nComp() );
-   LevelData<FArrayBox> delta_dfn( grids, n_comp, IntVect::Zero );
+   if ( !m_delta_dfn.isDefined() || !(m_delta_dfn.getBoxes()==grids) || m_delta_dfn.nComp()!=n_comp ) {
+      m_delta_dfn.define( grids, n_comp, IntVect::Zero );
+      m_tp_rhs_coll.define( grids, n_comp, IntVect::Zero );
+   }
+   LevelData<FArrayBox>& delta_dfn( m_delta_dfn );
    
    for (DataIterator sdit(soln_dfn.dataIterator()); sdit.ok(); ++sdit) {
       delta_dfn[sdit].copy( soln_dfn[sdit] );
@@ -86,7 +91,7 @@ void Linearized::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
 
    // Calculate test-particle (TP) collisional RHS
    const double mass = soln_species.mass();
-   LevelData<FArrayBox> tp_rhs_coll(grids, n_comp, IntVect::Zero);
+   LevelData<FArrayBox>& tp_rhs_coll( m_tp_rhs_coll );
    testPartCollRHS(tp_rhs_coll, delta_dfn, phase_geom, mass);
 
    // Add conservative terms (field-particle terms)
@@ -219,7 +224,10 @@ void Linearized::testPartCollRHS(LevelData<FArrayBox>& a_rhs_coll,
 
    //Create cell-centered collsion fluxes (0 comp - vpar_dir, 1 comp - mu_dir)
    LevelData<FArrayBox> flux_cell(grids, 2, IntVect::Zero);
-   for (DataIterator dit( a_rhs_coll.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( a_rhs_coll.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       FArrayBox& this_flux_cell = flux_cell[dit];
       const FArrayBox& this_delta_dfn_tmp = delta_dfn_tmp[dit];
       const FArrayBox& this_b = injected_B[dit];
@@ -253,10 +261,19 @@ void Linearized::testPartCollRHS(LevelData<FArrayBox>& a_rhs_coll,
 
    //Create final (combined r , theta, mu, and v_par) rhs flux
    LevelData<FluxBox> flux_rhs(grids, SpaceDim, IntVect::Zero);
-   for (DataIterator dit(flux_rhs.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator face_boxes( flux_rhs.dataIterator() );
+   ThreadScratch scratch(1);
+   for (int ibox=0; ibox<face_boxes.size(); ibox++) {
+      scratch.reserve(0, grow(flux_cell[face_boxes[ibox]].box(),1), 2);
+   }
+   scratch.allocate();
+#pragma omp parallel for
+   for (int ibox=0; ibox<face_boxes.size(); ibox++) {
+      const DataIndex& dit( face_boxes[ibox] );
       const FArrayBox& this_flux_cell = flux_cell[dit];
 
-      FArrayBox tmp_flux_cell(grow(this_flux_cell.box(),1),2);
+      const Box tmp_box( grow(this_flux_cell.box(),1) );
+      FArrayBox tmp_flux_cell(tmp_box, 2, scratch.get(0, tmp_box, 2));
       tmp_flux_cell.setVal(0.);
       tmp_flux_cell.copy(this_flux_cell);
 
@@ -303,7 +320,15 @@ void Linearized::fieldPartCollRHS( LevelData<FArrayBox>& a_rhs_coll,
      LevelData<FArrayBox> inj_MNorm;
      a_phase_geom.injectConfigurationToPhase( m_norm_momentum, inj_MNorm );
 
-     for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+     DataIterator boxes( grids.dataIterator() );
+     ThreadScratch scratch(1);
+     for (int ibox=0; ibox<boxes.size(); ibox++) {
+        scratch.reserve(0, a_rhs_coll[boxes[ibox]].box(), VEL_DIM);
+     }
+     scratch.allocate();
+#pragma omp parallel for
+     for (int ibox=0; ibox<boxes.size(); ibox++) {
+        const DataIndex& dit( boxes[ibox] );
         const PhaseBlockCoordSys& block_coord_sys( a_phase_geom.getBlockCoordSys(grids[dit]) );
 
         FArrayBox& this_RHS( a_rhs_coll[dit] );
@@ -325,7 +350,8 @@ void Linearized::fieldPartCollRHS( LevelData<FArrayBox>& a_rhs_coll,
 
         // Get the physical velocity coordinates (Vpar, mu) for this part
         // of phase space; Vpar and Mu are defined at the cell centers
-        FArrayBox velocityRealCoords( this_RHS.box(), VEL_DIM );
+        FArrayBox velocityRealCoords( this_RHS.box(), VEL_DIM,
+                                      scratch.get( 0, this_RHS.box(), VEL_DIM ) );
         block_coord_sys.getVelocityRealCoords( velocityRealCoords );
       
         //Iterate over the points inside the box, iv is a 4-component int vect
@@ -378,21 +404,39 @@ void Linearized::fieldPartCollRHS( LevelData<FArrayBox>& a_rhs_coll,
      LevelData<FluxBox> flux_full_ERest(grids, SpaceDim, IntVect::Zero);
      LevelData<FArrayBox> rhs_ERest(grids, n_comp, IntVect::Zero);
 
-     for (DataIterator dit(flux_full_ERest.dataIterator() ); dit.ok(); ++dit) {
+     DataIterator boxes( flux_full_ERest.dataIterator() );
+     const IntVect tmp_ghosts(1,1,0,0);
+     ThreadScratch scratch(3);
+     for (int ibox=0; ibox<boxes.size(); ibox++) {
+        const DataIndex& dit( boxes[ibox] );
+        scratch.reserve(0, grow(inj_ERest[dit].box(),tmp_ghosts), inj_ERest.nComp());
+        scratch.reserve(1, grow(inj_ENorm[dit].box(),tmp_ghosts), inj_ENorm.nComp());
+        scratch.reserve(2, grow(m_temperature[dit].box(),tmp_ghosts), m_temperature.nComp());
+     }
+     scratch.allocate();
+#pragma omp parallel for
+     for (int ibox=0; ibox<boxes.size(); ibox++) {
+        const DataIndex& dit( boxes[ibox] );
         FArrayBox& this_ERest = inj_ERest[dit];
         FArrayBox& this_ENorm = inj_ENorm[dit];
         const FArrayBox& this_TempDistr = m_temperature[dit];
         const FArrayBox& this_B= B_injected[dit];
 
-        FArrayBox tmp_ERest(grow(this_ERest.box(),IntVect(1,1,0,0)),this_ERest.nComp());
+        const Box ERest_box(grow(this_ERest.box(),tmp_ghosts));
+        FArrayBox tmp_ERest(ERest_box,this_ERest.nComp(),
+                            scratch.get(0,ERest_box,this_ERest.nComp()));
         tmp_ERest.setVal(0.);
         tmp_ERest.copy(this_ERest);
 
-        FArrayBox tmp_ENorm(grow(this_ENorm.box(),IntVect(1,1,0,0)),this_ENorm.nComp());
+        const Box ENorm_box(grow(this_ENorm.box(),tmp_ghosts));
+        FArrayBox tmp_ENorm(ENorm_box,this_ENorm.nComp(),
+                            scratch.get(1,ENorm_box,this_ENorm.nComp()));
         tmp_ENorm.setVal(0.);
         tmp_ENorm.copy(this_ENorm);
 
-        FArrayBox tmp_TempDistr(grow(this_TempDistr.box(),IntVect(1,1,0,0)),this_TempDistr.nComp());
+        const Box TempDistr_box(grow(this_TempDistr.box(),tmp_ghosts));
+        FArrayBox tmp_TempDistr(TempDistr_box,this_TempDistr.nComp(),
+                                scratch.get(2,TempDistr_box,this_TempDistr.nComp()));
         tmp_TempDistr.setVal(0.);
         tmp_TempDistr.copy(this_TempDistr);
 
@@ -443,7 +487,15 @@ void Linearized::collKernels( LevelData<FArrayBox>& a_kern_energ,
 
    const DisjointBoxLayout& grids( a_test_part_coll_RHS.getBoxes() );
    const int n_comp( a_test_part_coll_RHS.nComp() );
-   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( grids.dataIterator() );
+   ThreadScratch scratch(1);
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      scratch.reserve(0, a_kern_energ[boxes[ibox]].box(), VEL_DIM);
+   }
+   scratch.allocate();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const PhaseBlockCoordSys& block_coord_sys( a_phase_geom.getBlockCoordSys(grids[dit]) );
 
       FArrayBox& this_KE( a_kern_energ[dit] );
@@ -453,7 +505,7 @@ void Linearized::collKernels( LevelData<FArrayBox>& a_kern_energ,
 
       // Get the physical velocity coordinates for this part of phase space
       const Box& box_kern( this_KE.box() );
-      FArrayBox velocityRealCoords( box_kern, VEL_DIM );
+      FArrayBox velocityRealCoords( box_kern, VEL_DIM, scratch.get( 0, box_kern, VEL_DIM ) );
       block_coord_sys.getVelocityRealCoords( velocityRealCoords );
 
       const Box& box_B( this_B.box() );
@@ -499,11 +551,23 @@ void Linearized::evaluateNormKern( LevelData<FArrayBox>& a_kern_moment_norm,
    //Calculate "nu_E" using its divergence representation 
    //and storing the result in a_kern_energ_norm
    LevelData<FluxBox> flux_norm_ERest(grids, SpaceDim, IntVect::Zero);
-   for (DataIterator dit(flux_norm_ERest.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( flux_norm_ERest.dataIterator() );
+   const IntVect tmp_ghosts(1,1,0,0);
+   ThreadScratch scratch(2);
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
+      scratch.reserve(0, grow(m_temperature[dit].box(),tmp_ghosts), 1);
+      scratch.reserve(1, a_kern_moment_norm[dit].box(), VEL_DIM);
+   }
+   scratch.allocate();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const FArrayBox& this_TempDistr = m_temperature[dit];
       const FArrayBox& this_B= B_injected[dit];
 
-      FArrayBox tmp_TempDistr(grow(this_TempDistr.box(),IntVect(1,1,0,0)),1);
+      const Box TempDistr_box(grow(this_TempDistr.box(),tmp_ghosts));
+      FArrayBox tmp_TempDistr(TempDistr_box,1,scratch.get(0,TempDistr_box,1));
       tmp_TempDistr.setVal(0.);
       tmp_TempDistr.copy(this_TempDistr);
 
@@ -530,7 +594,10 @@ void Linearized::evaluateNormKern( LevelData<FArrayBox>& a_kern_moment_norm,
    }
 
    //Calculate kernels for the conserving terms normalization factors
-   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator cell_boxes( grids.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<cell_boxes.size(); ibox++) {
+      const DataIndex& dit( cell_boxes[ibox] );
       const PhaseBlockCoordSys& block_coord_sys( a_phase_geom.getBlockCoordSys(grids[dit]) );
 
       FArrayBox& this_EN( a_kern_energ_norm[dit] );
@@ -545,7 +612,7 @@ void Linearized::evaluateNormKern( LevelData<FArrayBox>& a_kern_moment_norm,
       const int mu_index( box_B.smallEnd( MU_DIR ) );
 
       // Get the physical velocity coordinates for this part of phase space
-      FArrayBox velocityRealCoords( box_k, VEL_DIM );
+      FArrayBox velocityRealCoords( box_k, VEL_DIM, scratch.get( 1, box_k, VEL_DIM ) );
       block_coord_sys.getVelocityRealCoords( velocityRealCoords );
 
       for (BoxIterator bit( velocityRealCoords.box() ); bit.ok(); ++bit) {
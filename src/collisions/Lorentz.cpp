@@ -25,6 +25,8 @@ Lorentz::Lorentz( ParmParse& a_ppcls, const int a_verbosity )
    }
 
    m_fixed_cls_freq = (m_cls_freq<0.0) ? false : true ;
+
+   m_ref_dfn.define( m_ref_func );
 }
 
 Lorentz::~Lorentz()
@@ -44,9 +46,7 @@ void Lorentz::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
    const LevelData<FArrayBox>& soln_dfn( soln_species.distributionFunction() );
    
    // Create reference (J*Bstar_par*dfn_init) distribution
-   KineticSpeciesPtr ref_species( soln_species.clone( IntVect::Unit, false ) );
-   m_ref_func->assign( *ref_species, a_time );
-   const LevelData<FArrayBox>& init_dfn( ref_species->distributionFunction() );
+   const LevelData<FArrayBox>& init_dfn( m_ref_dfn.get( soln_species, a_time ) );
 
    //Create reference temperature distribution
    const PhaseGeom& phase_geom = soln_species.phaseSpaceGeometry();
@@ -73,7 +73,11 @@ void Lorentz::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
    // Compute the difference from the reference (or initial) solution
    const DisjointBoxLayout& grids( soln_dfn.getBoxes() );
    const int n_comp( soln_dfn.nComp() );
-   LevelData<FArrayBox> delta_dfn( grids, n_comp, IntVect::Zero );
+   if ( !m_delta_dfn.isDefined() || !(m_delta_dfn.getBoxes()==grids) || m_delta_dfn.nComp()!=n_comp ) {
+      m_delta_dfn.define( grids, n_comp, IntVect::Zero );
+      m_tp_rhs_coll.define( grids, n_comp, IntVect::Zero );
+   }
+   LevelData<FArrayBox>& delta_dfn( m_delta_dfn );
    
    for (DataIterator sdit(soln_dfn.dataIterator()); sdit.ok(); ++sdit) {
       delta_dfn[sdit].copy( soln_dfn[sdit] );
@@ -86,7 +90,7 @@ void Lorentz::evalClsRHS( KineticSpeciesPtrVect&       a_rhs,
 
    // Calculate test-particle (TP) collisional RHS
    const double mass = soln_species.mass();
-   LevelData<FArrayBox> tp_rhs_coll(grids, n_comp, IntVect::Zero);
+   LevelData<FArrayBox>& tp_rhs_coll( m_tp_rhs_coll );
    testPartCollRHS(tp_rhs_coll, delta_dfn, phase_geom, mass);
 
    // Add conservative terms (field-particle terms)
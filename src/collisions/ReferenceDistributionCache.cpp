@@ -0,0 +1,39 @@
+#include "ReferenceDistributionCache.H"
+
+#include "NamespaceHeader.H"
+
+
+ReferenceDistributionCache::ReferenceDistributionCache()
+   : m_time_dependent(false)
+{
+}
+
+
+void
+ReferenceDistributionCache::define( const RefCountedPtr<KineticFunction>& a_ref_func )
+{
+   m_ref_func = a_ref_func;
+   m_ref_species = KineticSpeciesPtr();
+   m_time_dependent = !m_ref_func->isTimeIndependent();
+}
+
+
+const LevelData<FArrayBox>&
+ReferenceDistributionCache::get( const KineticSpecies& a_soln_species,
+                                 const Real            a_time )
+{
+   const LevelData<FArrayBox>& soln_dfn( a_soln_species.distributionFunction() );
+   const bool redefine( m_ref_species.isNull()
+                        || !(m_ref_species->distributionFunction().getBoxes()==soln_dfn.getBoxes())
+                        || &(m_ref_species->phaseSpaceGeometry())!=&(a_soln_species.phaseSpaceGeometry()) );
+   if ( redefine ) {
+      m_ref_species = a_soln_species.clone( IntVect::Unit, false );
+   }
+   if ( redefine || m_time_dependent ) {
+      m_ref_func->assign( *m_ref_species, a_time );
+   }
+   return m_ref_species->distributionFunction();
+}
+
+
+#include "NamespaceFooter.H"
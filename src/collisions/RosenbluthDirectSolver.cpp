@@ -0,0 +1,168 @@
+#include "RosenbluthDirectSolver.H"
+#include "Directions.H"
+
+#include <math.h>
+
+#include "NamespaceHeader.H"
+
+const long long RosenbluthDirectSolver::s_max_factor_bytes = 256LL * 1024 * 1024;
+
+
+RosenbluthDirectSolver::RosenbluthDirectSolver( const VEL::ProblemDomain& a_domain,
+                                                const VEL::RealVect&      a_dx,
+                                                const Real                a_mass )
+   : m_domain_box(a_domain.domainBox()),
+     m_dx(a_dx),
+     m_mass(a_mass),
+     m_num_solves(0),
+     m_num_factorizations(0)
+{
+   m_num_vpar = m_domain_box.size(0);
+   m_num_mu = m_domain_box.size(1);
+
+   const long long factor_bytes = 3LL * m_num_vpar * m_num_mu * sizeof(Real);
+   m_max_factors = (int)Max( 1LL, s_max_factor_bytes / factor_bytes );
+
+   // Orthonormal (and symmetric) sine transform diagonalizing the
+   // homogeneous Dirichlet second difference in vparallel
+   const Real pi = 4.0 * atan(1.0);
+   const Real theta = pi / (m_num_vpar + 1);
+   const Real norm = sqrt( 2.0 / (m_num_vpar + 1) );
+
+   m_sine.resize(m_num_vpar * m_num_vpar);
+   m_eigenvalues.resize(m_num_vpar);
+   for (int k=0; k<m_num_vpar; ++k) {
+      for (int i=0; i<m_num_vpar; ++i) {
+         m_sine[i + k*m_num_vpar] = norm * sin( (i+1) * (k+1) * theta );
+      }
+      m_eigenvalues[k] = (2.0 - 2.0 * cos( (k+1) * theta )) / (m_dx[0] * m_dx[0]);
+   }
+
+   m_work.resize(m_num_vpar * m_num_mu);
+   m_work_hat.resize(m_num_vpar * m_num_mu);
+}
+
+
+
+bool RosenbluthDirectSolver::conformsTo( const VEL::ProblemDomain& a_domain,
+                                         const VEL::RealVect&      a_dx,
+                                         const Real                a_mass ) const
+{
+   return a_domain.domainBox() == m_domain_box && a_dx == m_dx && a_mass == m_mass;
+}
+
+
+
+const RosenbluthDirectSolver::Factors&
+RosenbluthDirectSolver::factors( const Real a_Bfield )
+{
+   std::map<Real,Factors>::iterator it = m_factors.find(a_Bfield);
+   if ( it != m_factors.end() ) return it->second;
+
+   if ( m_factors.size() >= m_max_factors ) {
+      m_factors.clear();
+   }
+   m_num_factorizations++;
+
+   Factors& fac = m_factors[a_Bfield];
+   const int size = m_num_vpar * m_num_mu;
+   fac.lower.resize(size);
+   fac.upper.resize(size);
+   fac.inv_diag.resize(size);
+
+   // Same coefficients as RosenbluthPotentials::constructMatrix, with the
+   // vparallel part replaced by its eigenvalue
+   const Real mu_fac = 4.0 * (m_mass/a_Bfield) / m_dx[1];
+   const int mu_lo = m_domain_box.smallEnd(1);
+
+   for (int k=0; k<m_num_vpar; ++k) {
+      Real upper_prev = 0.;
+      for (int j=0; j<m_num_mu; ++j) {
+         const int mu_index = mu_lo + j;
+         const int n = k + j*m_num_vpar;
+
+         Real lower = (j == 0)? 0. : -mu_fac * mu_index;
+         Real upper = (j == m_num_mu-1)? 0. : -mu_fac * (mu_index + 1);
+         Real diag = m_eigenvalues[k] + mu_fac * (2 * mu_index + 1);
+
+         Real inv_diag = 1.0 / (diag - lower * upper_prev);
+
+         fac.lower[n] = lower;
+         fac.inv_diag[n] = inv_diag;
+         fac.upper[n] = upper_prev = upper * inv_diag;
+      }
+   }
+
+   return fac;
+}
+
+
+
+void RosenbluthDirectSolver::solve( FArrayBox&          a_solution,
+                                    const FArrayBox&    a_rhs,
+                                    const CFG::IntVect& a_cfg_iv,
+                                    const Real          a_Bfield )
+{
+   const Factors& fac = factors(a_Bfield);
+
+   const VEL::IntVect& vel_lo = m_domain_box.smallEnd();
+   IntVect iv;
+   for (int n=0; n<CFG_DIM; ++n) {
+      iv[n] = a_cfg_iv[n];
+   }
+
+   // Load the slice, negated since A is the negative Laplacian
+   for (int j=0; j<m_num_mu; ++j) {
+      iv[MU_DIR] = vel_lo[1] + j;
+      for (int i=0; i<m_num_vpar; ++i) {
+         iv[VPARALLEL_DIR] = vel_lo[0] + i;
+         m_work[i + j*m_num_vpar] = -a_rhs(iv,0);
+      }
+   }
+
+   // Transform to vparallel modes
+   for (int j=0; j<m_num_mu; ++j) {
+      const Real* f = &m_work[j*m_num_vpar];
+      Real* f_hat = &m_work_hat[j*m_num_vpar];
+      for (int k=0; k<m_num_vpar; ++k) {
+         const Real* s = &m_sine[k*m_num_vpar];
+         Real sum = 0.;
+         for (int i=0; i<m_num_vpar; ++i) {
+            sum += s[i] * f[i];
+         }
+         f_hat[k] = sum;
+      }
+   }
+
+   // Tridiagonal solve in mu for each mode
+   for (int k=0; k<m_num_vpar; ++k) {
+      Real prev = 0.;
+      for (int j=0; j<m_num_mu; ++j) {
+         const int n = k + j*m_num_vpar;
+         m_work_hat[n] = prev = (m_work_hat[n] - fac.lower[n] * prev) * fac.inv_diag[n];
+      }
+      for (int j=m_num_mu-2; j>=0; --j) {
+         const int n = k + j*m_num_vpar;
+         m_work_hat[n] -= fac.upper[n] * m_work_hat[n + m_num_vpar];
+      }
+   }
+
+   // Transform back and unload
+   for (int j=0; j<m_num_mu; ++j) {
+      const Real* f_hat = &m_work_hat[j*m_num_vpar];
+      iv[MU_DIR] = vel_lo[1] + j;
+      for (int i=0; i<m_num_vpar; ++i) {
+         Real sum = 0.;
+         for (int k=0; k<m_num_vpar; ++k) {
+            sum += m_sine[i + k*m_num_vpar] * f_hat[k];
+         }
+         iv[VPARALLEL_DIR] = vel_lo[0] + i;
+         a_solution(iv,0) = sum;
+      }
+   }
+
+   m_num_solves++;
+}
+
+
+#include "NamespaceFooter.H"
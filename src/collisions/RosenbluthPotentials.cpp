@@ -3,6 +3,8 @@
 
 #include "KineticSpecies.H"
 #include "RosenbluthPotentialsF_F.H"
+#include "CH_Timer.H"
+#include "GKProfiler.H"
 
 #include "NamespaceHeader.H" 
 
@@ -15,13 +17,17 @@ RosenbluthPotentials::RosenbluthPotentials( LevelData<FArrayBox>&       a_phi_on
                                             const Real                  a_pcg_tol,
                                             const Real                  a_pcg_maxiter,
                                             const int                   a_mult_num,
-                                            const int                   a_verbocity ) 
+                                            const int                   a_verbocity,
+                                            RosenbluthDirectSolver*     a_direct_solver,
+                                            const bool                  a_compare_solvers ) 
    : m_verbosity(a_verbocity),
      m_phase_geom(a_phase_geom),
      m_mass(a_mass),
      m_pcg_tol(a_pcg_tol),
      m_pcg_maxiter(a_pcg_maxiter),
-     m_mult_num(a_mult_num)
+     m_mult_num(a_mult_num),
+     m_direct_solver(a_direct_solver),
+     m_compare_solvers(a_compare_solvers)
 {
    const DisjointBoxLayout& grids( a_rho.getBoxes() );
    const int n_comp( a_rho.nComp() );
@@ -192,6 +198,194 @@ void RosenbluthPotentials::computeMultipoleCoeff( CFG::LevelData<CFG::FArrayBox>
 
 void RosenbluthPotentials::solve( LevelData<FArrayBox>&       a_solution,
                                   const LevelData<FArrayBox>& a_rhs ) const
+{
+   CH_TIMERS("RosenbluthPotentials::solve");
+   CH_TIMER("RosenbluthPotentials::solve::hypre",t_hypre);
+   CH_TIMER("RosenbluthPotentials::solve::direct",t_direct);
+
+   const PhaseGrid& phase_grid = m_phase_geom.phaseGrid();
+
+   // The direct solver needs the whole velocity slice on this process
+   Vector<int> hypre_boxes, direct_boxes;
+   for (int k=0; k<phase_grid.numConfigBoxes(); ++k) {
+      bool local = (m_direct_solver != NULL);
+#ifdef CH_MPI
+      if (local) {
+         int comm_size;
+         MPI_Comm_size(phase_grid.configBoxComm(k), &comm_size);
+         local = (comm_size == 1);
+      }
+#endif
+      if (local) {
+         direct_boxes.push_back(k);
+      }
+      else {
+         hypre_boxes.push_back(k);
+      }
+   }
+
+   double hypre_time = 0.;
+   double direct_time = 0.;
+
+   CH_START(t_hypre);
+   double start = GKProfiler::wallTime();
+   solveHypre(a_solution, a_rhs, hypre_boxes);
+   hypre_time += GKProfiler::wallTime() - start;
+   CH_STOP(t_hypre);
+
+   if ( m_direct_solver ) {
+      CH_START(t_direct);
+      start = GKProfiler::wallTime();
+      solveDirect(a_solution, a_rhs, direct_boxes);
+      direct_time += GKProfiler::wallTime() - start;
+      CH_STOP(t_direct);
+   }
+
+   // Solve the right-hand side of the direct solver boxes again with Hypre,
+   // timing only that solve against the direct solve of the same boxes
+   if ( m_compare_solvers && m_direct_solver ) {
+      LevelData<FArrayBox> reference(a_solution.disjointBoxLayout(),
+                                     a_solution.nComp(),
+                                     a_solution.ghostVect());
+      for (DataIterator dit(reference.dataIterator()); dit.ok(); ++dit) {
+         reference[dit].setVal(0.);
+      }
+
+      CH_START(t_hypre);
+      start = GKProfiler::wallTime();
+      solveHypre(reference, a_rhs, direct_boxes);
+      const double reference_time = GKProfiler::wallTime() - start;
+      CH_STOP(t_hypre);
+
+      const DisjointBoxLayout& dbl = a_solution.disjointBoxLayout();
+      const VEL::Box& vel_domain_box = m_phase_geom.velSpaceCoordSys().domain().domainBox();
+
+      double max_diff = 0.;
+      double max_soln = 0.;
+      for (int n=0; n<direct_boxes.size(); ++n) {
+         const CFG::Box& config_box = phase_grid.configBox(direct_boxes[n]);
+         IntVect lo, hi;
+         for (int dir=0; dir<CFG_DIM; ++dir) {
+            lo[dir] = config_box.smallEnd(dir);
+            hi[dir] = config_box.bigEnd(dir);
+         }
+         for (int dir=CFG_DIM; dir<SpaceDim; ++dir) {
+            lo[dir] = vel_domain_box.smallEnd(dir-CFG_DIM);
+            hi[dir] = vel_domain_box.bigEnd(dir-CFG_DIM);
+         }
+         Box column(lo,hi);
+
+         for (DataIterator dit(dbl); dit.ok(); ++dit) {
+            Box overlap = dbl[dit] & column;
+            if (overlap.ok()) {
+               FArrayBox diff(overlap, 1);
+               diff.copy(a_solution[dit]);
+               diff.minus(reference[dit]);
+               max_diff = Max(max_diff, diff.norm(overlap, 0));
+               max_soln = Max(max_soln, a_solution[dit].norm(overlap, 0));
+            }
+         }
+      }
+
+      double compare_time[2] = {reference_time, direct_time};
+#ifdef CH_MPI
+      double local_vals[4] = {max_diff, max_soln, reference_time, direct_time};
+      double global_vals[4];
+      MPI_Allreduce(local_vals, global_vals, 4, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      max_diff = global_vals[0];
+      max_soln = global_vals[1];
+      compare_time[0] = global_vals[2];
+      compare_time[1] = global_vals[3];
+#endif
+      if (procID()==0) {
+         cout << "      RosenbluthPotentials solve time on the direct solver boxes: hypre = "
+              << compare_time[0] << " s, direct = " << compare_time[1]
+              << " s, max |direct - hypre| = " << max_diff
+              << " (max |phi| = " << max_soln << ")" << endl;
+      }
+   }
+
+   if ( m_verbosity && m_direct_solver && procID()==0 ) {
+      cout << "      RosenbluthPotentials direct solver: " << m_direct_solver->numFactorizations()
+           << " factorizations, " << m_direct_solver->numSolves()
+           << " slice solves (rank 0)" << endl;
+   }
+}
+
+
+
+void RosenbluthPotentials::solveDirect( LevelData<FArrayBox>&       a_solution,
+                                        const LevelData<FArrayBox>& a_rhs,
+                                        const Vector<int>&          a_config_boxes ) const
+{
+   CH_assert(m_direct_solver != NULL);
+
+   const PhaseGrid& phase_grid = m_phase_geom.phaseGrid();
+   const DisjointBoxLayout& dbl = phase_grid.disjointBoxLayout();
+   const VEL::Box& vel_domain_box = m_phase_geom.velSpaceCoordSys().domain().domainBox();
+   const LevelData<FArrayBox>& injected_B = m_phase_geom.getBFieldMagnitude();
+
+   for (int n=0; n<a_config_boxes.size(); ++n) {
+      const CFG::Box& config_box = phase_grid.configBox(a_config_boxes[n]);
+
+      // Phase-space column spanned by this configuration box
+      IntVect lo, hi;
+      for (int dir=0; dir<CFG_DIM; ++dir) {
+         lo[dir] = config_box.smallEnd(dir);
+         hi[dir] = config_box.bigEnd(dir);
+      }
+      for (int dir=CFG_DIM; dir<SpaceDim; ++dir) {
+         lo[dir] = vel_domain_box.smallEnd(dir-CFG_DIM);
+         hi[dir] = vel_domain_box.bigEnd(dir-CFG_DIM);
+      }
+      Box column(lo,hi);
+
+      // Gather the right-hand side and B over the column
+      FArrayBox rhs_column(column, 1);
+      FArrayBox soln_column(column, 1);
+      CFG::FArrayBox B_column(config_box, 1);
+
+      for (DataIterator dit(dbl); dit.ok(); ++dit) {
+         Box overlap = dbl[dit] & column;
+         if (overlap.ok()) {
+            rhs_column.copy(a_rhs[dit], overlap);
+
+            const FArrayBox& this_B = injected_B[dit];
+            IntVect ivB = this_B.box().smallEnd();
+            CFG::Box cfg_overlap(m_phase_geom.config_restrict(overlap.smallEnd()),
+                                 m_phase_geom.config_restrict(overlap.bigEnd()));
+            CFG::BoxIterator bit(cfg_overlap);
+            for (bit.begin(); bit.ok(); ++bit) {
+               CFG::IntVect cfg_iv = bit();
+               for (int dir=0; dir<CFG_DIM; ++dir) {
+                  ivB[dir] = cfg_iv[dir];
+               }
+               B_column(cfg_iv,0) = this_B(ivB,0);
+            }
+         }
+      }
+
+      // Solve all configuration cells as independent right-hand sides
+      CFG::BoxIterator bit(config_box);
+      for (bit.begin(); bit.ok(); ++bit) {
+         CFG::IntVect cfg_iv = bit();
+         m_direct_solver->solve(soln_column, rhs_column, cfg_iv, B_column(cfg_iv,0));
+      }
+
+      for (DataIterator dit(dbl); dit.ok(); ++dit) {
+         Box overlap = dbl[dit] & column;
+         if (overlap.ok()) {
+            a_solution[dit].copy(soln_column, overlap);
+         }
+      }
+   }
+}
+
+
+
+void RosenbluthPotentials::solveHypre( LevelData<FArrayBox>&       a_solution,
+                                       const LevelData<FArrayBox>& a_rhs,
+                                       const Vector<int>&          a_config_boxes ) const
 {
    // Get coordinate system parameters 
    const PhaseGrid& phase_grid = m_phase_geom.phaseGrid();
@@ -201,12 +395,11 @@ void RosenbluthPotentials::solve( LevelData<FArrayBox>&       a_solution,
    
    const LevelData<FArrayBox>& injected_B = m_phase_geom.getBFieldMagnitude();
 
-   int num_config_boxes = phase_grid.numConfigBoxes();
-   
    int max_iterations = 0;
    double max_final_norm = 0.;
 
-   for (int k=0; k<num_config_boxes; ++k) {
+   for (int n=0; n<a_config_boxes.size(); ++n) {
+      const int k = a_config_boxes[n];
 
       const MPI_Comm& config_box_comm = phase_grid.configBoxComm(k);
       const List<VEL::Box>& velocity_slice = phase_grid.velocitySlice(k);
@@ -17,9 +17,27 @@
 #define CH_SPACEDIM CFG_DIM
 
 #include "Directions.H"
+#include "CH_Timer.H"
+#include "LayoutMatch.H"
 
 #include "NamespaceHeader.H"
 
+// Maximum number of cached copiers
+static const int s_max_copier_plans = 8;
+
+// Copies a_src box by box onto a_dst, whose layout must have the same boxes
+// and processor assignment
+inline
+void copyLocal( LevelData<FArrayBox>&       a_dst,
+                const LevelData<FArrayBox>& a_src )
+{
+   DataIterator sdit = a_src.dataIterator();
+   DataIterator ddit = a_dst.dataIterator();
+   for (sdit.begin(),ddit.begin(); sdit.ok()&&ddit.ok(); ++sdit,++ddit) {
+      a_dst[ddit].copy(a_src[sdit]);
+   }
+}
+
 
 
 FluxSurface::FluxSurface( const MagGeom& a_geom,
@@ -85,23 +103,44 @@ FluxSurface::sum( const LevelData<FArrayBox>& a_src,
    int poloidal_dir = POLOIDAL_DIR;
    const DisjointBoxLayout& dst_grids = a_dst.getBoxes();
    const DisjointBoxLayout& src_grids = a_src.getBoxes();
-   const ProblemDomain& problem_domain = src_grids.physDomain();
 
-   // Define ReductionCopier to compute intersections (sum in the y-direction)
-   ReductionCopier reduceCopier(src_grids, dst_grids, problem_domain, poloidal_dir);
+   // ReductionCopier to compute intersections (sum in the y-direction)
+   const CopierPlan& plan = poloidalCopier(src_grids, dst_grids, false);
+
+   // The cached copier is bound to the plan's layouts, so data on other
+   // layouts with the same decomposition is moved onto them
+   LevelData<FArrayBox> src_copy;
+   if ( !(plan.src_grids == src_grids) ) {
+      src_copy.define(plan.src_grids, a_src.nComp(), a_src.ghostVect());
+      copyLocal(src_copy, a_src);
+   }
+   const LevelData<FArrayBox>& src = src_copy.isDefined()? src_copy: a_src;
+
+   LevelData<FArrayBox> dst_copy;
+   if ( !(plan.dst_grids == dst_grids) ) {
+      dst_copy.define(plan.dst_grids, a_dst.nComp(), a_dst.ghostVect());
+   }
+   LevelData<FArrayBox>& dst = dst_copy.isDefined()? dst_copy: a_dst;
 
    SumOp op(poloidal_dir);
    op.scale = 1.0;
 
    // Initialize the destination, since SumOp does not do that for us.
-   DataIterator dit = a_dst.dataIterator();
+   DataIterator dit = dst.dataIterator();
    for (dit.begin(); dit.ok(); ++dit) {
-      a_dst[dit].setVal(0.);
+      dst[dit].setVal(0.);
    }
 
    // Do the summing operation -- sums data in src along the poloidal direction
    // and places the result in dst
-   a_src.copyTo(a_src.interval(), a_dst, a_dst.interval(), reduceCopier, op);
+   {
+      CH_TIME("FluxSurface::sum::reduce");
+      src.copyTo(src.interval(), dst, dst.interval(), *plan.copier, op);
+   }
+
+   if ( dst_copy.isDefined() ) {
+      copyLocal(a_dst, dst_copy);
+   }
 }
 
 
@@ -115,15 +154,81 @@ FluxSurface::spread( const LevelData<FArrayBox>& a_src,
    int poloidal_dir = POLOIDAL_DIR;
    const DisjointBoxLayout& dst_grids = a_dst.getBoxes();
    const DisjointBoxLayout& src_grids = a_src.getBoxes();
-   const ProblemDomain& problem_domain = dst_grids.physDomain();
 
-   // Define SpreadingCopier to spread in the poloidal direction
-   SpreadingCopier spreadCopier(src_grids, dst_grids, problem_domain, poloidal_dir);
+   // SpreadingCopier to spread in the poloidal direction
+   const CopierPlan& plan = poloidalCopier(src_grids, dst_grids, true);
+
+   LevelData<FArrayBox> src_copy;
+   if ( !(plan.src_grids == src_grids) ) {
+      src_copy.define(plan.src_grids, a_src.nComp(), a_src.ghostVect());
+      copyLocal(src_copy, a_src);
+   }
+   const LevelData<FArrayBox>& src = src_copy.isDefined()? src_copy: a_src;
+
+   LevelData<FArrayBox> dst_copy;
+   if ( !(plan.dst_grids == dst_grids) ) {
+      dst_copy.define(plan.dst_grids, a_dst.nComp(), a_dst.ghostVect());
+      copyLocal(dst_copy, a_dst);
+   }
+   LevelData<FArrayBox>& dst = dst_copy.isDefined()? dst_copy: a_dst;
 
    const SpreadingOp spreadOp(poloidal_dir);
 
    // Do the spreading
-   a_src.copyTo(a_src.interval(), a_dst, a_dst.interval(), spreadCopier, spreadOp);
+   {
+      CH_TIME("FluxSurface::spread::spread");
+      src.copyTo(src.interval(), dst, dst.interval(), *plan.copier, spreadOp);
+   }
+
+   if ( dst_copy.isDefined() ) {
+      copyLocal(a_dst, dst_copy);
+   }
+}
+
+
+
+const FluxSurface::CopierPlan&
+FluxSurface::poloidalCopier( const DisjointBoxLayout& a_src_grids,
+                             const DisjointBoxLayout& a_dst_grids,
+                             const bool               a_spreading ) const
+{
+   // Copiers are bound to the layouts they were built for, but serve any
+   // layouts with the same boxes on the same processors once the data is
+   // moved onto them
+   for (int n=0; n<m_copier_plans.size(); ++n) {
+      const CopierPlan& plan = m_copier_plans[n];
+      if ( plan.spreading == a_spreading
+           && sameDecomposition( plan.src_grids, a_src_grids )
+           && sameDecomposition( plan.dst_grids, a_dst_grids ) ) {
+         return plan;
+      }
+   }
+
+   // Layouts that keep changing must not grow the cache without bound
+   if ( m_copier_plans.size() >= s_max_copier_plans ) {
+      m_copier_plans.resize(0);
+   }
+
+   CH_TIME("FluxSurface::poloidalCopier::define");
+
+   CopierPlan plan;
+   plan.src_grids = a_src_grids;
+   plan.dst_grids = a_dst_grids;
+   plan.spreading = a_spreading;
+
+   int poloidal_dir = POLOIDAL_DIR;
+   if ( a_spreading ) {
+      plan.copier = RefCountedPtr<Copier>(
+         new SpreadingCopier(a_src_grids, a_dst_grids, a_dst_grids.physDomain(), poloidal_dir) );
+   }
+   else {
+      plan.copier = RefCountedPtr<Copier>(
+         new ReductionCopier(a_src_grids, a_dst_grids, a_src_grids.physDomain(), poloidal_dir) );
+   }
+
+   m_copier_plans.push_back(plan);
+
+   return m_copier_plans[m_copier_plans.size()-1];
 }
 
 
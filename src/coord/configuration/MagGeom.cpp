@@ -9,6 +9,10 @@
 #include "EdgeToCell.H"
 #include "SingleNullBlockCoordSys.H"
 #include "SingleNullCoordSys.H"
+#include "SNCoreBlockCoordSys.H"
+
+#include <iomanip>
+#include <sstream>
 
 #include "FieldSolverF_F.H"
 #include "NamespaceHeader.H"
@@ -52,6 +56,14 @@ MagGeom::MagGeom(ParmParse&                 a_pp,
      }
    }
 
+   // The metric and field data computed during the setup may be stored in,
+   // and then loaded from, a persistent cache
+   if (a_pp.contains("metric_cache_directory")) {
+      string metric_cache_directory;
+      a_pp.get("metric_cache_directory", metric_cache_directory);
+      m_metric_cache.define( metric_cache_directory, metricCacheKey(a_grids, a_ghosts) );
+   }
+
    // Precompute the face-centered field data
    IntVect field_ghosts = a_ghosts*IntVect::Unit;
    m_BField_fc.define(a_grids, 3, field_ghosts);
@@ -61,12 +73,27 @@ MagGeom::MagGeom(ParmParse&                 a_pp,
    m_curlBFieldDir_fc.define(a_grids, 3, field_ghosts);
    m_BFieldDirdotcurlBFieldDir_fc.define(a_grids, 1, field_ghosts);
 
-   computeFieldData( m_BField_fc,
-                     m_BFieldMag_fc,
-                     m_BFieldDir_fc,
-                     m_gradBFieldMag_fc,
-                     m_curlBFieldDir_fc,
-                     m_BFieldDirdotcurlBFieldDir_fc );
+   if ( !( m_metric_cache.get("BField_fc", m_BField_fc) &&
+           m_metric_cache.get("BFieldMag_fc", m_BFieldMag_fc) &&
+           m_metric_cache.get("BFieldDir_fc", m_BFieldDir_fc) &&
+           m_metric_cache.get("gradBFieldMag_fc", m_gradBFieldMag_fc) &&
+           m_metric_cache.get("curlBFieldDir_fc", m_curlBFieldDir_fc) &&
+           m_metric_cache.get("BFieldDirdotcurlBFieldDir_fc", m_BFieldDirdotcurlBFieldDir_fc) ) ) {
+
+      computeFieldData( m_BField_fc,
+                        m_BFieldMag_fc,
+                        m_BFieldDir_fc,
+                        m_gradBFieldMag_fc,
+                        m_curlBFieldDir_fc,
+                        m_BFieldDirdotcurlBFieldDir_fc );
+
+      m_metric_cache.put("BField_fc", m_BField_fc);
+      m_metric_cache.put("BFieldMag_fc", m_BFieldMag_fc);
+      m_metric_cache.put("BFieldDir_fc", m_BFieldDir_fc);
+      m_metric_cache.put("gradBFieldMag_fc", m_gradBFieldMag_fc);
+      m_metric_cache.put("curlBFieldDir_fc", m_curlBFieldDir_fc);
+      m_metric_cache.put("BFieldDirdotcurlBFieldDir_fc", m_BFieldDirdotcurlBFieldDir_fc);
+   }
 
 
    m_BField_cc.define(a_grids, 3, field_ghosts);
@@ -81,21 +108,36 @@ MagGeom::MagGeom(ParmParse&                 a_pp,
    // we need to average the corrected values to cell centers (which is only
    // done to second order by EdgeToCell(), unfortunately).  Otherwise, we compute
    // the actual cell-centered data.
-   if ( m_correct_field ) {
-      cellCenter( m_BField_fc, m_BField_cc );
-      cellCenter( m_BFieldMag_fc, m_BFieldMag_cc );
-      cellCenter( m_BFieldDir_fc, m_BFieldDir_cc );
-      cellCenter( m_gradBFieldMag_fc, m_gradBFieldMag_cc );
-      cellCenter( m_curlBFieldDir_fc, m_curlBFieldDir_cc );
-      cellCenter( m_BFieldDirdotcurlBFieldDir_fc, m_BFieldDirdotcurlBFieldDir_cc );
-   }
-   else {
-      computeFieldData( m_BField_cc,
-                        m_BFieldMag_cc,
-                        m_BFieldDir_cc,
-                        m_gradBFieldMag_cc,
-                        m_curlBFieldDir_cc,
-                        m_BFieldDirdotcurlBFieldDir_cc );
+   if ( !( m_metric_cache.get("BField_cc", m_BField_cc) &&
+           m_metric_cache.get("BFieldMag_cc", m_BFieldMag_cc) &&
+           m_metric_cache.get("BFieldDir_cc", m_BFieldDir_cc) &&
+           m_metric_cache.get("gradBFieldMag_cc", m_gradBFieldMag_cc) &&
+           m_metric_cache.get("curlBFieldDir_cc", m_curlBFieldDir_cc) &&
+           m_metric_cache.get("BFieldDirdotcurlBFieldDir_cc", m_BFieldDirdotcurlBFieldDir_cc) ) ) {
+
+      if ( m_correct_field ) {
+         cellCenter( m_BField_fc, m_BField_cc );
+         cellCenter( m_BFieldMag_fc, m_BFieldMag_cc );
+         cellCenter( m_BFieldDir_fc, m_BFieldDir_cc );
+         cellCenter( m_gradBFieldMag_fc, m_gradBFieldMag_cc );
+         cellCenter( m_curlBFieldDir_fc, m_curlBFieldDir_cc );
+         cellCenter( m_BFieldDirdotcurlBFieldDir_fc, m_BFieldDirdotcurlBFieldDir_cc );
+      }
+      else {
+         computeFieldData( m_BField_cc,
+                           m_BFieldMag_cc,
+                           m_BFieldDir_cc,
+                           m_gradBFieldMag_cc,
+                           m_curlBFieldDir_cc,
+                           m_BFieldDirdotcurlBFieldDir_cc );
+      }
+
+      m_metric_cache.put("BField_cc", m_BField_cc);
+      m_metric_cache.put("BFieldMag_cc", m_BFieldMag_cc);
+      m_metric_cache.put("BFieldDir_cc", m_BFieldDir_cc);
+      m_metric_cache.put("gradBFieldMag_cc", m_gradBFieldMag_cc);
+      m_metric_cache.put("curlBFieldDir_cc", m_curlBFieldDir_cc);
+      m_metric_cache.put("BFieldDirdotcurlBFieldDir_cc", m_BFieldDirdotcurlBFieldDir_cc);
    }
 
    // Check the mapping consistency at interblock interfaces
@@ -142,8 +184,14 @@ MagGeom::MagGeom(ParmParse&                 a_pp,
     if ( typeid(*m_coord_sys) == typeid(SingleNullCoordSys) ) {
         m_magFS_mapping_cell.define(a_grids, 3, IntVect::Zero);
         m_magFS_mapping_face.define(a_grids, 3, IntVect::Zero);
-        computeMagFluxMappingCell( m_magFS_mapping_cell);
-        computeMagFluxMappingFace( m_magFS_mapping_face);
+        if ( !m_metric_cache.get("magFS_mapping_cell", m_magFS_mapping_cell) ) {
+           computeMagFluxMappingCell( m_magFS_mapping_cell);
+           m_metric_cache.put("magFS_mapping_cell", m_magFS_mapping_cell);
+        }
+        if ( !m_metric_cache.get("magFS_mapping_face", m_magFS_mapping_face) ) {
+           computeMagFluxMappingFace( m_magFS_mapping_face);
+           m_metric_cache.put("magFS_mapping_face", m_magFS_mapping_face);
+        }
     }
 
 }
@@ -165,6 +213,14 @@ MagGeom::getMetricTerms( LevelData<FluxBox>& a_N,
 
    const DisjointBoxLayout& grids = a_N.disjointBoxLayout();
 
+   const string N_name( metricCacheName("N", a_N.ghostVect()) );
+   const string tanGradN_name( metricCacheName("tanGradN", a_tanGradN.ghostVect()) );
+   if ( metricCacheable(grids) &&
+        m_metric_cache.get(N_name, a_N) &&
+        m_metric_cache.get(tanGradN_name, a_tanGradN) ) {
+      return;
+   }
+
    for (DataIterator dit(a_N.dataIterator()); dit.ok(); ++dit) {
       const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
       coord_sys.getN(a_N[dit], a_N[dit].box());
@@ -177,6 +233,11 @@ MagGeom::getMetricTerms( LevelData<FluxBox>& a_N,
 
    m_coord_sys->postProcessMetricData(a_N);
    m_coord_sys->postProcessMetricData(a_tanGradN);
+
+   if ( metricCacheable(grids) ) {
+      m_metric_cache.put(N_name, a_N);
+      m_metric_cache.put(tanGradN_name, a_tanGradN);
+   }
 }
 
 
@@ -192,18 +253,24 @@ MagGeom::getCellVolumes( LevelData<FArrayBox>& a_volume ) const
 
       const DisjointBoxLayout& grids = m_cell_volume.disjointBoxLayout();
 
-      for (dit.begin(); dit.ok(); ++dit) {
-         const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
+      const string cache_name( metricCacheName("cell_volume", m_cell_volume.ghostVect()) );
+      if ( !metricCacheable(grids) || !m_metric_cache.get(cache_name, m_cell_volume) ) {
 
-         Box grown_box(grow(m_cell_volume[dit].box(),1));
-         FluxBox N(grown_box, coord_sys.getNumN());
-         coord_sys.getN(N, grown_box);
-         coord_sys.cellVol(m_cell_volume[dit], N, m_cell_volume[dit].box());
-      }
+         for (dit.begin(); dit.ok(); ++dit) {
+            const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
+
+            Box grown_box(grow(m_cell_volume[dit].box(),1));
+            FluxBox N(grown_box, coord_sys.getNumN());
+            coord_sys.getN(N, grown_box);
+            coord_sys.cellVol(m_cell_volume[dit], N, m_cell_volume[dit].box());
+         }
 
-      m_coord_sys->postProcessMetricData(m_cell_volume);
+         m_coord_sys->postProcessMetricData(m_cell_volume);
 
-      m_cell_volume.exchange();
+         m_cell_volume.exchange();
+
+         if ( metricCacheable(grids) ) m_metric_cache.put(cache_name, m_cell_volume);
+      }
    }
 
 
@@ -223,14 +290,20 @@ MagGeom::getJ( LevelData<FArrayBox>& a_J ) const
 
       const DisjointBoxLayout& grids = a_J.disjointBoxLayout();
 
-      for (DataIterator dit(grids); dit.ok(); ++dit) {
-         const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
-         coord_sys.getAvgJ(m_J[dit], m_J[dit].box());
-      }
+      const string cache_name( metricCacheName("J", m_J.ghostVect()) );
+      if ( !metricCacheable(grids) || !m_metric_cache.get(cache_name, m_J) ) {
 
-      m_coord_sys->postProcessMetricData(m_J);
+         for (DataIterator dit(grids); dit.ok(); ++dit) {
+            const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
+            coord_sys.getAvgJ(m_J[dit], m_J[dit].box());
+         }
 
-      m_J.exchange();
+         m_coord_sys->postProcessMetricData(m_J);
+
+         m_J.exchange();
+
+         if ( metricCacheable(grids) ) m_metric_cache.put(cache_name, m_J);
+      }
    }
 
    for (DataIterator dit(a_J.dataIterator()); dit.ok(); ++dit) {
@@ -250,14 +323,20 @@ MagGeom::getPointwiseN( LevelData<FluxBox>& a_N ) const
 
       const DisjointBoxLayout& grids = m_N_face_centered.disjointBoxLayout();
 
-      for (dit.begin(); dit.ok(); ++dit) {
-         const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
-         coord_sys.getPointwiseN(m_N_face_centered[dit]);
-      }
+      const string cache_name( metricCacheName("pointwise_N", m_N_face_centered.ghostVect()) );
+      if ( !metricCacheable(grids) || !m_metric_cache.get(cache_name, m_N_face_centered) ) {
 
-      m_coord_sys->postProcessMetricData(m_N_face_centered);
+         for (dit.begin(); dit.ok(); ++dit) {
+            const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
+            coord_sys.getPointwiseN(m_N_face_centered[dit]);
+         }
+
+         m_coord_sys->postProcessMetricData(m_N_face_centered);
 
-      m_N_face_centered.exchange();
+         m_N_face_centered.exchange();
+
+         if ( metricCacheable(grids) ) m_metric_cache.put(cache_name, m_N_face_centered);
+      }
    }
 
    for (dit.begin(); dit.ok(); ++dit) {
@@ -279,14 +358,20 @@ MagGeom::getPointwiseNJinverse( LevelData<FluxBox>& a_NJinverse ) const
 
       const DisjointBoxLayout& grids = m_NJinverse_face_centered.disjointBoxLayout();
 
-      for (dit.begin(); dit.ok(); ++dit) {
-         const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
-         coord_sys.getPointwiseNJInverse(m_NJinverse_face_centered[dit]);
-      }
+      const string cache_name( metricCacheName("pointwise_NJinverse", m_NJinverse_face_centered.ghostVect()) );
+      if ( !metricCacheable(grids) || !m_metric_cache.get(cache_name, m_NJinverse_face_centered) ) {
+
+         for (dit.begin(); dit.ok(); ++dit) {
+            const MagBlockCoordSys& coord_sys = getBlockCoordSys(grids[dit]);
+            coord_sys.getPointwiseNJInverse(m_NJinverse_face_centered[dit]);
+         }
+
+         m_coord_sys->postProcessMetricData(m_NJinverse_face_centered);
 
-      m_coord_sys->postProcessMetricData(m_NJinverse_face_centered);
+         m_NJinverse_face_centered.exchange();
 
-      m_NJinverse_face_centered.exchange();
+         if ( metricCacheable(grids) ) m_metric_cache.put(cache_name, m_NJinverse_face_centered);
+      }
    }
 
    for (dit.begin(); dit.ok(); ++dit) {
@@ -370,6 +455,11 @@ MagGeom::getFaceAreas( LevelData<FluxBox>& a_areas ) const
 {
   const DisjointBoxLayout& grids = a_areas.disjointBoxLayout();
 
+  const string cache_name( metricCacheName("face_areas", a_areas.ghostVect()) );
+  if ( metricCacheable(grids) && m_metric_cache.get(cache_name, a_areas) ) {
+    return;
+  }
+
   DataIterator dit = a_areas.dataIterator();
   for (dit.begin(); dit.ok(); ++dit) {
     FluxBox& this_areas = a_areas[dit];
@@ -387,6 +477,8 @@ MagGeom::getFaceAreas( LevelData<FluxBox>& a_areas ) const
   }
 
   m_coord_sys->postProcessMetricData(a_areas);
+
+  if ( metricCacheable(grids) ) m_metric_cache.put(cache_name, a_areas);
 }
 
 
@@ -2595,5 +2687,105 @@ MagGeom::computeMappedPoloidalGradientWithGhosts( const LevelData<FArrayBox>& a_
    
    a_field.exchange();
 }
+
+
+
+std::string
+MagGeom::metricCacheKey( const DisjointBoxLayout& a_grids,
+                         const int                a_ghosts ) const
+{
+   std::ostringstream key;
+   key << std::setprecision(17);
+
+   key << numProc() << " " << a_ghosts << " " << m_correct_field << " "
+       << m_extrablock_exchange << " " << m_model_geometry << "\n";
+
+   for (LayoutIterator lit(a_grids.layoutIterator()); lit.ok(); ++lit) {
+      key << a_grids[lit()] << " " << a_grids.procID(lit()) << "\n";
+   }
+
+   // The mapping and field input files, read by the single-null geometries.
+   // Only rank 0 reads and hashes them; its key is broadcast below.
+   const std::string input_files[] = {"geometry_file", "field_coefficients_file"};
+   const std::string pp_names[] = {SingleNullBlockCoordSys::pp_name, SNCoreBlockCoordSys::pp_name};
+   for (int i=0; i<2; ++i) {
+      ParmParse pp( (m_pp_prefix + "." + pp_names[i]).c_str() );
+      for (int j=0; j<2; ++j) {
+         if ( pp.contains(input_files[j].c_str()) ) {
+            std::string filename;
+            pp.get(input_files[j].c_str(), filename);
+            key << filename << " " << (procID()==0? MetricCache::hashFile(filename): 0) << "\n";
+         }
+      }
+   }
+
+   // Sample the mapping and the field at the lower corner of each block, so
+   // that changes of the analytic parameters are also detected
+   for (int block=0; block<m_coord_sys->numBlocks(); ++block) {
+      const MagBlockCoordSys& coord_sys = getBlockCoordSys(block);
+      const Box& domain_box = coord_sys.domain().domainBox();
+      key << coord_sys.geometryType() << " " << domain_box << " " << coord_sys.dx()
+          << " " << coord_sys.getRBtoroidal() << "\n";
+
+      Box sample_box(domain_box.smallEnd(), domain_box.smallEnd() + IntVect::Unit);
+      sample_box &= domain_box;
+
+      FArrayBox xi(sample_box, SpaceDim);
+      coord_sys.getCellCenteredMappedCoords(xi);
+      FArrayBox BField(sample_box, 3);
+      FArrayBox BFieldMag(sample_box, 1);
+      FArrayBox BFieldDir(sample_box, 3);
+      FArrayBox gradBFieldMag(sample_box, 3);
+      FArrayBox curlBFieldDir(sample_box, 3);
+      FArrayBox BFieldDirdotcurlBFieldDir(sample_box, 1);
+      coord_sys.computeFieldData(5, BField, BFieldMag, BFieldDir, gradBFieldMag,
+                                 curlBFieldDir, BFieldDirdotcurlBFieldDir);
+
+      for (BoxIterator bit(sample_box); bit.ok(); ++bit) {
+         const IntVect& iv = bit();
+         RealVect this_xi;
+         for (int dir=0; dir<SpaceDim; ++dir) {
+            this_xi[dir] = xi(iv,dir);
+         }
+         key << coord_sys.realCoord(this_xi);
+         for (int comp=0; comp<3; ++comp) {
+            key << " " << BField(iv,comp);
+         }
+         key << "\n";
+      }
+   }
+
+   unsigned long long key_hash = MetricCache::hash(key.str());
+#ifdef CH_MPI
+   MPI_Bcast(&key_hash, 1, MPI_UNSIGNED_LONG_LONG, 0, MPI_COMM_WORLD);
+#endif
+
+   char hex[20];
+   sprintf(hex, "%016llx", key_hash);
+   return std::string(hex);
+}
+
+
+
+bool
+MagGeom::metricCacheable( const DisjointBoxLayout& a_grids ) const
+{
+   // Only data on the layout of this geometry is identified by the cache key
+   return m_metric_cache.isDefined() && a_grids == gridsFull();
+}
+
+
+
+std::string
+MagGeom::metricCacheName( const std::string& a_name,
+                          const IntVect&     a_ghosts ) const
+{
+   std::ostringstream name;
+   name << a_name;
+   for (int dir=0; dir<SpaceDim; ++dir) {
+      name << "_" << a_ghosts[dir];
+   }
+   return name.str();
+}
    
 #include "NamespaceFooter.H"
@@ -0,0 +1,290 @@
+#include "MetricCache.H"
+#include "SPMD.H"
+#include "parstream.H"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "NamespaceHeader.H"
+
+static const char s_magic[8] = {'G','K','M','E','T','R','I','C'};
+static const int s_version = 1;
+
+
+MetricCache::MetricCache()
+   : m_defined(false),
+     m_modified(false),
+     m_num_loaded(0),
+     m_num_stored(0)
+{
+}
+
+
+void
+MetricCache::define( const std::string& a_directory,
+                     const std::string& a_key )
+{
+   m_directory = a_directory;
+   m_key = a_key;
+   m_entries.clear();
+   m_modified = false;
+   m_defined = true;
+
+   // A missing, truncated or foreign file just leaves the cache empty
+   std::ifstream in( fileName().c_str(), std::ios::in | std::ios::binary );
+   if ( !in.good() ) return;
+
+   char magic[8];
+   int version(0), num_entries(0);
+   in.read( magic, 8 );
+   in.read( (char*)&version, sizeof(int) );
+   in.read( (char*)&num_entries, sizeof(int) );
+   if ( !in.good() || std::string(magic, 8) != std::string(s_magic, 8) || version != s_version ) return;
+
+   std::map<std::string, Entry> entries;
+   for (int n(0); n<num_entries; n++) {
+      int name_size(0), num_ints(0);
+      long long num_reals(0);
+      in.read( (char*)&name_size, sizeof(int) );
+      if ( !in.good() || name_size < 0 ) return;
+      std::string name( name_size, ' ' );
+      if ( name_size > 0 ) in.read( &name[0], name_size );
+
+      in.read( (char*)&num_ints, sizeof(int) );
+      if ( !in.good() || num_ints < 0 ) return;
+      Entry& entry( entries[name] );
+      entry.boxes.resize( num_ints );
+      if ( num_ints > 0 ) in.read( (char*)&entry.boxes[0], num_ints * sizeof(int) );
+
+      in.read( (char*)&num_reals, sizeof(long long) );
+      if ( !in.good() || num_reals < 0 ) return;
+      entry.data.resize( num_reals );
+      if ( num_reals > 0 ) in.read( (char*)&entry.data[0], num_reals * sizeof(Real) );
+      if ( !in.good() ) return;
+   }
+
+   m_entries.swap( entries );
+}
+
+
+bool
+MetricCache::get( const std::string&     a_name,
+                  LevelData<FArrayBox>& a_data )
+{
+   std::vector<FArrayBox*> fabs;
+   for (DataIterator dit(a_data.dataIterator()); dit.ok(); ++dit) {
+      fabs.push_back( &a_data[dit] );
+   }
+   return getFabs( a_name, fabs );
+}
+
+
+bool
+MetricCache::get( const std::string&   a_name,
+                  LevelData<FluxBox>& a_data )
+{
+   std::vector<FArrayBox*> fabs;
+   for (DataIterator dit(a_data.dataIterator()); dit.ok(); ++dit) {
+      for (int dir(0); dir<SpaceDim; dir++) {
+         fabs.push_back( &a_data[dit][dir] );
+      }
+   }
+   return getFabs( a_name, fabs );
+}
+
+
+void
+MetricCache::put( const std::string&          a_name,
+                  const LevelData<FArrayBox>& a_data )
+{
+   std::vector<const FArrayBox*> fabs;
+   for (DataIterator dit(a_data.dataIterator()); dit.ok(); ++dit) {
+      fabs.push_back( &a_data[dit] );
+   }
+   putFabs( a_name, fabs );
+}
+
+
+void
+MetricCache::put( const std::string&        a_name,
+                  const LevelData<FluxBox>& a_data )
+{
+   std::vector<const FArrayBox*> fabs;
+   for (DataIterator dit(a_data.dataIterator()); dit.ok(); ++dit) {
+      for (int dir(0); dir<SpaceDim; dir++) {
+         fabs.push_back( &a_data[dit][dir] );
+      }
+   }
+   putFabs( a_name, fabs );
+}
+
+
+// Each fab is described by its corners, centering and number of components
+inline
+void appendFabDescription( std::vector<int>& a_boxes,
+                           const FArrayBox&  a_fab )
+{
+   const Box& box( a_fab.box() );
+   for (int dir(0); dir<SpaceDim; dir++) {
+      a_boxes.push_back( box.smallEnd(dir) );
+      a_boxes.push_back( box.bigEnd(dir) );
+      a_boxes.push_back( box.type(dir) );
+   }
+   a_boxes.push_back( a_fab.nComp() );
+}
+
+
+bool
+MetricCache::getFabs( const std::string&             a_name,
+                      const std::vector<FArrayBox*>& a_fabs )
+{
+   if ( !m_defined ) return false;
+
+   std::map<std::string, Entry>::const_iterator it( m_entries.find( a_name ) );
+
+   int found( it != m_entries.end() );
+   if ( found ) {
+      std::vector<int> boxes;
+      long long size(0);
+      for (int n(0); n<a_fabs.size(); n++) {
+         appendFabDescription( boxes, *a_fabs[n] );
+         size += a_fabs[n]->box().numPts() * a_fabs[n]->nComp();
+      }
+      found = ( boxes == it->second.boxes && size == it->second.data.size() );
+   }
+
+   int found_everywhere( found );
+#ifdef CH_MPI
+   MPI_Allreduce( &found, &found_everywhere, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD );
+#endif
+   if ( !found_everywhere ) return false;
+
+   const Real* src( it->second.data.empty()? NULL: &(it->second.data[0]) );
+   for (int n(0); n<a_fabs.size(); n++) {
+      const long long size( a_fabs[n]->box().numPts() * a_fabs[n]->nComp() );
+      std::copy( src, src + size, a_fabs[n]->dataPtr() );
+      src += size;
+   }
+
+   m_num_loaded++;
+   return true;
+}
+
+
+void
+MetricCache::putFabs( const std::string&                   a_name,
+                      const std::vector<const FArrayBox*>& a_fabs )
+{
+   if ( !m_defined ) return;
+
+   Entry& entry( m_entries[a_name] );
+   entry.boxes.clear();
+   entry.data.clear();
+   for (int n(0); n<a_fabs.size(); n++) {
+      appendFabDescription( entry.boxes, *a_fabs[n] );
+      const long long size( a_fabs[n]->box().numPts() * a_fabs[n]->nComp() );
+      entry.data.insert( entry.data.end(), a_fabs[n]->dataPtr(), a_fabs[n]->dataPtr() + size );
+   }
+
+   m_modified = true;
+   m_num_stored++;
+}
+
+
+void
+MetricCache::write()
+{
+   if ( !m_defined ) return;
+
+   int modified( m_modified );
+   int modified_anywhere( modified );
+#ifdef CH_MPI
+   MPI_Allreduce( &modified, &modified_anywhere, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD );
+#endif
+
+   if ( modified_anywhere ) {
+      if (procID()==0) {
+         // only works the first time, subsequent failure is normal and expected
+         mkdir( m_directory.c_str(), 0777 );
+      }
+#ifdef CH_MPI
+      MPI_Barrier( MPI_COMM_WORLD );
+#endif
+
+      // Written under a temporary name, so that an interrupted write never
+      // leaves a file that a later run would load
+      const std::string filename( fileName() );
+      const std::string tmp_filename( filename + ".tmp" );
+      std::ofstream out( tmp_filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+      const int num_entries( m_entries.size() );
+      out.write( s_magic, 8 );
+      out.write( (const char*)&s_version, sizeof(int) );
+      out.write( (const char*)&num_entries, sizeof(int) );
+      for (std::map<std::string, Entry>::const_iterator it(m_entries.begin()); it!=m_entries.end(); ++it) {
+         const int name_size( it->first.size() );
+         const int num_ints( it->second.boxes.size() );
+         const long long num_reals( it->second.data.size() );
+         out.write( (const char*)&name_size, sizeof(int) );
+         out.write( it->first.data(), name_size );
+         out.write( (const char*)&num_ints, sizeof(int) );
+         if ( num_ints > 0 ) out.write( (const char*)&it->second.boxes[0], num_ints * sizeof(int) );
+         out.write( (const char*)&num_reals, sizeof(long long) );
+         if ( num_reals > 0 ) out.write( (const char*)&it->second.data[0], num_reals * sizeof(Real) );
+      }
+      out.close();
+
+      if ( out.fail() || std::rename( tmp_filename.c_str(), filename.c_str() ) != 0 ) {
+         std::remove( tmp_filename.c_str() );
+         pout() << "MetricCache::write: could not write " << filename << endl;
+      }
+   }
+
+   m_entries.clear();
+   m_modified = false;
+   m_defined = false;
+}
+
+
+unsigned long long
+MetricCache::hash( const std::string&       a_data,
+                   const unsigned long long a_seed )
+{
+   unsigned long long h( a_seed );
+   for (int i(0); i<a_data.size(); i++) {
+      h ^= (unsigned char)a_data[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+
+unsigned long long
+MetricCache::hashFile( const std::string& a_filename )
+{
+   std::ifstream in( a_filename.c_str(), std::ios::in | std::ios::binary );
+   if ( !in.good() ) return 0;
+
+   unsigned long long h( hash( "" ) );
+   char buffer[65536];
+   while ( in.good() ) {
+      in.read( buffer, sizeof(buffer) );
+      h = hash( std::string( buffer, in.gcount() ), h );
+   }
+   return h;
+}
+
+
+std::string
+MetricCache::fileName() const
+{
+   std::ostringstream filename;
+   filename << m_directory << "/metrics_" << m_key << "." << procID();
+   return filename.str();
+}
+
+
+#include "NamespaceFooter.H"
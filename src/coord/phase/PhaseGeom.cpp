@@ -5,6 +5,9 @@
 #include "newMappedGridIO.H"
 #include "CONSTANTS.H"
 #include "inspect.H"
+#include "CH_Timer.H"
+#include "GKProfiler.H"
+#include "LayoutMatch.H"
 
 #include "EdgeToCell.H"
 
@@ -152,6 +155,7 @@ PhaseGeom::PhaseGeom( const PhaseGeom& a_phase_geom,
      m_curlbFace(a_phase_geom.m_curlbFace),
      m_BMagFace(a_phase_geom.m_BMagFace),
      m_bdotcurlbFace(a_phase_geom.m_bdotcurlbFace),
+     m_box_work(a_phase_geom.m_box_work),
      m_mblexPtr(a_phase_geom.m_mblexPtr),
      m_exchange_transverse_block_register(a_phase_geom.m_exchange_transverse_block_register),
      m_velocity_type(a_phase_geom.m_velocity_type),
@@ -180,6 +184,8 @@ PhaseGeom::define()
    CFG::IntVect cfg_ghostVect(config_restrict(m_ghostVect));
    VEL::IntVect vel_ghostVect(vel_restrict(m_ghostVect));
 
+   m_box_work = RefCountedPtr< Vector<Real> >( new Vector<Real>(m_gridsFull.dataIterator().size(), 0.) );
+
    /*
     *  Get the configuration space data and inject into phase space
     */
@@ -447,7 +453,11 @@ PhaseGeom::computeGKVelocities( const LevelData<FluxBox>& a_Efield,
 
    const DisjointBoxLayout& grids = a_velocity.disjointBoxLayout();
 
-   for (DataIterator dit(grids.dataIterator()); dit.ok(); ++dit) {
+   DataIterator boxes( grids.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
+      double start = GKProfiler::wallTime();
       const PhaseBlockCoordSys& block_coord_sys = getBlockCoordSys(grids[dit]);
       RealVect dx = block_coord_sys.dx();
 
@@ -478,6 +488,7 @@ PhaseGeom::computeGKVelocities( const LevelData<FluxBox>& a_Efield,
                                   CHF_FRA(this_velocity_dir)
                                   );
       }
+      addBoxWork(grids, ibox, GKProfiler::wallTime() - start);
    }
 }
 
@@ -834,7 +845,10 @@ PhaseGeom::computeMetricTermProductAverage( LevelData<FluxBox>&       a_Product,
       computeTangentialGradSpecial(tanGradF, a_F);
    }
 
-   for (DataIterator dit(grids); dit.ok(); ++dit) {
+   DataIterator boxes( grids );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const CFG::MagBlockCoordSys& mag_block_coord_sys = getMagBlockCoordSys(grids[dit]);
 
       const FluxBox& thisF = a_F[dit];
@@ -1075,13 +1089,15 @@ PhaseGeom::mappedGridDivergence(LevelData<FArrayBox>&     a_divF,
                                            a_divF.ghostVect());
 
    const DisjointBoxLayout& grids = a_divF.disjointBoxLayout();
-   DataIterator dit = grids.dataIterator();
+   DataIterator boxes = grids.dataIterator();
 
    if ( a_omit_NT ) {
      // Get the normal component of the input flux and multiply it by
      // the face area
 
-     for (dit.begin(); dit.ok(); ++dit) {
+#pragma omp parallel for
+     for (int ibox=0; ibox<boxes.size(); ibox++) {
+        const DataIndex& dit( boxes[ibox] );
        const PhaseBlockCoordSys& block_coord_sys = getBlockCoordSys(grids[dit]);
        RealVect dx = block_coord_sys.dx();
        FluxBox& thisFluxNormal = FluxNormal[dit];
@@ -1121,7 +1137,10 @@ PhaseGeom::mappedGridDivergence(LevelData<FArrayBox>&     a_divF,
 #endif
 
    // Now compute the divergence in the usual way
-   for (dit.begin(); dit.ok(); ++dit) {
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
+      double start = GKProfiler::wallTime();
       FArrayBox& thisDiv = a_divF[dit];
       FluxBox& thisFluxNormal = FluxNormal[dit];
       // First, set divF to 0
@@ -1139,6 +1158,7 @@ PhaseGeom::mappedGridDivergence(LevelData<FArrayBox>&     a_divF,
                              CHF_CONST_REAL(fakeDx),
                              CHF_INT(dir));
       }
+      addBoxWork(grids, ibox, GKProfiler::wallTime() - start);
    }
 }
 
@@ -1149,9 +1169,10 @@ PhaseGeom::mappedGridDivergenceFromFluxNormals( LevelData<FArrayBox>&      a_div
 {
    CH_assert(a_F.nComp() == a_divF.nComp());
    const DisjointBoxLayout& grids = a_divF.disjointBoxLayout();
-   DataIterator dit = a_divF.dataIterator();
-   for (dit.begin(); dit.ok(); ++dit)
-   {
+   DataIterator boxes = a_divF.dataIterator();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
      const PhaseBlockCoordSys& block_coord_sys = getBlockCoordSys(grids[dit]);
      RealVect dx = block_coord_sys.dx();
      FArrayBox& thisDiv = a_divF[dit];
@@ -1573,8 +1594,10 @@ PhaseGeom::getCellVolumes( LevelData<FArrayBox>& a_volume ) const
 {
    const DisjointBoxLayout& grids = a_volume.disjointBoxLayout();
 
-   DataIterator dit = grids.dataIterator();
-   for (dit.begin(); dit.ok(); ++dit) {
+   DataIterator boxes = grids.dataIterator();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       FArrayBox& this_volume = a_volume[dit];
       const Box& box(this_volume.box());
 
@@ -1595,13 +1618,65 @@ PhaseGeom::getCellVolumes( LevelData<FArrayBox>& a_volume ) const
 
 
 
+void
+PhaseGeom::addBoxWork( const DisjointBoxLayout& a_grids,
+                       const int                a_box_number,
+                       const Real               a_seconds ) const
+{
+   // Only work on the full phase space layout is attributed to boxes; each
+   // thread updates its own entry
+   if ( !m_box_work.isNull() && a_grids == m_gridsFull ) {
+      (*m_box_work)[a_box_number] += a_seconds;
+   }
+}
+
+
+
+void
+PhaseGeom::getBoxWork( Vector<Box>&  a_boxes,
+                       Vector<Real>& a_work ) const
+{
+   a_boxes.resize(0);
+   for (LayoutIterator lit(m_gridsFull.layoutIterator()); lit.ok(); ++lit) {
+      a_boxes.push_back(m_gridsFull[lit()]);
+   }
+
+   a_work.resize(a_boxes.size());
+   for (int k=0; k<a_work.size(); ++k) {
+      a_work[k] = 0.;
+   }
+
+   DataIterator boxes = m_gridsFull.dataIterator();
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      a_work[boxes[ibox].intCode()] = (*m_box_work)[ibox];
+   }
+
+#ifdef CH_MPI
+   MPI_Allreduce(MPI_IN_PLACE, &a_work[0], a_work.size(), MPI_CH_REAL, MPI_SUM, MPI_COMM_WORLD);
+#endif
+}
+
+
+
+void
+PhaseGeom::resetBoxWork() const
+{
+   for (int k=0; k<m_box_work->size(); ++k) {
+      (*m_box_work)[k] = 0.;
+   }
+}
+
+
+
 void
 PhaseGeom::multFaceAreas( LevelData<FluxBox>& a_data ) const
 {
    const DisjointBoxLayout& grids = a_data.disjointBoxLayout();
 
-   DataIterator dit = grids.dataIterator();
-   for (dit.begin(); dit.ok(); ++dit) {
+   DataIterator boxes = grids.dataIterator();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       FluxBox& this_data = a_data[dit];
       Box this_box = this_data.box();
 
@@ -1815,6 +1890,95 @@ PhaseGeom::exchangeExtraBlockGhosts( LevelData<FArrayBox>& a_data ) const
 */
 
 
+template <class T>
+inline void
+copyToLayout( LevelData<T>&            a_dst,
+              const LevelData<T>&      a_src,
+              const DisjointBoxLayout& a_grids )
+{
+   // a_grids must have the same boxes and processor assignment as a_src
+   a_dst.define(a_grids, a_src.nComp(), a_src.ghostVect());
+
+   DataIterator sdit = a_src.dataIterator();
+   DataIterator ddit = a_dst.dataIterator();
+   for (sdit.begin(),ddit.begin(); sdit.ok()&&ddit.ok(); ++sdit,++ddit) {
+      a_dst[ddit].copy(a_src[sdit]);
+   }
+}
+
+
+
+const DisjointBoxLayout&
+PhaseGeom::vpmuFlattenedGrids() const
+{
+   if ( !m_vpmu_flattened_grids.isClosed() ) {
+
+      // flatten phase space grid in the mu direction
+      DisjointBoxLayout mu_flattened_dbl;
+      adjCellLo(mu_flattened_dbl, m_gridsFull, MU_DIR, -1);
+
+      // then flatten it in the vparallel coordinate
+      adjCellLo(m_vpmu_flattened_grids, mu_flattened_dbl, VPARALLEL_DIR, -1);
+   }
+
+   return m_vpmu_flattened_grids;
+}
+
+
+
+const PhaseGeom::InjectionPlan&
+PhaseGeom::injectionPlan( const CFG::DisjointBoxLayout& a_cfg_grids,
+                          const DisjointBoxLayout&      a_injected_grids,
+                          const IntVect&                a_ghosts ) const
+{
+   // Match on boxes and processor assignment, not layout identity, so that
+   // sources defined on equivalent but separately constructed layouts share
+   // a plan
+   for (int n=0; n<m_injection_plans.size(); ++n) {
+      const InjectionPlan& plan = m_injection_plans[n];
+      if ( plan.ghosts == a_ghosts &&
+           sameDecomposition( plan.cfg_grids, a_cfg_grids ) &&
+           sameDecomposition( plan.injected_grids, a_injected_grids ) ) {
+         return plan;
+      }
+   }
+
+   // Layouts that keep changing must not grow the cache without bound
+   const int max_plans(8);
+   if ( m_injection_plans.size() >= max_plans ) {
+      m_injection_plans.resize(0);
+   }
+
+   CH_TIME("PhaseGeom::injectionPlan::define_copiers");
+
+   InjectionPlan plan;
+   plan.cfg_grids = a_cfg_grids;
+   plan.ghosts = a_ghosts;
+   plan.injected_grids = a_injected_grids;
+
+   Vector<int> spreadingDirs;
+   spreadingDirs.push_back(VPARALLEL_DIR);
+   spreadingDirs.push_back(MU_DIR);
+
+   for (int block=0; block<m_coordSysPtr->numBlocks(); ++block) {
+
+     const ProblemDomain& thisMappingDomain
+       = ((const PhaseBlockCoordSys&)(*m_coordSysPtr->getCoordSys(block))).domain();
+
+     plan.spread_copiers.push_back(
+        RefCountedPtr<Copier>( new SpreadingCopier(a_injected_grids,
+                                                   vpmuFlattenedGrids(),
+                                                   thisMappingDomain,
+                                                   a_ghosts,
+                                                   spreadingDirs) ) );
+   }
+
+   m_injection_plans.push_back(plan);
+
+   return m_injection_plans[m_injection_plans.size()-1];
+}
+
+
 void
 PhaseGeom::injectConfigurationToPhase( const CFG::LevelData<CFG::FArrayBox>& a_src,
                                        LevelData<FArrayBox>&                 a_dst ) const
@@ -1831,13 +1995,8 @@ PhaseGeom::injectConfigurationToPhase( const CFG::LevelData<CFG::FArrayBox>& a_s
 
    IntVect ghostVect = config_inject(a_src.ghostVect());
 
-   // flatten phase space grid in the mu direction
-   DisjointBoxLayout mu_flattened_dbl;
-   adjCellLo(mu_flattened_dbl, m_gridsFull, MU_DIR, -1);
-
-   // then flatten it in the vparallel coordinate
-   DisjointBoxLayout vpmu_flattened_dbl;
-   adjCellLo(vpmu_flattened_dbl, mu_flattened_dbl, VPARALLEL_DIR, -1);
+   // phase space grid flattened in the mu and vparallel directions
+   const DisjointBoxLayout& vpmu_flattened_dbl = vpmuFlattenedGrids();
 
    // create CP1 injection of CFG src data
    CP1::LevelData<CP1::FArrayBox> CP1_temp;
@@ -1856,22 +2015,22 @@ PhaseGeom::injectConfigurationToPhase( const CFG::LevelData<CFG::FArrayBox>& a_s
 
    const SpreadingOp spreadOp(spreadingDirs);
 
-   for (int block=0; block<m_coordSysPtr->numBlocks(); ++block) {
+   const InjectionPlan& plan = injectionPlan(a_src.getBoxes(),
+                                             vpmu_flattened_dst.getBoxes(),
+                                             ghostVect);
 
-     const ProblemDomain& thisMappingDomain
-       = ((const PhaseBlockCoordSys&)(*m_coordSysPtr->getCoordSys(block))).domain();
+   // move the injected data onto the layout the cached copiers were built for
+   LevelData<FArrayBox> spread_src;
+   copyToLayout(spread_src, vpmu_flattened_dst, plan.injected_grids);
 
-     SpreadingCopier spreadCopier(vpmu_flattened_dst.getBoxes(),
-                                  vpmu_flattened_dbl,
-                                  thisMappingDomain,
-                                  ghostVect,
-                                  spreadingDirs);
+   CH_TIME("PhaseGeom::injectConfigurationToPhase::spread");
+   for (int block=0; block<plan.spread_copiers.size(); ++block) {
 
      // spread injected data in the vp and mu directions
-     vpmu_flattened_dst.copyTo(vpmu_flattened_dst.interval(),
-                               a_dst, a_dst.interval(),
-                               spreadCopier,
-                               spreadOp);
+     spread_src.copyTo(spread_src.interval(),
+                       a_dst, a_dst.interval(),
+                       *plan.spread_copiers[block],
+                       spreadOp);
    }
 
    a_dst.exchange();
@@ -1893,13 +2052,8 @@ PhaseGeom::injectConfigurationToPhase( const CFG::LevelData<CFG::FluxBox>& a_src
 
    IntVect ghostVect = config_inject(a_src.ghostVect());
 
-   // flatten phase space grid in the mu direction
-   DisjointBoxLayout mu_flattened_dbl;
-   adjCellLo(mu_flattened_dbl, m_gridsFull, MU_DIR, -1);
-
-   // then flatten it in the vparallel coordinate
-   DisjointBoxLayout vpmu_flattened_dbl;
-   adjCellLo(vpmu_flattened_dbl, mu_flattened_dbl, VPARALLEL_DIR, -1);
+   // phase space grid flattened in the mu and vparallel directions
+   const DisjointBoxLayout& vpmu_flattened_dbl = vpmuFlattenedGrids();
 
    // create CP1 injection of CFG src data
    CP1::LevelData<CP1::FluxBox> CP1_temp;
@@ -1957,22 +2111,22 @@ PhaseGeom::injectConfigurationToPhase( const CFG::LevelData<CFG::FluxBox>& a_src
 
    const FaceSpreadingOp spreadOp(spreadingDirs);
 
-   for (int block=0; block<m_coordSysPtr->numBlocks(); ++block) {
+   const InjectionPlan& plan = injectionPlan(a_src.getBoxes(),
+                                             vpmu_flattened_dst.getBoxes(),
+                                             ghostVect);
 
-     const ProblemDomain& thisMappingDomain
-       = ((const PhaseBlockCoordSys&)(*m_coordSysPtr->getCoordSys(block))).domain();
+   // move the injected data onto the layout the cached copiers were built for
+   LevelData<FluxBox> spread_src;
+   copyToLayout(spread_src, vpmu_flattened_dst, plan.injected_grids);
 
-     SpreadingCopier spreadCopier(vpmu_flattened_dst.getBoxes(),
-                                  vpmu_flattened_dbl,
-                                  thisMappingDomain,
-                                  ghostVect,
-                                  spreadingDirs);
+   CH_TIME("PhaseGeom::injectConfigurationToPhase::spread");
+   for (int block=0; block<plan.spread_copiers.size(); ++block) {
 
      // spread injected data in the vp and mu directions
-     vpmu_flattened_dst.copyTo(vpmu_flattened_dst.interval(),
-                               a_dst, a_dst.interval(),
-                               spreadCopier,
-                               spreadOp);
+     spread_src.copyTo(spread_src.interval(),
+                       a_dst, a_dst.interval(),
+                       *plan.spread_copiers[block],
+                       spreadOp);
    }
 
    a_dst.exchange();
@@ -1991,13 +2145,8 @@ PhaseGeom::injectConfigurationToPhase( const CFG::LevelData<CFG::FluxBox>&   a_s
 
    IntVect ghostVect = config_inject(a_src.ghostVect());
 
-   // flatten phase space grid in the mu direction
-   DisjointBoxLayout mu_flattened_dbl;
-   adjCellLo(mu_flattened_dbl, m_gridsFull, MU_DIR, -1);
-
-   // then flatten it in the vparallel coordinate
-   DisjointBoxLayout vpmu_flattened_dbl;
-   adjCellLo(vpmu_flattened_dbl, mu_flattened_dbl, VPARALLEL_DIR, -1);
+   // phase space grid flattened in the mu and vparallel directions
+   const DisjointBoxLayout& vpmu_flattened_dbl = vpmuFlattenedGrids();
 
    // create CP1 injection of CFG src data
    CP1::LevelData<CP1::FluxBox> CP1_temp;
@@ -2034,22 +2183,22 @@ PhaseGeom::injectConfigurationToPhase( const CFG::LevelData<CFG::FluxBox>&   a_s
 
    const FaceSpreadingOp spreadOp(spreadingDirs);
 
-   for (int block=0; block<m_coordSysPtr->numBlocks(); ++block) {
+   const InjectionPlan& plan = injectionPlan(a_src.getBoxes(),
+                                             vpmu_flattened_dst.getBoxes(),
+                                             ghostVect);
 
-     const ProblemDomain& thisMappingDomain
-       = ((const PhaseBlockCoordSys&)(*m_coordSysPtr->getCoordSys(block))).domain();
+   // move the injected data onto the layout the cached copiers were built for
+   LevelData<FluxBox> spread_src;
+   copyToLayout(spread_src, vpmu_flattened_dst, plan.injected_grids);
 
-     SpreadingCopier spreadCopier(vpmu_flattened_dst.getBoxes(),
-                                  vpmu_flattened_dbl,
-                                  thisMappingDomain,
-                                  ghostVect,
-                                  spreadingDirs);
+   CH_TIME("PhaseGeom::injectConfigurationToPhase::spread");
+   for (int block=0; block<plan.spread_copiers.size(); ++block) {
 
      // spread injected data in the vp and mu directions
-     vpmu_flattened_dst.copyTo(vpmu_flattened_dst.interval(),
-                               a_dst, a_dst.interval(),
-                               spreadCopier,
-                               spreadOp);
+     spread_src.copyTo(spread_src.interval(),
+                       a_dst, a_dst.interval(),
+                       *plan.spread_copiers[block],
+                       spreadOp);
    }
 
    a_dst.exchange();
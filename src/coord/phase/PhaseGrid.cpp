@@ -1,8 +1,17 @@
 #include <sstream>
+#include <algorithm>
+#include <cmath>
 #include "Directions.H"
 #include "PhaseGrid.H"
 #include "BoxIterator.H"
 #include "DataIterator.H"
+
+#undef CH_SPACEDIM
+#define CH_SPACEDIM CFG_DIM
+#include "BoxIterator.H"
+#undef CH_SPACEDIM
+#define CH_SPACEDIM PDIM
+
 #include "SPACE.H"
 
 #include "NamespaceHeader.H"
@@ -11,10 +20,105 @@
 PhaseGrid::PhaseGrid(const Vector<ProblemDomain>&      a_domains,
                      const Vector<IntVect>&            a_decomps,
                      const vector<int>&                a_legacy_decomp,
-                     const string&                     a_mag_geom_type)
+                     const string&                     a_mag_geom_type,
+                     const PhaseDecompositionCosts*    a_costs)
+   : m_load_imbalance(1.)
 {
    Vector<Box> phase_boxes;
+   Vector<Real> box_costs;
+
+   if (a_costs) {
+      getWeightedBoxes(a_domains, a_decomps, a_legacy_decomp, a_mag_geom_type, *a_costs,
+                       phase_boxes, box_costs);
+   }
+   else {
+      getUniformBoxes(a_domains, a_decomps, a_legacy_decomp, a_mag_geom_type, phase_boxes);
+
+      // Without a cost model, every cell costs the same
+      box_costs.resize(phase_boxes.size());
+      for (int k=0; k<phase_boxes.size(); ++k) {
+         box_costs[k] = phase_boxes[k].numPts();
+      }
+   }
+
+   List<CFG::Box> config_boxes;
+   getConfigBoxes(phase_boxes, config_boxes);
+
+   // Make the layout.  This is where boxes are assigned to processes.
+   Vector<int> procMap;
+   if (a_costs) {
+      balanceBoxCosts(box_costs, procMap);
+#if CH_MPI
+      createConfigBoxComms(phase_boxes, config_boxes, procMap, m_local_config_boxes, m_local_comm);
+#else
+      assignPhaseDecompositionToProcs(phase_boxes, config_boxes, procMap, m_local_config_boxes);
+#endif
+   }
+   else {
+#if CH_MPI
+      assignPhaseDecompositionToProcs(phase_boxes, config_boxes, procMap, m_local_config_boxes, m_local_comm);
+#else
+      assignPhaseDecompositionToProcs(phase_boxes, config_boxes, procMap, m_local_config_boxes);
+#endif
+   }
+
+   m_load_imbalance = computeLoadImbalance(box_costs, procMap);
+
+   if (a_costs && procID()==0) {
+      cout << "Cost-weighted phase space decomposition: " << phase_boxes.size()
+           << " boxes on " << numProc() << " processes, estimated load imbalance (max/mean) = "
+           << m_load_imbalance << endl;
+   }
+
+   ProblemDomain prob_domain;
+
+   if ( a_mag_geom_type == "Miller" || a_mag_geom_type == "Slab" ) {
+      prob_domain = ProblemDomain(a_domains[0]);
+   }
+   else if ( a_mag_geom_type == "SingleNull" || a_mag_geom_type == "SNCore" ) {
+      Box bounding_box;
+      for (int n=0; n<phase_boxes.size(); n++) {
+         bounding_box = minBox(bounding_box, phase_boxes[n]);
+      }
+      prob_domain = ProblemDomain(bounding_box);
+   }
+   else {
+      MayDay::Error("Invalid magnetic geometry type");
+   }
+
+   m_dbl.define(phase_boxes, procMap, prob_domain);
+   m_dbl.close();
+
+   getVelocitySlices(m_dbl, m_local_config_boxes, m_local_velocity_slices);
+
+#if 0
+   for (int i=0; i<m_local_velocity_slices.size(); ++i) {
+      cout << procID() << " " << m_local_config_boxes[i] << ": ";
+      List<VEL::Box>& this_list = m_local_velocity_slices[i];
+      ListIterator<VEL::Box> it(this_list);
+      for (it.begin(); it.ok(); ++it) {
+         cout << " " << it();
+      }
+      cout << endl;
+   }
+#endif
+}
+
+
 
+PhaseGrid::~PhaseGrid()
+{
+}
+
+
+
+void
+PhaseGrid::getUniformBoxes(const Vector<ProblemDomain>& a_domains,
+                           const Vector<IntVect>&       a_decomps,
+                           const vector<int>&           a_legacy_decomp,
+                           const string&                a_mag_geom_type,
+                           Vector<Box>&                 a_phase_boxes) const
+{
    for (int block=0; block<a_domains.size(); ++block) {
 
       const Box& domain_box = a_domains[block].domainBox();
@@ -112,63 +216,297 @@ PhaseGrid::PhaseGrid(const Vector<ProblemDomain>&      a_domains,
          BoxIterator bit(skeleton);
          for (bit.begin();bit.ok();++bit) {
             Box thisBox = patch + bit()*box_size;
-            phase_boxes.push_back(thisBox);
+            a_phase_boxes.push_back(thisBox);
          }
       }
       else {
          MayDay::Error( "Phase space domain box cannot be load balanced" );
       }
    }
+}
 
-   List<CFG::Box> config_boxes;
-   getConfigBoxes(phase_boxes, config_boxes);
 
-   // Make the layout.  This is where boxes are assigned to processes.
-   Vector<int> procMap;
-#if CH_MPI
-   assignPhaseDecompositionToProcs(phase_boxes, config_boxes, procMap, m_local_config_boxes, m_local_comm);
-#else
-   assignPhaseDecompositionToProcs(phase_boxes, config_boxes, procMap, m_local_config_boxes);
-#endif
 
-   ProblemDomain prob_domain;
+void
+PhaseGrid::getWeightedBoxes(const Vector<ProblemDomain>&   a_domains,
+                            const Vector<IntVect>&         a_decomps,
+                            const vector<int>&             a_legacy_decomp,
+                            const string&                  a_mag_geom_type,
+                            const PhaseDecompositionCosts& a_costs,
+                            Vector<Box>&                   a_phase_boxes,
+                            Vector<Real>&                  a_box_costs) const
+{
+   int num_blocks = a_domains.size();
+   int num_target_boxes = a_costs.boxes_per_proc * numProc();
+   if (num_target_boxes < 1) num_target_boxes = 1;
 
-   if ( a_mag_geom_type == "Miller" || a_mag_geom_type == "Slab" ) {
-      prob_domain = ProblemDomain(a_domains[0]);
+   bool single_null = (a_mag_geom_type == "SingleNull" || a_mag_geom_type == "SNCore");
+
+   Real measured_total = 0.;
+   for (int m=0; m<a_costs.measured_costs.size(); ++m) {
+      measured_total += a_costs.measured_costs[m];
    }
-   else if ( a_mag_geom_type == "SingleNull" || a_mag_geom_type == "SNCore" ) {
-      Box bounding_box;
-      for (int n=0; n<phase_boxes.size(); n++) {
-         bounding_box = minBox(bounding_box, phase_boxes[n]);
+   bool use_measured = (measured_total > 0.) && (a_costs.measured_boxes.size() == a_costs.measured_costs.size());
+
+   // Tabulate the configuration space cost density of each block, i.e., the
+   // cost of a configuration cell summed over velocity space
+   Vector<CFG::Box> block_boxes(num_blocks);
+   Vector< vector<Real> > cell_cost(num_blocks);
+   Vector<Real> block_cost(num_blocks, 0.);
+   Real total_cost = 0.;
+
+   for (int block=0; block<num_blocks; ++block) {
+      const Box& domain_box = a_domains[block].domainBox();
+
+      projectPhaseToConfiguration(domain_box, block_boxes[block]);
+      VEL::Box vel_box;
+      projectPhaseToVelocity(domain_box, vel_box);
+
+      Real weight = (block < a_costs.block_weights.size())? a_costs.block_weights[block]: 1.;
+      if (weight <= 0.) {
+         MayDay::Error( "PhaseGrid: block weights must be positive" );
+      }
+
+      cell_cost[block].assign(block_boxes[block].numPts(), use_measured? 0.: weight * vel_box.numPts());
+   }
+
+   if (use_measured) {
+      // Spread the measured work of each box uniformly over its configuration cells
+      for (int m=0; m<a_costs.measured_boxes.size(); ++m) {
+         CFG::Box cbox;
+         projectPhaseToConfiguration(a_costs.measured_boxes[m], cbox);
+         Real density = a_costs.measured_costs[m] / cbox.numPts();
+
+         for (int block=0; block<num_blocks; ++block) {
+            CFG::Box overlap = cbox & block_boxes[block];
+            if ( !overlap.isEmpty() ) {
+               for (CFG::BoxIterator bit(overlap); bit.ok(); ++bit) {
+                  cell_cost[block][block_boxes[block].index(bit())] += density;
+               }
+            }
+         }
+      }
+   }
+
+   for (int block=0; block<num_blocks; ++block) {
+      block_cost[block] = configCost(block_boxes[block], block_boxes[block], cell_cost[block]);
+      total_cost += block_cost[block];
+   }
+
+   for (int block=0; block<num_blocks; ++block) {
+
+      const Box& domain_box = a_domains[block].domainBox();
+
+      for (int dir=0; dir<CFG_DIM; ++dir) {
+         if (domain_box.size(dir) < 4) {
+            MayDay::Error( "Phase space box is less than 4 cells wide" );
+         }
+      }
+
+      // The velocity directions keep the requested number of cuts, but the
+      // cuts need not divide the domain evenly
+      IntVect vel_decomp = IntVect::Unit;
+      for (int dir=CFG_DIM; dir<PDIM; ++dir) {
+         if (single_null) {
+            vel_decomp[dir] = a_decomps[block][dir];
+         }
+         else if (a_legacy_decomp.size() > 0) {
+            vel_decomp[dir] = a_legacy_decomp[dir];
+         }
+         if (domain_box.size(dir) < 4 * vel_decomp[dir]) {
+            MayDay::Error( "Phase space box is less than 4 cells wide" );
+         }
+      }
+
+      int num_vel_boxes = vel_decomp.product();
+      VEL::Box vel_domain;
+      projectPhaseToVelocity(domain_box, vel_domain);
+
+      // Give each block a share of the boxes in proportion to its cost
+      Real share = (total_cost > 0.)? num_target_boxes * block_cost[block] / total_cost:
+         (Real)num_target_boxes / num_blocks;
+      int num_config_boxes = (int)floor(share / num_vel_boxes + 0.5);
+      if (num_config_boxes < 1) num_config_boxes = 1;
+
+      Vector<CFG::Box> config_pieces;
+      bisectConfigBox(block_boxes[block], num_config_boxes, block_boxes[block], cell_cost[block], config_pieces);
+
+      Box skeleton(IntVect::Zero, vel_decomp - IntVect::Unit);
+
+      for (int i=0; i<config_pieces.size(); ++i) {
+         const CFG::Box& cbox = config_pieces[i];
+         Real config_cost = configCost(cbox, block_boxes[block], cell_cost[block]);
+
+         for (BoxIterator bit(skeleton); bit.ok(); ++bit) {
+            IntVect lo, hi;
+            for (int dir=0; dir<CFG_DIM; ++dir) {
+               lo[dir] = cbox.smallEnd(dir);
+               hi[dir] = cbox.bigEnd(dir);
+            }
+            for (int dir=CFG_DIM; dir<PDIM; ++dir) {
+               int n = domain_box.size(dir);
+               lo[dir] = domain_box.smallEnd(dir) + (bit()[dir] * n) / vel_decomp[dir];
+               hi[dir] = domain_box.smallEnd(dir) + ((bit()[dir] + 1) * n) / vel_decomp[dir] - 1;
+            }
+            Box thisBox(lo, hi);
+
+            VEL::Box vbox;
+            projectPhaseToVelocity(thisBox, vbox);
+
+            a_phase_boxes.push_back(thisBox);
+            a_box_costs.push_back(config_cost * vbox.numPts() / vel_domain.numPts());
+         }
+      }
+   }
+}
+
+
+
+void
+PhaseGrid::bisectConfigBox(const CFG::Box&     a_box,
+                           int                 a_num_pieces,
+                           const CFG::Box&     a_block_box,
+                           const vector<Real>& a_cell_cost,
+                           Vector<CFG::Box>&   a_pieces) const
+{
+   // Cut along the longest direction that leaves both halves at least
+   // 4 cells wide; stop early if there is none
+   int cut_dir = -1;
+   if (a_num_pieces > 1) {
+      for (int dir=0; dir<CFG_DIM; ++dir) {
+         if (a_box.size(dir) >= 8 && (cut_dir < 0 || a_box.size(dir) > a_box.size(cut_dir))) {
+            cut_dir = dir;
+         }
+      }
+   }
+
+   if (cut_dir < 0) {
+      a_pieces.push_back(a_box);
+      return;
+   }
+
+   int num_lo = a_num_pieces / 2;
+   int lo = a_box.smallEnd(cut_dir);
+   int n = a_box.size(cut_dir);
+
+   vector<Real> profile(n, 0.);
+   Real total = 0.;
+   for (CFG::BoxIterator bit(a_box); bit.ok(); ++bit) {
+      Real cost = a_cell_cost[a_block_box.index(bit())];
+      profile[bit()[cut_dir] - lo] += cost;
+      total += cost;
+   }
+
+   // Place the cut where the cost below it is closest to the share of the
+   // lower pieces
+   int width;
+   if (total > 0.) {
+      Real target = total * num_lo / a_num_pieces;
+      Real sum = 0.;
+      Real best_error = total;
+      width = 4;
+      for (int i=0; i<n-4; ++i) {
+         sum += profile[i];
+         if (i+1 >= 4 && fabs(sum - target) < best_error) {
+            best_error = fabs(sum - target);
+            width = i+1;
+         }
       }
-      prob_domain = ProblemDomain(bounding_box);
    }
    else {
-      MayDay::Error("Invalid magnetic geometry type");
+      width = (n * num_lo) / a_num_pieces;
+      if (width < 4) width = 4;
+      if (width > n-4) width = n-4;
    }
 
-   m_dbl.define(phase_boxes, procMap, prob_domain);
-   m_dbl.close();
+   CFG::Box box_lo(a_box);
+   CFG::Box box_hi(a_box);
+   box_lo.setBig(cut_dir, lo + width - 1);
+   box_hi.setSmall(cut_dir, lo + width);
 
-   getVelocitySlices(m_dbl, m_local_config_boxes, m_local_velocity_slices);
+   bisectConfigBox(box_lo, num_lo, a_block_box, a_cell_cost, a_pieces);
+   bisectConfigBox(box_hi, a_num_pieces - num_lo, a_block_box, a_cell_cost, a_pieces);
+}
 
-#if 0
-   for (int i=0; i<m_local_velocity_slices.size(); ++i) {
-      cout << procID() << " " << m_local_config_boxes[i] << ": ";
-      List<VEL::Box>& this_list = m_local_velocity_slices[i];
-      ListIterator<VEL::Box> it(this_list);
-      for (it.begin(); it.ok(); ++it) {
-         cout << " " << it();
+
+
+Real
+PhaseGrid::configCost(const CFG::Box&     a_box,
+                      const CFG::Box&     a_block_box,
+                      const vector<Real>& a_cell_cost) const
+{
+   Real cost = 0.;
+   for (CFG::BoxIterator bit(a_box); bit.ok(); ++bit) {
+      cost += a_cell_cost[a_block_box.index(bit())];
+   }
+   return cost;
+}
+
+
+
+void
+PhaseGrid::balanceBoxCosts(const Vector<Real>& a_box_costs,
+                           Vector<int>&        a_procMap) const
+{
+   // The boxes are ordered block by block and configuration box by
+   // configuration box, so assigning contiguous runs of roughly equal cost
+   // keeps the processes sharing a configuration box together.
+   int nproc = numProc();
+   int num_boxes = a_box_costs.size();
+
+   // Every process must own at least one box
+   if (num_boxes < nproc) {
+      stringstream msg("PhaseGrid: the cost-weighted decomposition has ", ios_base::out|ios_base::ate);
+      msg << num_boxes << " boxes for " << nproc << " processes; increase gksystem.decomp_boxes_per_proc";
+      MayDay::Error( msg.str().c_str() );
+   }
+
+   Real total = 0.;
+   for (int k=0; k<num_boxes; ++k) {
+      total += a_box_costs[k];
+   }
+   Real target = total / nproc;
+
+   a_procMap.resize(num_boxes);
+
+   int proc = 0;
+   int num_on_proc = 0;
+   Real cumulative = 0.;
+   for (int k=0; k<num_boxes; ++k) {
+      if (proc < nproc-1 && num_on_proc > 0) {
+         bool past_share = cumulative + 0.5 * a_box_costs[k] > (proc+1) * target;
+         bool boxes_short = num_boxes - k <= nproc - 1 - proc;
+         if (past_share || boxes_short) {
+            proc++;
+            num_on_proc = 0;
+         }
       }
-      cout << endl;
+      a_procMap[k] = proc;
+      num_on_proc++;
+      cumulative += a_box_costs[k];
    }
-#endif
 }
 
 
 
-PhaseGrid::~PhaseGrid()
+Real
+PhaseGrid::computeLoadImbalance(const Vector<Real>& a_box_costs,
+                                const Vector<int>&  a_procMap) const
 {
+   int nproc = numProc();
+   Vector<Real> load(nproc, 0.);
+   Real total = 0.;
+   for (int k=0; k<a_box_costs.size(); ++k) {
+      load[a_procMap[k]] += a_box_costs[k];
+      total += a_box_costs[k];
+   }
+
+   Real max_load = 0.;
+   for (int proc=0; proc<nproc; ++proc) {
+      if (load[proc] > max_load) max_load = load[proc];
+   }
+
+   return (total > 0.)? max_load * nproc / total: 1.;
 }
 
 
@@ -290,6 +628,63 @@ PhaseGrid::assignPhaseDecompositionToProcs(const Vector<Box>& a_phase_boxes,
       delete [] num_group_processors;
    }
 
+   createConfigBoxComms(a_config_boxes, groups, a_local_config_boxes, a_local_comm);
+
+   delete [] groups;
+}
+
+
+
+void
+PhaseGrid::createConfigBoxComms(const Vector<Box>& a_phase_boxes,
+                                List<CFG::Box>&    a_config_boxes,
+                                const Vector<int>& a_procMap,
+                                Vector<CFG::Box>&  a_local_config_boxes,
+                                Vector<MPI_Comm>&  a_local_comm) const
+{
+   // Each configuration box group consists of the processes owning any of
+   // its phase space boxes
+   MPI_Group world_group;
+   MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+
+   int num_groups = a_config_boxes.length();
+   MPI_Group* groups = new MPI_Group[num_groups];
+
+   int group_number = 0;
+   ListIterator<CFG::Box> it(a_config_boxes);
+   for (it.begin(); it.ok(); ++it) {
+      CFG::Box& config_box = it();
+
+      vector<int> ranks;
+      for (int k=0; k<a_phase_boxes.size(); ++k) {
+         CFG::Box cbox;
+         projectPhaseToConfiguration(a_phase_boxes[k], cbox);
+
+         if (cbox == config_box) {
+            ranks.push_back(a_procMap[k]);
+         }
+      }
+      sort(ranks.begin(), ranks.end());
+      ranks.erase(unique(ranks.begin(), ranks.end()), ranks.end());
+
+      MPI_Group_incl(world_group, ranks.size(), &ranks[0], &groups[group_number]);
+
+      group_number++;
+   }
+
+   createConfigBoxComms(a_config_boxes, groups, a_local_config_boxes, a_local_comm);
+
+   delete [] groups;
+}
+
+
+
+void
+PhaseGrid::createConfigBoxComms(List<CFG::Box>&    a_config_boxes,
+                                MPI_Group*         a_groups,
+                                Vector<CFG::Box>&  a_local_config_boxes,
+                                Vector<MPI_Comm>&  a_local_comm) const
+{
    List<CFG::Box> box_list;
    List<MPI_Comm> comm_list;
 
@@ -299,7 +694,7 @@ PhaseGrid::assignPhaseDecompositionToProcs(const Vector<Box>& a_phase_boxes,
       CFG::Box& config_box = it();
 
       MPI_Comm newcomm;
-      MPI_Comm_create(MPI_COMM_WORLD, groups[group_number], &newcomm);
+      MPI_Comm_create(MPI_COMM_WORLD, a_groups[group_number], &newcomm);
 
       // A valid communicator is only returned by the preceding call on processors
       // contained in the current group.  We exploit this to construct the list
@@ -326,8 +721,6 @@ PhaseGrid::assignPhaseDecompositionToProcs(const Vector<Box>& a_phase_boxes,
    for (ListIterator<MPI_Comm> it(comm_list); it.ok(); ++it) {
       a_local_comm[index++] = it();
    }
-
-   delete [] groups;
 }
 #else
 
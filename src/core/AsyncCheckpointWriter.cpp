@@ -0,0 +1,633 @@
+#include "AsyncCheckpointWriter.H"
+#include "CH_Timer.H"
+#include "GKProfiler.H"
+
+#undef CH_SPACEDIM
+#define CH_SPACEDIM CFG_DIM
+#include "BoxIterator.H"
+#undef CH_SPACEDIM
+#define CH_SPACEDIM PDIM
+
+#include "NamespaceHeader.H"
+
+
+static void writeSmallDataset( hid_t       a_group,
+                               const char* a_name,
+                               hid_t       a_type,
+                               hsize_t     a_size,
+                               const void* a_data )
+{
+   // Every process writes the same values, as for the field histories
+   hsize_t flatdims[1];
+   flatdims[0] = a_size;
+
+   hid_t dataspace = H5Screate_simple(1, flatdims, NULL);
+#ifdef H516
+   hid_t dataset   = H5Dcreate(a_group, a_name, a_type, dataspace, H5P_DEFAULT);
+#else
+   hid_t dataset   = H5Dcreate(a_group, a_name, a_type, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+#endif
+   hid_t memdataspace = H5Screate_simple(1, flatdims, NULL);
+   H5Dwrite(dataset, a_type, memdataspace, dataspace, H5P_DEFAULT, a_data);
+   H5Sclose(memdataspace);
+   H5Dclose(dataset);
+   H5Sclose(dataspace);
+}
+
+
+template <class T>
+static void readSmallDataset( hid_t           a_group,
+                              const char*     a_name,
+                              hid_t           a_type,
+                              std::vector<T>& a_data )
+{
+#ifdef H516
+   hid_t dataset = H5Dopen(a_group, a_name);
+#else
+   hid_t dataset = H5Dopen(a_group, a_name, H5P_DEFAULT);
+#endif
+   hid_t dataspace = H5Dget_space(dataset);
+   hsize_t dims[1];
+   H5Sget_simple_extent_dims(dataspace, dims, NULL);
+
+   a_data.resize(dims[0]);
+   hid_t memdataspace = H5Screate_simple(1, dims, NULL);
+   H5Dread(dataset, a_type, memdataspace, dataspace, H5P_DEFAULT, &a_data[0]);
+   H5Sclose(memdataspace);
+   H5Sclose(dataspace);
+   H5Dclose(dataset);
+}
+
+
+
+AsyncCheckpointWriter::AsyncCheckpointWriter()
+   : m_pending(false),
+     m_num_writes(0),
+     m_stage_time(0.),
+     m_drain_time(0.),
+     m_wait_time(0.)
+{
+#ifdef CH_MPI
+   MPI_Comm_dup(MPI_COMM_WORLD, &m_comm);
+#endif
+
+   if ( !threadsAvailable() && procID()==0 ) {
+      cout << "Warning: MPI does not provide MPI_THREAD_MULTIPLE; checkpoints will be written synchronously" << endl;
+   }
+}
+
+
+
+AsyncCheckpointWriter::~AsyncCheckpointWriter()
+{
+   wait();
+#ifdef CH_MPI
+   MPI_Comm_free(&m_comm);
+#endif
+}
+
+
+
+bool AsyncCheckpointWriter::threadsAvailable() const
+{
+#ifdef CH_MPI
+   int provided;
+   MPI_Query_thread(&provided);
+   return provided == MPI_THREAD_MULTIPLE;
+#else
+   return true;
+#endif
+}
+
+
+
+void AsyncCheckpointWriter::stage( const std::string&           a_filename,
+                                   const KineticSpeciesPtrVect& a_species )
+{
+   CH_TIME("AsyncCheckpointWriter::stage");
+   CH_assert( !m_pending );
+   double start = GKProfiler::wallTime();
+
+   m_filename = a_filename;
+   m_staged.resize(a_species.size());
+
+   for (int species(0); species<a_species.size(); species++) {
+
+      const LevelData<FArrayBox>& dfn( a_species[species]->distributionFunction() );
+      const DisjointBoxLayout& grids( dfn.disjointBoxLayout() );
+      StagedSpecies& staged( m_staged[species] );
+
+      char buff[100];
+      sprintf( buff, "dfn_%d", species + 1 );
+      staged.group = buff;
+      staged.ncomp = dfn.nComp();
+
+      // Global box list and the offset of each box in the data set
+      int num_boxes = grids.size();
+      staged.boxes.resize(2*SpaceDim*num_boxes);
+      staged.offsets.resize(num_boxes+1);
+      staged.offsets[0] = 0;
+
+      int n = 0;
+      for (LayoutIterator lit(grids.layoutIterator()); lit.ok(); ++lit, ++n) {
+         const Box& box( grids[lit()] );
+         for (int dir=0; dir<SpaceDim; ++dir) {
+            staged.boxes[2*SpaceDim*n + dir] = box.smallEnd(dir);
+            staged.boxes[2*SpaceDim*n + SpaceDim + dir] = box.bigEnd(dir);
+         }
+         staged.offsets[n+1] = staged.offsets[n] + box.numPts() * staged.ncomp;
+      }
+
+      // Copy the valid cells of the local boxes into the staging buffer;
+      // the buffer keeps its capacity from one checkpoint to the next
+      DataIterator boxes( grids.dataIterator() );
+      staged.local_boxes.resize(boxes.size());
+      staged.local_offsets.resize(boxes.size()+1);
+      staged.local_offsets[0] = 0;
+      for (int ibox=0; ibox<boxes.size(); ibox++) {
+         int index = boxes[ibox].intCode();
+         staged.local_boxes[ibox] = index;
+         staged.local_offsets[ibox+1] = staged.local_offsets[ibox]
+            + staged.offsets[index+1] - staged.offsets[index];
+      }
+      staged.buffer.resize(staged.local_offsets[boxes.size()]);
+
+#pragma omp parallel for
+      for (int ibox=0; ibox<boxes.size(); ibox++) {
+         const DataIndex& dit( boxes[ibox] );
+         FArrayBox staged_fab( grids[dit], staged.ncomp, &staged.buffer[staged.local_offsets[ibox]] );
+         staged_fab.copy( dfn[dit], grids[dit] );
+      }
+   }
+
+   m_stage_time += GKProfiler::wallTime() - start;
+}
+
+
+
+void AsyncCheckpointWriter::start()
+{
+   CH_assert( !m_pending );
+
+   if ( threadsAvailable() ) {
+      m_thread = std::thread(&AsyncCheckpointWriter::drain, this);
+      m_pending = true;
+   }
+   else {
+      double start = GKProfiler::wallTime();
+      drain();
+      m_wait_time += GKProfiler::wallTime() - start;
+   }
+
+   m_num_writes++;
+}
+
+
+
+void AsyncCheckpointWriter::wait()
+{
+   if ( m_pending ) {
+      CH_TIME("AsyncCheckpointWriter::wait");
+      double start = GKProfiler::wallTime();
+      m_thread.join();
+      m_wait_time += GKProfiler::wallTime() - start;
+      m_pending = false;
+   }
+}
+
+
+
+void AsyncCheckpointWriter::drain()
+{
+   double start = GKProfiler::wallTime();
+
+   hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+#ifdef CH_MPI
+   H5Pset_fapl_mpio(fapl, m_comm, MPI_INFO_NULL);
+#endif
+   hid_t file = H5Fopen(m_filename.c_str(), H5F_ACC_RDWR, fapl);
+   H5Pclose(fapl);
+
+   for (int species(0); species<m_staged.size(); species++) {
+      const StagedSpecies& staged( m_staged[species] );
+
+#ifdef H516
+      hid_t group = H5Gcreate(file, staged.group.c_str(), 0);
+#else
+      hid_t group = H5Gcreate(file, staged.group.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+#endif
+
+      writeSmallDataset(group, "comps", H5T_NATIVE_INT, 1, &staged.ncomp);
+      writeSmallDataset(group, "boxes", H5T_NATIVE_INT, staged.boxes.size(), &staged.boxes[0]);
+      writeSmallDataset(group, "offsets", H5T_NATIVE_LLONG, staged.offsets.size(), &staged.offsets[0]);
+
+      hsize_t flatdims[1];
+      flatdims[0] = staged.offsets.back();
+      hid_t dataspace = H5Screate_simple(1, flatdims, NULL);
+#ifdef H516
+      hid_t dataset   = H5Dcreate(group, "data", H5T_NATIVE_REAL, dataspace, H5P_DEFAULT);
+#else
+      hid_t dataset   = H5Dcreate(group, "data", H5T_NATIVE_REAL, dataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+#endif
+
+      // Each process writes the hyperslabs of its own boxes
+      for (int ibox=0; ibox<staged.local_boxes.size(); ++ibox) {
+         int index = staged.local_boxes[ibox];
+         hsize_t offset[1], count[1];
+         offset[0] = staged.offsets[index];
+         count[0] = staged.offsets[index+1] - staged.offsets[index];
+
+         H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+         hid_t memdataspace = H5Screate_simple(1, count, NULL);
+         H5Dwrite(dataset, H5T_NATIVE_REAL, memdataspace, dataspace, H5P_DEFAULT,
+                  &staged.buffer[staged.local_offsets[ibox]]);
+         H5Sclose(memdataspace);
+      }
+
+      H5Dclose(dataset);
+      H5Sclose(dataspace);
+      H5Gclose(group);
+   }
+
+   H5Fclose(file);
+
+   m_drain_time += GKProfiler::wallTime() - start;
+}
+
+
+
+void AsyncCheckpointWriter::printTimes() const
+{
+   double exposed = m_stage_time + m_wait_time;
+   double hidden = m_drain_time - m_wait_time;
+   if (hidden < 0.) hidden = 0.;
+
+   if (procID()==0) {
+      cout << "Checkpoint output (rank 0): " << m_num_writes << " asynchronous writes, "
+           << hidden << " s hidden, " << exposed << " s exposed ("
+           << m_stage_time << " s staging, " << m_wait_time << " s waiting)" << endl;
+   }
+}
+
+
+
+void AsyncCheckpointWriter::read( HDF5Handle&           a_handle,
+                                  LevelData<FArrayBox>& a_data )
+{
+   CH_TIME("AsyncCheckpointWriter::read");
+   hid_t group = a_handle.groupID();
+
+   std::vector<int> comps;
+   std::vector<int> box_corners;
+   std::vector<long long> offsets;
+   readSmallDataset(group, "comps", H5T_NATIVE_INT, comps);
+   readSmallDataset(group, "boxes", H5T_NATIVE_INT, box_corners);
+   readSmallDataset(group, "offsets", H5T_NATIVE_LLONG, offsets);
+
+   int ncomp = comps[0];
+   if ( ncomp != a_data.nComp() ) {
+      MayDay::Error( "AsyncCheckpointWriter::read: number of components differs from the checkpoint" );
+   }
+
+   int num_file_boxes = offsets.size() - 1;
+   Vector<Box> file_boxes(num_file_boxes);
+   for (int n=0; n<num_file_boxes; ++n) {
+      IntVect lo, hi;
+      for (int dir=0; dir<SpaceDim; ++dir) {
+         lo[dir] = box_corners[2*SpaceDim*n + dir];
+         hi[dir] = box_corners[2*SpaceDim*n + SpaceDim + dir];
+      }
+      file_boxes[n] = Box(lo, hi);
+   }
+
+#ifdef H516
+   hid_t dataset = H5Dopen(group, "data");
+#else
+   hid_t dataset = H5Dopen(group, "data", H5P_DEFAULT);
+#endif
+   hid_t dataspace = H5Dget_space(dataset);
+
+   // Each file box intersecting the local boxes is read once, in its own
+   // chunk, and copied into all of them; on an unchanged layout that is
+   // exactly one read per box.  Every process reads only what it owns, so
+   // the redistribution onto a different layout or number of processes
+   // needs no communication.
+   const DisjointBoxLayout& grids( a_data.disjointBoxLayout() );
+   for (int n=0; n<num_file_boxes; ++n) {
+      bool needed = false;
+      for (DataIterator dit(grids); !needed && dit.ok(); ++dit) {
+         needed = grids[dit].intersects( file_boxes[n] );
+      }
+      if ( !needed ) continue;
+
+      FArrayBox file_fab( file_boxes[n], ncomp );
+
+      hsize_t offset[1], count[1];
+      offset[0] = offsets[n];
+      count[0] = offsets[n+1] - offsets[n];
+
+      H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+      hid_t memdataspace = H5Screate_simple(1, count, NULL);
+      H5Dread(dataset, H5T_NATIVE_REAL, memdataspace, dataspace, H5P_DEFAULT, file_fab.dataPtr());
+      H5Sclose(memdataspace);
+
+      for (DataIterator dit(grids); dit.ok(); ++dit) {
+         Box overlap( grids[dit] & file_boxes[n] );
+         if ( !overlap.isEmpty() ) {
+            a_data[dit].copy( file_fab, overlap );
+         }
+      }
+   }
+
+   H5Sclose(dataspace);
+   H5Dclose(dataset);
+}
+
+
+void AsyncCheckpointWriter::writeConfigurationData( HDF5Handle&                           a_handle,
+                                                    const CFG::LevelData<CFG::FArrayBox>& a_data,
+                                                    const int                             a_compression )
+{
+   CH_TIME("AsyncCheckpointWriter::writeConfigurationData");
+   const CFG::DisjointBoxLayout& grids( a_data.disjointBoxLayout() );
+
+   std::vector<CFG::Box> boxes, valid_boxes;
+   for (CFG::LayoutIterator lit(grids.layoutIterator()); lit.ok(); ++lit) {
+      boxes.push_back( grow( grids[lit()], a_data.ghostVect() ) );
+      valid_boxes.push_back( grids[lit()] );
+   }
+
+   std::vector<int> local_boxes;
+   std::vector<const CFG::FArrayBox*> local_data;
+   for (CFG::DataIterator dit(grids); dit.ok(); ++dit) {
+      local_boxes.push_back( dit().intCode() );
+      local_data.push_back( &a_data[dit] );
+   }
+
+   int ncomp = a_data.nComp();
+   writeSmallDataset(a_handle.groupID(), "comps", H5T_NATIVE_INT, 1, &ncomp);
+   writeBoxData( a_handle.groupID(), "", boxes, valid_boxes, local_boxes, local_data, ncomp, a_compression );
+}
+
+
+
+void AsyncCheckpointWriter::writeConfigurationData( HDF5Handle&                         a_handle,
+                                                    const CFG::LevelData<CFG::FluxBox>& a_data,
+                                                    const int                           a_compression )
+{
+   CH_TIME("AsyncCheckpointWriter::writeConfigurationData");
+   const CFG::DisjointBoxLayout& grids( a_data.disjointBoxLayout() );
+
+   int ncomp = a_data.nComp();
+   writeSmallDataset(a_handle.groupID(), "comps", H5T_NATIVE_INT, 1, &ncomp);
+
+   // One set of datasets per face direction, suffixed by the direction
+   for (int dir=0; dir<CFG_DIM; ++dir) {
+      std::vector<CFG::Box> boxes, valid_boxes;
+      for (CFG::LayoutIterator lit(grids.layoutIterator()); lit.ok(); ++lit) {
+         boxes.push_back( surroundingNodes( grow( grids[lit()], a_data.ghostVect() ), dir ) );
+         valid_boxes.push_back( surroundingNodes( grids[lit()], dir ) );
+      }
+
+      std::vector<int> local_boxes;
+      std::vector<const CFG::FArrayBox*> local_data;
+      for (CFG::DataIterator dit(grids); dit.ok(); ++dit) {
+         local_boxes.push_back( dit().intCode() );
+         local_data.push_back( &a_data[dit][dir] );
+      }
+
+      char suffix[10];
+      sprintf( suffix, "_%d", dir );
+      writeBoxData( a_handle.groupID(), suffix, boxes, valid_boxes, local_boxes, local_data, ncomp, a_compression );
+   }
+}
+
+
+
+void AsyncCheckpointWriter::readConfigurationData( HDF5Handle&                     a_handle,
+                                                   CFG::LevelData<CFG::FArrayBox>& a_data )
+{
+   CH_TIME("AsyncCheckpointWriter::readConfigurationData");
+   std::vector<CFG::FArrayBox*> local_data;
+   for (CFG::DataIterator dit(a_data.dataIterator()); dit.ok(); ++dit) {
+      local_data.push_back( &a_data[dit] );
+   }
+   readBoxData( a_handle.groupID(), "", local_data );
+}
+
+
+
+void AsyncCheckpointWriter::readConfigurationData( HDF5Handle&                   a_handle,
+                                                   CFG::LevelData<CFG::FluxBox>& a_data )
+{
+   CH_TIME("AsyncCheckpointWriter::readConfigurationData");
+   for (int dir=0; dir<CFG_DIM; ++dir) {
+      std::vector<CFG::FArrayBox*> local_data;
+      for (CFG::DataIterator dit(a_data.dataIterator()); dit.ok(); ++dit) {
+         local_data.push_back( &a_data[dit][dir] );
+      }
+      char suffix[10];
+      sprintf( suffix, "_%d", dir );
+      readBoxData( a_handle.groupID(), suffix, local_data );
+   }
+}
+
+
+
+void AsyncCheckpointWriter::writeBoxData( hid_t                                     a_group,
+                                          const std::string&                        a_suffix,
+                                          const std::vector<CFG::Box>&              a_boxes,
+                                          const std::vector<CFG::Box>&              a_valid_boxes,
+                                          const std::vector<int>&                   a_local_boxes,
+                                          const std::vector<const CFG::FArrayBox*>& a_local_data,
+                                          const int                                 a_ncomp,
+                                          const int                                 a_compression )
+{
+   // Global box lists and the offset of each box in the data set
+   int num_boxes = a_boxes.size();
+   std::vector<int> corners(2*CFG_DIM*num_boxes);
+   std::vector<int> valid_corners(2*CFG_DIM*num_boxes);
+   std::vector<long long> offsets(num_boxes+1);
+   offsets[0] = 0;
+   for (int n=0; n<num_boxes; ++n) {
+      for (int dir=0; dir<CFG_DIM; ++dir) {
+         corners[2*CFG_DIM*n + dir] = a_boxes[n].smallEnd(dir);
+         corners[2*CFG_DIM*n + CFG_DIM + dir] = a_boxes[n].bigEnd(dir);
+         valid_corners[2*CFG_DIM*n + dir] = a_valid_boxes[n].smallEnd(dir);
+         valid_corners[2*CFG_DIM*n + CFG_DIM + dir] = a_valid_boxes[n].bigEnd(dir);
+      }
+      offsets[n+1] = offsets[n] + a_boxes[n].numPts() * a_ncomp;
+   }
+   writeSmallDataset(a_group, ("boxes" + a_suffix).c_str(), H5T_NATIVE_INT, corners.size(), &corners[0]);
+   writeSmallDataset(a_group, ("valid_boxes" + a_suffix).c_str(), H5T_NATIVE_INT, valid_corners.size(), &valid_corners[0]);
+   writeSmallDataset(a_group, ("offsets" + a_suffix).c_str(), H5T_NATIVE_LLONG, offsets.size(), &offsets[0]);
+
+   // Gather the local boxes in file order, so that a single (collective)
+   // write covers them all, as compression requires in parallel
+   std::vector<Real> buffer;
+   hsize_t flatdims[1];
+   flatdims[0] = offsets.back();
+   hid_t dataspace = H5Screate_simple(1, flatdims, NULL);
+   H5Sselect_none(dataspace);
+   for (int ibox=0; ibox<a_local_boxes.size(); ++ibox) {
+      int index = a_local_boxes[ibox];
+      CH_assert( ibox==0 || index>a_local_boxes[ibox-1] );
+      hsize_t offset[1], count[1];
+      offset[0] = offsets[index];
+      count[0] = offsets[index+1] - offsets[index];
+      H5Sselect_hyperslab(dataspace, H5S_SELECT_OR, offset, NULL, count, NULL);
+
+      const CFG::FArrayBox& fab( *a_local_data[ibox] );
+      CH_assert( fab.box() == a_boxes[index] );
+      buffer.insert( buffer.end(), fab.dataPtr(), fab.dataPtr() + count[0] );
+   }
+
+   hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+   if ( a_compression > 0 && flatdims[0] > 0 ) {
+      hsize_t chunk[1];
+      chunk[0] = flatdims[0] < 65536 ? flatdims[0] : 65536;
+      H5Pset_chunk(dcpl, 1, chunk);
+      H5Pset_deflate(dcpl, a_compression);
+   }
+#ifdef H516
+   hid_t dataset = H5Dcreate(a_group, ("data" + a_suffix).c_str(), H5T_NATIVE_REAL, dataspace, dcpl);
+#else
+   hid_t dataset = H5Dcreate(a_group, ("data" + a_suffix).c_str(), H5T_NATIVE_REAL, dataspace,
+                             H5P_DEFAULT, dcpl, H5P_DEFAULT);
+#endif
+   H5Pclose(dcpl);
+
+   hid_t dxpl = H5Pcreate(H5P_DATASET_XFER);
+#ifdef CH_MPI
+   H5Pset_dxpl_mpio(dxpl, H5FD_MPIO_COLLECTIVE);
+#endif
+   hsize_t memdims[1];
+   memdims[0] = buffer.empty() ? 1 : buffer.size();
+   hid_t memdataspace = H5Screate_simple(1, memdims, NULL);
+   if ( buffer.empty() ) {
+      H5Sselect_none(memdataspace);
+      buffer.resize(1);
+   }
+   H5Dwrite(dataset, H5T_NATIVE_REAL, memdataspace, dataspace, dxpl, &buffer[0]);
+   H5Sclose(memdataspace);
+   H5Pclose(dxpl);
+
+   H5Dclose(dataset);
+   H5Sclose(dataspace);
+}
+
+
+
+void AsyncCheckpointWriter::readBoxData( hid_t                               a_group,
+                                         const std::string&                  a_suffix,
+                                         const std::vector<CFG::FArrayBox*>& a_local_data )
+{
+   std::vector<int> comps;
+   std::vector<int> box_corners;
+   std::vector<int> valid_corners;
+   std::vector<long long> offsets;
+   readSmallDataset(a_group, "comps", H5T_NATIVE_INT, comps);
+   readSmallDataset(a_group, ("boxes" + a_suffix).c_str(), H5T_NATIVE_INT, box_corners);
+   readSmallDataset(a_group, ("valid_boxes" + a_suffix).c_str(), H5T_NATIVE_INT, valid_corners);
+   readSmallDataset(a_group, ("offsets" + a_suffix).c_str(), H5T_NATIVE_LLONG, offsets);
+
+   // The boxes are of the centering (cells or faces) of the data
+   CFG::IndexType type( CFG::IndexType::TheCellType() );
+   if ( !a_local_data.empty() ) {
+      type = a_local_data[0]->box().ixType();
+   }
+
+   int ncomp = comps[0];
+   int num_file_boxes = offsets.size() - 1;
+   std::vector<CFG::Box> file_boxes(num_file_boxes);
+   std::vector<CFG::Box> valid_boxes(num_file_boxes);
+   for (int n=0; n<num_file_boxes; ++n) {
+      CFG::IntVect lo, hi, valid_lo, valid_hi;
+      for (int dir=0; dir<CFG_DIM; ++dir) {
+         lo[dir] = box_corners[2*CFG_DIM*n + dir];
+         hi[dir] = box_corners[2*CFG_DIM*n + CFG_DIM + dir];
+         valid_lo[dir] = valid_corners[2*CFG_DIM*n + dir];
+         valid_hi[dir] = valid_corners[2*CFG_DIM*n + CFG_DIM + dir];
+      }
+      file_boxes[n] = CFG::Box(lo, hi, type);
+      valid_boxes[n] = CFG::Box(valid_lo, valid_hi, type);
+   }
+
+   for (int ibox=0; ibox<a_local_data.size(); ++ibox) {
+      if ( ncomp != a_local_data[ibox]->nComp() ) {
+         MayDay::Error( "AsyncCheckpointWriter::readConfigurationData: number of components differs from the checkpoint" );
+      }
+   }
+
+#ifdef H516
+   hid_t dataset = H5Dopen(a_group, ("data" + a_suffix).c_str());
+#else
+   hid_t dataset = H5Dopen(a_group, ("data" + a_suffix).c_str(), H5P_DEFAULT);
+#endif
+   hid_t dataspace = H5Dget_space(dataset);
+
+   // Each file box intersecting a local box is read once
+   std::vector<int> file_index;
+   std::vector<CFG::FArrayBox*> file_data;
+   for (int n=0; n<num_file_boxes; ++n) {
+      bool needed = false;
+      for (int ibox=0; !needed && ibox<a_local_data.size(); ++ibox) {
+         needed = a_local_data[ibox]->box().intersects( file_boxes[n] );
+      }
+      if ( !needed ) continue;
+
+      CFG::FArrayBox* file_fab = new CFG::FArrayBox( file_boxes[n], ncomp );
+
+      hsize_t offset[1], count[1];
+      offset[0] = offsets[n];
+      count[0] = offsets[n+1] - offsets[n];
+
+      H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
+      hid_t memdataspace = H5Screate_simple(1, count, NULL);
+      H5Dread(dataset, H5T_NATIVE_REAL, memdataspace, dataspace, H5P_DEFAULT, file_fab->dataPtr());
+      H5Sclose(memdataspace);
+
+      file_index.push_back( n );
+      file_data.push_back( file_fab );
+   }
+
+   H5Sclose(dataspace);
+   H5Dclose(dataset);
+
+   for (int ibox=0; ibox<a_local_data.size(); ++ibox) {
+      CFG::FArrayBox& fab( *a_local_data[ibox] );
+
+      // Cells in the valid region of a file box are taken from there, since
+      // the ghost cells of other file boxes may not have been up to date
+      CFG::BaseFab<int> filled( fab.box(), 1 );
+      filled.setVal(0);
+      for (int m=0; m<file_index.size(); ++m) {
+         CFG::Box overlap( fab.box() & valid_boxes[file_index[m]] );
+         if ( !overlap.isEmpty() ) {
+            fab.copy( *file_data[m], overlap );
+            filled.setVal( 1, overlap, 0 );
+         }
+      }
+
+      // The remaining cells, outside of the valid region of the file layout,
+      // from the ghost cells of the first file box holding them
+      for (int m=0; m<file_index.size(); ++m) {
+         CFG::Box overlap( fab.box() & file_boxes[file_index[m]] );
+         for (CFG::BoxIterator bit(overlap); bit.ok(); ++bit) {
+            const CFG::IntVect& iv( bit() );
+            if ( filled(iv,0) ) continue;
+            for (int comp=0; comp<ncomp; ++comp) {
+               fab(iv,comp) = (*file_data[m])(iv,comp);
+            }
+            filled(iv,0) = 1;
+         }
+      }
+   }
+
+   for (int m=0; m<file_data.size(); ++m) {
+      delete file_data[m];
+   }
+}
+
+
+#include "NamespaceFooter.H"
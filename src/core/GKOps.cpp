@@ -2,7 +2,9 @@
 #include "CONSTANTS.H"
 #include "FORT_PROTO.H"
 #include "inspect.H"
+#include "GKProfiler.H"
 
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
@@ -22,6 +24,7 @@
 #include <iostream>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "CH_HDF5.H"
@@ -38,6 +41,7 @@
 #include "SlabCoordSys.H"
 #include "SingleNullBlockCoordSys.H"
 #include "SNCoreBlockCoordSys.H"
+#include "FluxSurface.H"
 #include "newMappedGridIO.H"
 #include "FourthOrderUtil.H"
 #include "DataArray.H"
@@ -223,11 +227,8 @@ GKOps::~GKOps()
    if (m_neutrals)  delete m_neutrals;
    delete m_vlasov;
    if (m_poisson) delete m_poisson;
-   for (int ihist(0); ihist<m_hist_count; ihist++) {
-     FieldHist *save_hist = &m_fieldHistLists[ihist];
-     delete save_hist->fieldvals;
-     delete save_hist->timevals;
-     delete save_hist->timestep;
+   if (m_hist_stream.is_open()) {
+      m_hist_stream.close();
    }
 }
 
@@ -270,35 +271,53 @@ void GKOps::preTimeStep (const int a_step,
   const KineticSpeciesPtrVect& soln_comp( a_state_comp.dataKinetic() );
   const KineticSpeciesPtrVect& soln_phys( a_state_phys.dataKinetic() );
 
-  m_dt_vlasov = m_vlasov->computeDt( m_E_field, soln_comp );
-  m_time_scale_vlasov = m_vlasov->computeTimeScale (m_E_field, soln_comp );
+  // Gather the local data of the kinetic operators and take the global
+  // minimum with a single reduction; values whose global maximum is needed
+  // are stored negated
+  std::vector<Real> local_data;
+  m_vlasov->localTimeScaleData( m_E_field, soln_comp, local_data );
+  m_collisions->localTimeScaleData( soln_comp, local_data );
+  if (m_transport_model_on) {
+    m_transport->localTimeScaleData( soln_comp, local_data );
+  }
+
+  std::vector<Real> data( local_data );
+#ifdef CH_MPI
+  if (local_data.size() > 0) {
+    MPI_Allreduce( &(local_data[0]), &(data[0]), local_data.size(), MPI_CH_REAL, MPI_MIN, MPI_COMM_WORLD );
+  }
+#endif
 
-  m_dt_collisions = m_collisions->computeDt( soln_comp );
-  m_time_scale_collisions = m_collisions->computeTimeScale( soln_comp );
+  int offset(0);
+  m_vlasov->computeDtAndTimeScale( soln_comp, data, offset, m_dt_vlasov, m_time_scale_vlasov );
+  m_collisions->computeDtAndTimeScale( data, offset, m_dt_collisions, m_time_scale_collisions );
+  if (m_transport_model_on) {
+    m_transport->computeDtAndTimeScale( soln_comp, data, offset, m_dt_transport, m_time_scale_transport );
+  }
+  CH_assert( offset == (int)data.size() );
 
   const CFG::FluidSpeciesPtrVect& fluids_comp( a_state_comp.dataFluid() );
   const CFG::FieldPtrVect& fields_comp( a_state_comp.dataField() );
 
-  m_dt_fields = m_fieldOp->computeDt( fields_comp, fluids_comp );
-  m_time_scale_fields = m_fieldOp->computeTimeScale( fields_comp, fluids_comp );
- 
-  m_dt_fluids = m_fluidOp->computeDt( fields_comp, fluids_comp );
-  m_time_scale_fluids = m_fluidOp->computeTimeScale( fields_comp, fluids_comp );
+  m_fieldOp->computeDtAndTimeScale( fields_comp, fluids_comp, m_dt_fields, m_time_scale_fields );
+  m_fluidOp->computeDtAndTimeScale( fields_comp, fluids_comp, m_dt_fluids, m_time_scale_fluids );
 
-  if (m_transport_model_on) {
-    m_dt_transport = m_transport->computeDt( soln_comp );
-    m_time_scale_transport = m_transport->computeTimeScale( soln_comp );
-  }
+  // The neutrals are not part of the reduction above: their time scale is
+  // not computed from the solution and needs no communication
   if (m_neutrals_model_on) {
     m_dt_neutrals = m_neutrals->computeDt( soln_comp );
     m_time_scale_neutrals = m_neutrals->computeTimeScale( soln_comp );
   }
-  m_collisions->preTimeStep( soln_comp, a_time, soln_phys );
+  {
+    GK_PROFILE(COLLISIONS);
+    m_collisions->preTimeStep( soln_comp, a_time, soln_phys );
+  }
 }
 
 void GKOps::postTimeStep (const int a_step, const Real a_time, const GKState& a_state)
 {
-  /* nothing to do here for now */
+  m_workspace_bytes_last_step = m_workspace_bytes_step;
+  m_workspace_bytes_step = 0;
 }
 
 void GKOps::postTimeStage(const int a_step, const Real a_time, const GKState& a_state, const int a_stage )
@@ -337,7 +356,7 @@ void GKOps::explicitOp( GKRHSData& a_rhs,
    a_rhs.zero();
    const KineticSpeciesPtrVect& species_comp( a_state.dataKinetic() );
       
-   KineticSpeciesPtrVect species_phys;
+   KineticSpeciesPtrVect& species_phys( m_kinetic_species_phys );
    createTemporarySpeciesVector( species_phys, species_comp );
    fillGhostCells( species_phys, m_E_field, a_time );
    applyVlasovOperator( a_rhs.dataKinetic(), species_phys, m_E_field, a_time );
@@ -436,7 +455,7 @@ void GKOps::explicitOpImEx( GKRHSData& a_rhs,
    a_rhs.zero();
    const KineticSpeciesPtrVect& species_comp( a_state.dataKinetic() );
    
-   KineticSpeciesPtrVect species_phys;
+   KineticSpeciesPtrVect& species_phys( m_kinetic_species_phys );
    createTemporarySpeciesVector( species_phys, species_comp );
    fillGhostCells( species_phys, m_E_field, a_time );
    applyVlasovOperator( a_rhs.dataKinetic(), species_phys, m_E_field, a_time );
@@ -530,7 +549,7 @@ void GKOps::implicitOpImEx( GKRHSData& a_rhs,
    a_rhs.zero();
    const KineticSpeciesPtrVect& species_comp( a_state.dataKinetic() );
 
-   KineticSpeciesPtrVect species_phys;
+   KineticSpeciesPtrVect& species_phys( m_kinetic_species_phys );
    createTemporarySpeciesVector( species_phys, species_comp );
    fillGhostCells( species_phys, m_E_field, a_time );
 
@@ -642,39 +661,22 @@ void GKOps::computeElectricField( LevelData<FluxBox>&               a_E_field,
                                   const int                         a_step_number )
 {
    CH_assert( isDefined() );
+   GK_PROFILE(FIELD_SOLVE);
    
-   CFG::IntVect ghost_vect_cfg;
-   for (int d(0); d<CFG_DIM; d++) {
-      ghost_vect_cfg[d] = m_ghost_vect[d];
-   }
-   
-   //Obtain physical solutions
-   const int num_kinetic_species( a_kinetic_species.size() );
-   KineticSpeciesPtrVect kinetic_result;
-   kinetic_result.resize(num_kinetic_species);
-   for (int species(0); species<num_kinetic_species; species++) {
-      kinetic_result[species] = a_kinetic_species[species]->clone( m_ghost_vect );
-   }
-   divideJ( a_kinetic_species, kinetic_result );
-   
-   const int num_fluid_species( a_fluid_species.size() );
-   CFG::FluidSpeciesPtrVect fluid_result;
-   fluid_result.resize(num_fluid_species);
+   //Obtain physical solutions in the persistent workspace
+   KineticSpeciesPtrVect& kinetic_result( m_kinetic_species_phys );
+   createTemporarySpeciesVector( kinetic_result, a_kinetic_species );
 
-   for (int species(0); species<num_fluid_species; species++) {
-      fluid_result[species] = a_fluid_species[species]->clone( ghost_vect_cfg );
-   }
-   divideJ( a_fluid_species, fluid_result );
-   
-   const int num_field_comp( a_fields.size() );
-   CFG::FieldPtrVect field_result;
-   field_result.resize(num_field_comp);
-   for (int comp(0); comp<num_field_comp; comp++) {
-      field_result[comp] = a_fields[comp]->clone( ghost_vect_cfg );
-   }
-   divideJ( a_fields, field_result );
+   CFG::FluidSpeciesPtrVect& fluid_result( m_fluid_species_phys );
+   createTemporarySpeciesVector( fluid_result, a_fluid_species );
+
+   CFG::FieldPtrVect& field_result( m_fields_phys );
+   createTemporaryFieldVector( field_result, a_fields );
+
+   // computeEField only changes the field values on the first call or if
+   // the potential is being evolved
+   const bool efield_changes( !m_initializedE || (m_poisson && !m_fixed_efield) );
 
-   
    computeEField( m_E_field_face,
                   m_E_field_cell,
                   kinetic_result,
@@ -686,6 +688,86 @@ void GKOps::computeElectricField( LevelData<FluxBox>&               a_E_field,
    m_phase_geometry->injectConfigurationToPhase( m_E_field_face,
                                                  m_E_field_cell,
                                                  a_E_field );
+
+   // Let the Vlasov operator know whether its cached velocities are still valid
+   if ( efield_changes || &a_E_field != &m_E_field ) {
+      m_efield_version++;
+   }
+   m_vlasov->setEFieldVersion( m_efield_version );
+}
+
+
+// The createTemporary* functions fill a_out with the physical (J-divided)
+// counterpart of a_in.  If a_out already holds conforming data from a
+// previous call (i.e., it is one of the persistent workspace vectors),
+// it is refilled in place; otherwise it is (re)allocated by cloning.
+
+inline
+LevelData<FArrayBox>& temporaryData( KineticSpecies& a_species )
+{
+   return a_species.distributionFunction();
+}
+
+inline
+CFG::LevelData<CFG::FArrayBox>& temporaryData( CFG::FluidSpecies& a_species )
+{
+   return a_species.data();
+}
+
+inline
+CFG::LevelData<CFG::FArrayBox>& temporaryData( CFG::Field& a_field )
+{
+   return a_field.data();
+}
+
+inline
+void divideJonValid( KineticSpecies& a_species )
+{
+   a_species.phaseSpaceGeometry().divideJonValid( a_species.distributionFunction() );
+}
+
+inline
+void divideJonValid( CFG::FluidSpecies& a_species )
+{
+   a_species.configurationSpaceGeometry().divideJonValid( a_species.data() );
+}
+
+inline
+void divideJonValid( CFG::Field& a_field )
+{
+   a_field.configurationSpaceGeometry().divideJonValid( a_field.data() );
+}
+
+
+template <class PTR_VECT, class INT_VECT>
+void GKOps::createTemporaryVector( PTR_VECT&       a_out,
+                                   const PTR_VECT& a_in,
+                                   const INT_VECT& a_ghost_vect )
+{
+   bool reuse( a_out.size()==a_in.size() );
+   for (int s(0); reuse && s<a_in.size(); s++) {
+      reuse = a_out[s]->conformsTo( *(a_in[s]), false )
+         && temporaryData( *(a_out[s]) ).ghostVect()==a_ghost_vect;
+   }
+
+   if (reuse) {
+      for (int s(0); s<a_in.size(); s++) {
+         a_out[s]->copy( *(a_in[s]) );
+         divideJonValid( *(a_out[s]) );
+         const long long bytes( GKProfiler::storageBytes( temporaryData( *(a_out[s]) ) ) );
+         m_workspace_bytes_step += bytes;
+         m_workspace_bytes_reused += bytes;
+      }
+      if (a_in.size()>0) m_count_workspace_reuse++;
+   }
+   else {
+      a_out.resize( a_in.size() );
+      for (int s(0); s<a_in.size(); s++) {
+         a_out[s] = a_in[s]->clone( a_ghost_vect );
+         divideJonValid( *(a_out[s]) );
+         GKProfiler::instance().addBytes( GKProfiler::storageBytes( temporaryData( *(a_out[s]) ) ) );
+      }
+   }
 }
 
 
@@ -697,13 +779,7 @@ void GKOps::createTemporaryFieldVector( CFG::FieldPtrVect& a_out,
    for (int d(0); d<CFG_DIM; d++) {
       ghost_vect[d] = m_ghost_vect[d];
    }
-   a_out.resize( a_in.size() );
-   for (int s(0); s<a_in.size(); s++) {
-      a_out[s] = a_in[s]->clone( ghost_vect );
-      CFG::LevelData<CFG::FArrayBox>& out_data( a_out[s]->data() );
-      const CFG::MagGeom& geometry( a_in[s]->configurationSpaceGeometry() );
-      geometry.divideJonValid( out_data );
-   }
+   createTemporaryVector( a_out, a_in, ghost_vect );
 }
 
 
@@ -715,13 +791,7 @@ void GKOps::createTemporarySpeciesVector( CFG::FluidSpeciesPtrVect& a_out,
    for (int d(0); d<CFG_DIM; d++) {
       ghost_vect[d] = m_ghost_vect[d];
    }
-   a_out.resize( a_in.size() );
-   for (int s(0); s<a_in.size(); s++) {
-      a_out[s] = a_in[s]->clone( ghost_vect );
-      CFG::LevelData<CFG::FArrayBox>& out_data( a_out[s]->data() );
-      const CFG::MagGeom& geometry( a_in[s]->configurationSpaceGeometry() );
-      geometry.divideJonValid( out_data );
-   }
+   createTemporaryVector( a_out, a_in, ghost_vect );
 }
 
 
@@ -729,13 +799,7 @@ inline
 void GKOps::createTemporarySpeciesVector( KineticSpeciesPtrVect& a_out,
                                           const KineticSpeciesPtrVect& a_in )
 {
-   a_out.resize( a_in.size() );
-   for (int s(0); s<a_in.size(); s++) {
-      a_out[s] = a_in[s]->clone( m_ghost_vect );
-      LevelData<FArrayBox>& out_dfn( a_out[s]->distributionFunction() );
-      const PhaseGeom& geometry( a_in[s]->phaseSpaceGeometry() );
-      geometry.divideJonValid( out_dfn );
-   }
+   createTemporaryVector( a_out, a_in, m_ghost_vect );
 }
 
 
@@ -754,6 +818,7 @@ void GKOps::fillGhostCells(
    const Real&                  a_time )
 {
    CH_assert( isDefined() );
+   GK_PROFILE(BC_FILL);
    m_boundary_conditions->fillGhostCells( a_species_phys,
                                           m_phi,
                                           a_E_field,
@@ -766,6 +831,7 @@ void GKOps::fillGhostCells( GKState&                  a_state_phys,
                             const Real&               a_time )
 {
    CH_assert( isDefined() );
+   GK_PROFILE(BC_FILL);
    m_boundary_conditions->fillGhostCells( a_state_phys,
                                           m_phi,
                                           a_E_field,
@@ -781,6 +847,7 @@ void GKOps::applyVlasovOperator(
    const Real&                  a_time )
 {
    CH_assert( isDefined() );
+   GK_PROFILE(VLASOV);
    m_count_vlasov++;
 
    if (m_consistent_potential_bcs) {
@@ -814,6 +881,7 @@ void GKOps::applyCollisionOperator( KineticSpeciesPtrVect&       a_rhs,
                                     const int                    a_flag )
 {
    CH_assert( isDefined() );
+   GK_PROFILE(COLLISIONS);
    m_count_collision++;
    m_collisions->accumulateRHS( a_rhs, a_soln, a_time, a_flag );
 }
@@ -1503,6 +1571,42 @@ GKOps::setETilde( const LevelData<FArrayBox>& E_tilde_cell_injected)
    m_phase_geometry->projectPhaseToConfiguration(E_tilde_cell_injected, m_E_tilde_cell);
 }
 
+void
+GKOps::setErAverage( const CFG::LevelData<CFG::FluxBox>& a_Er_face )
+{
+   m_Er_average_face.define(a_Er_face.disjointBoxLayout(), a_Er_face.nComp(), a_Er_face.ghostVect());
+   for (CFG::DataIterator dit(m_Er_average_face.dataIterator()); dit.ok(); ++dit) {
+      m_Er_average_face[dit].copy(a_Er_face[dit]);
+   }
+}
+
+void
+GKOps::setErAverage( const CFG::LevelData<CFG::FArrayBox>& a_Er_cell )
+{
+   m_Er_average_cell.define(a_Er_cell.disjointBoxLayout(), a_Er_cell.nComp(), a_Er_cell.ghostVect());
+   for (CFG::DataIterator dit(m_Er_average_cell.dataIterator()); dit.ok(); ++dit) {
+      m_Er_average_cell[dit].copy(a_Er_cell[dit]);
+   }
+}
+
+void
+GKOps::setETilde( const CFG::LevelData<CFG::FluxBox>& a_E_tilde_face )
+{
+   m_E_tilde_face.define(a_E_tilde_face.disjointBoxLayout(), a_E_tilde_face.nComp(), a_E_tilde_face.ghostVect());
+   for (CFG::DataIterator dit(m_E_tilde_face.dataIterator()); dit.ok(); ++dit) {
+      m_E_tilde_face[dit].copy(a_E_tilde_face[dit]);
+   }
+}
+
+void
+GKOps::setETilde( const CFG::LevelData<CFG::FArrayBox>& a_E_tilde_cell )
+{
+   m_E_tilde_cell.define(a_E_tilde_cell.disjointBoxLayout(), a_E_tilde_cell.nComp(), a_E_tilde_cell.ghostVect());
+   for (CFG::DataIterator dit(m_E_tilde_cell.dataIterator()); dit.ok(); ++dit) {
+      m_E_tilde_cell[dit].copy(a_E_tilde_cell[dit]);
+   }
+}
+
 void GKOps::divideJ( const KineticSpeciesPtrVect& a_soln_mapped,
                      KineticSpeciesPtrVect&       a_soln_physical )
 {
@@ -2246,6 +2350,12 @@ void GKOps::setupFieldHistories( ParmParse& a_ppsim )
 #ifdef CH_USE_HDF5
       //query how frequently to save histories
       a_ppsim.query( "history_frequency", m_hist_freq );
+      //query the history stream and how many samples are buffered before a flush
+      a_ppsim.query( "history_file", m_hist_filename );
+      a_ppsim.query( "history_flush_frequency", m_hist_flush_freq );
+      if (m_hist_flush_freq < 1) {
+         MayDay::Error( "history_flush_frequency must be positive" );
+      }
       //query for indices to generate the history.   If out of bounds, will result in no history.
       std::vector<int> read_hist_indices( CFG_DIM );
       // Set up default to be in middle of array
@@ -2270,30 +2380,40 @@ void GKOps::setupFieldHistories( ParmParse& a_ppsim )
 
             // query to see what field's history to accumulate
             a_ppsim.get( sfield.str().c_str(), m_hist_fieldname );
-            if (m_hist_fieldname == "potential") {
-               FieldHist *save_hist = new FieldHist; //create structure
-               save_hist->hist_index = m_hist_count;
-               save_hist->grid_indices = m_hist_indices; // grid indices
-               save_hist->fieldvals = new Vector<Real>( m_expand_incr ); // allocate memory for vectors
-               save_hist->timevals = new Vector<Real>( m_expand_incr );
-               save_hist->timestep = new Vector<int>( m_expand_incr );
-               save_hist->valsize = m_expand_incr; // length of vectors above
-               save_hist->cur_entry = 0; // incremented for each entry
-               save_hist->fieldname = m_hist_fieldname;
-               m_fieldHistLists.push_back(*save_hist); //save structure in array
-               m_hist_count++; // count of watchpoint histories in deck
-            }
-            else if (m_hist_fieldname == "Efield") {
-               FieldHist *save_hist = new FieldHist; //create structure
-               save_hist->hist_index = m_hist_count;
-               save_hist->grid_indices = m_hist_indices; // grid indices
-               save_hist->fieldvals = new Vector<Real>( m_expand_incr ); // allocate memory for vectors
-               save_hist->timevals = new Vector<Real>( m_expand_incr );
-               save_hist->timestep = new Vector<int>( m_expand_incr );
-               save_hist->valsize = m_expand_incr; // length of vectors above
-               save_hist->cur_entry = 0; // incremented for each entry
-               save_hist->fieldname = m_hist_fieldname;
-               m_fieldHistLists.push_back(*save_hist); //save structure in array
+            if (m_hist_fieldname == "potential"   ||
+                m_hist_fieldname == "Efield"      ||
+                m_hist_fieldname == "density"     ||
+                m_hist_fieldname == "temperature" ) {
+               FieldHist save_hist;
+               save_hist.hist_index = m_hist_count;
+               save_hist.grid_indices = m_hist_indices; // grid indices
+               save_hist.fieldname = m_hist_fieldname;
+
+               stringstream scomp;
+               scomp << count << ".history_component" << ends;
+               save_hist.component = 0;
+               a_ppsim.query( scomp.str().c_str(), save_hist.component );
+
+               stringstream sspecies;
+               sspecies << count << ".history_species" << ends;
+               save_hist.species = "";
+               a_ppsim.query( sspecies.str().c_str(), save_hist.species );
+
+               stringstream saverage;
+               saverage << count << ".history_average" << ends;
+               std::string average( "none" );
+               a_ppsim.query( saverage.str().c_str(), average );
+               if (average == "flux_surface") {
+                  save_hist.flux_surface_average = true;
+               }
+               else if (average == "none") {
+                  save_hist.flux_surface_average = false;
+               }
+               else {
+                  MayDay::Error( "history_average must be \"none\" or \"flux_surface\"" );
+               }
+
+               m_fieldHistLists.push_back(save_hist); //save structure in array
                m_hist_count++; // count of watchpoint histories in deck
             } else {
                MayDay::Error("Unimplemented field name");
@@ -2314,120 +2434,240 @@ void GKOps::setupFieldHistories( ParmParse& a_ppsim )
 }
 
 
-void GKOps::writeFieldHistory( const int a_cur_step,
-                               const Real a_cur_time,
-                               const bool a_startup_flag )
+bool GKOps::historyUsesKineticSpecies( const int  a_cur_step,
+                                       const bool a_startup_flag ) const
 {
-   CH_assert( isDefined() );
    if (a_cur_step % m_hist_freq != 0 && !a_startup_flag) {
-      return;
+      return false;
    }
-   
    for (int ihist(0); ihist<m_hist_count; ihist++) {
-      FieldHist *field_hist_ptr = &m_fieldHistLists[ihist];
-      std::string hist_field_name = field_hist_ptr->fieldname;
-      CFG:: IntVect inode_hist = field_hist_ptr->grid_indices;
-      
-      std::string fname;
-      std::string fname_suf;
-      std::string fname_step;
-      CFG::LevelData<CFG::FArrayBox>* field = NULL;
-
-      if (hist_field_name == "potential") {
-         field = &m_phi;
-         fname = "potential_hist";
-         stringstream fname_temp;
-         fname_temp << "potential_hist_" << ihist + 1 << ".curve" << ends;
-         fname_suf = fname_temp.str();
-         stringstream fname_step_temp;
-         fname_step_temp << "potential_hist_" << ihist + 1 << ".txt" << ends;
-         fname_step = fname_step_temp.str();
+      const std::string& name( m_fieldHistLists[ihist].fieldname );
+      if (name == "density" || name == "temperature") {
+         return true;
       }
-      else if (hist_field_name == "Efield") {
-         field = &m_E_field_cell;
-         fname = "Efield_hist";
-         stringstream fname_temp;
-         fname_temp << "Efield_hist_" << ihist + 1 << ".curve" << ends;
-         fname_suf = fname_temp.str();
-         stringstream fname_step_temp;
-         fname_step_temp << "Efield_hist_" << ihist + 1 << ".txt" << ends;
-         fname_step = fname_step_temp.str();
+   }
+   return false;
+}
+
+
+const CFG::LevelData<CFG::FArrayBox>&
+GKOps::historySource( const FieldHist&             a_hist,
+                      const KineticSpeciesPtrVect& a_kinetic_species,
+                      HistorySourceMap&            a_sources )
+{
+   // Fields are sampled in place; moments and averages are computed once
+   // per sample and shared by all the probes that need them
+   const CFG::LevelData<CFG::FArrayBox>* field = NULL;
+   std::string key( a_hist.fieldname );
+
+   if (a_hist.fieldname == "potential") {
+      field = &m_phi;
+   }
+   else if (a_hist.fieldname == "Efield") {
+      field = &m_E_field_cell;
+   }
+   else {
+      int species_index(-1);
+      for (int species(0); species<a_kinetic_species.size(); species++) {
+         if ( a_hist.species == "" || a_kinetic_species[species]->name() == a_hist.species ) {
+            species_index = species;
+            break;
+         }
       }
-      else{
-         MayDay::Error( "Unimplemented field name" );
+      if (species_index < 0) {
+         MayDay::Error( "GKOps::historySource: unknown history_species" );
       }
-      
-      // Writes value of a spatial field at a specified point inode_hist to a text file
-      // with name fname, adding to what is there
-      Real field_val(0.0);
-      for (CFG::DataIterator dit( field->dataIterator() ); dit.ok(); ++dit) {
-         
-        // Extract local fortran array for the field on this patch
-        // This differs from syntax in many other parts of code in that a_field is now
-        // a pointer, so we need to de-reference it.
-         const CFG::FArrayBox& field_on_patch( (*field)[dit] );
-
-         // now loop over nodes of the box and if the node's global indices match
-         //   the specified global indices, print.  This will only happen on one
-         //   patch, unless it happens in a ghost cell -- accept that duplication
-         //   for now.
-         CFG::Box patchBox( (field->disjointBoxLayout())[dit] );
-
-         bool found(true);
-         for (int i(0); i<CFG_DIM; i++) {
-            if ((inode_hist[i]<patchBox.smallEnd(i)) ||
-                (inode_hist[i]>patchBox.bigEnd(i))   ){
-               found = false;
+      const KineticSpecies& soln_species( *(a_kinetic_species[species_index]) );
+      key += "." + soln_species.name();
+
+      if ( a_sources.find( key ) == a_sources.end() ) {
+         const CFG::MagGeom& mag_geom( m_phase_geometry->magGeom() );
+         RefCountedPtr<CFG::LevelData<CFG::FArrayBox> >
+            moment( new CFG::LevelData<CFG::FArrayBox>( mag_geom.gridsFull(), 1, CFG::IntVect::Zero ) );
+         soln_species.numberDensity( *moment );
+
+         if (a_hist.fieldname == "temperature") {
+            CFG::LevelData<CFG::FArrayBox> ParallelMom( mag_geom.gridsFull(), 1, CFG::IntVect::Zero );
+            soln_species.ParallelMomentum( ParallelMom );
+            for (CFG::DataIterator dit( moment->dataIterator() ); dit.ok(); ++dit) {
+               ParallelMom[dit].divide( (*moment)[dit] );
+            }
+
+            CFG::LevelData<CFG::FArrayBox> pressure( mag_geom.gridsFull(), 1, CFG::IntVect::Zero );
+            soln_species.pressureMoment( pressure, ParallelMom );
+            for (CFG::DataIterator dit( moment->dataIterator() ); dit.ok(); ++dit) {
+               pressure[dit].divide( (*moment)[dit] );
+               (*moment)[dit].copy( pressure[dit] );
+            }
+         }
+         a_sources[key] = moment;
+      }
+      field = &(*a_sources[key]);
+   }
+
+   if ( a_hist.component < 0 || a_hist.component >= field->nComp() ) {
+      MayDay::Error( "GKOps::historySource: history_component out of range" );
+   }
+   if (!a_hist.flux_surface_average) {
+      return *field;
+   }
+
+   stringstream average_key;
+   average_key << key << "." << a_hist.component << ".flux_surface";
+   if ( a_sources.find( average_key.str() ) == a_sources.end() ) {
+      const CFG::MagGeom& mag_geom( m_phase_geometry->magGeom() );
+      if (m_hist_flux_surface.isNull()) {
+         m_hist_flux_surface = RefCountedPtr<CFG::FluxSurface>( new CFG::FluxSurface( mag_geom ) );
+      }
+      const CFG::DisjointBoxLayout& grids( field->disjointBoxLayout() );
+      CFG::LevelData<CFG::FArrayBox> src( grids, 1, CFG::IntVect::Zero );
+      for (CFG::DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+         src[dit].copy( (*field)[dit], a_hist.component, 0, 1 );
+      }
+      RefCountedPtr<CFG::LevelData<CFG::FArrayBox> >
+         average( new CFG::LevelData<CFG::FArrayBox>( grids, 1, CFG::IntVect::Zero ) );
+      m_hist_flux_surface->averageAndSpread( src, *average );
+      a_sources[average_key.str()] = average;
+   }
+   return *a_sources[average_key.str()];
+}
+
+
+void GKOps::openFieldHistory( const int a_cur_step )
+{
+   CH_assert( procID()==0 );
+
+   // Header describing the probes, used to recognize a file of this run
+   std::ostringstream header;
+   header.write( "GKHIST01", 8 );
+   const int dim( CFG_DIM );
+   header.write( (const char*)&dim, sizeof(int) );
+   header.write( (const char*)&m_hist_count, sizeof(int) );
+   for (int ihist(0); ihist<m_hist_count; ihist++) {
+      const FieldHist& hist( m_fieldHistLists[ihist] );
+      char label[32];
+      memset( label, 0, 32 );
+      std::string name( hist.fieldname );
+      if (hist.species != "") name += "." + hist.species;
+      strncpy( label, name.c_str(), 31 );
+      header.write( label, 32 );
+      header.write( (const char*)&hist.component, sizeof(int) );
+      const int average( hist.flux_surface_average ? 1 : 0 );
+      header.write( (const char*)&average, sizeof(int) );
+      for (int d(0); d<CFG_DIM; d++) {
+         const int index( hist.grid_indices[d] );
+         header.write( (const char*)&index, sizeof(int) );
+      }
+   }
+   const std::string header_str( header.str() );
+   const long record_size( sizeof(long long) + sizeof(double) * (1 + m_hist_count) );
+
+   // Keep the records of an existing history of the same probes that
+   // precede the current step, so that a restart continues the stream
+   bool append(false);
+   long keep( header_str.size() );
+   {
+      std::ifstream existing( m_hist_filename.c_str(), std::ios::in | std::ios::binary );
+      if ( existing.good() ) {
+         existing.seekg( 0, std::ios::end );
+         const long file_size( existing.tellg() );
+         existing.seekg( 0, std::ios::beg );
+         std::string existing_header( header_str.size(), '\0' );
+         existing.read( &existing_header[0], header_str.size() );
+         if ( existing.gcount() == (std::streamsize)header_str.size() && existing_header == header_str ) {
+            // A trailing partial record is dropped
+            append = true;
+            const long num_records( (file_size - keep) / record_size );
+            for (long record(0); record<num_records; record++) {
+               long long step;
+               existing.seekg( keep );
+               existing.read( (char*)&step, sizeof(long long) );
+               if ( !existing.good() || step >= a_cur_step ) break;
+               keep += record_size;
             }
          }
-         if (found) {
-            field_val += field_on_patch( inode_hist, 0 );
+         else if (a_cur_step > 0) {
+            MayDay::Error( "GKOps::openFieldHistory: history file does not match the probes of this run" );
          }
       }
-      
-      Real field_val_sum(0.0);
+   }
+
+   if (append) {
+      if ( truncate( m_hist_filename.c_str(), keep ) != 0 ) {
+         MayDay::Error( "GKOps::openFieldHistory: cannot truncate the history file" );
+      }
+      m_hist_stream.open( m_hist_filename.c_str(), std::ios::out | std::ios::app | std::ios::binary );
+   }
+   else {
+      m_hist_stream.open( m_hist_filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary );
+      m_hist_stream.write( header_str.c_str(), header_str.size() );
+   }
+   if ( !m_hist_stream.good() ) {
+      MayDay::Error( "GKOps::openFieldHistory: cannot open the history file" );
+   }
+}
+
+
+void GKOps::writeFieldHistory( const int                    a_cur_step,
+                               const Real                   a_cur_time,
+                               const bool                   a_startup_flag,
+                               const KineticSpeciesPtrVect& a_kinetic_species )
+{
+   CH_assert( isDefined() );
+   if (m_hist_count == 0) {
+      return;
+   }
+   if (a_cur_step % m_hist_freq != 0 && !a_startup_flag) {
+      return;
+   }
+
+   // Sample every probe locally, then reduce them all at once
+   HistorySourceMap sources;
+   Vector<Real> field_val( m_hist_count, 0.0 );
+   for (int ihist(0); ihist<m_hist_count; ihist++) {
+      const FieldHist& hist( m_fieldHistLists[ihist] );
+      const CFG::IntVect& inode_hist( hist.grid_indices );
+      const CFG::LevelData<CFG::FArrayBox>& field( historySource( hist, a_kinetic_species, sources ) );
+      const int comp( hist.flux_surface_average ? 0 : hist.component );
+
+      // The point is only found in the valid region of one patch
+      for (CFG::DataIterator dit( field.dataIterator() ); dit.ok(); ++dit) {
+         const CFG::Box& patchBox( field.disjointBoxLayout()[dit] );
+         if (patchBox.contains( inode_hist )) {
+            field_val[ihist] += field[dit]( inode_hist, comp );
+         }
+      }
+   }
+
+   Vector<Real> field_val_sum( m_hist_count, 0.0 );
 #ifdef CH_MPI
-      MPI_Allreduce( &field_val, &field_val_sum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+   {
+      GK_PROFILE_WAIT();
+      MPI_Allreduce( &(field_val[0]), &(field_val_sum[0]), m_hist_count, MPI_CH_REAL, MPI_SUM, MPI_COMM_WORLD );
+   }
 #else
-      field_val_sum = field_val;
+   field_val_sum = field_val;
 #endif
 
-      const int cur_index( field_hist_ptr->cur_entry );
-      if (cur_index >= field_hist_ptr->valsize) {
-         const int length( cur_index + m_expand_incr );
-         (*field_hist_ptr->fieldvals).resize( length );
-         (*field_hist_ptr->timevals).resize( length );
-         (*field_hist_ptr->timestep).resize( length );
-         field_hist_ptr->valsize = length;
+   if (procID()==0) {
+      if (!m_hist_opened) {
+         openFieldHistory( a_cur_step );
+         m_hist_opened = true;
       }
-      (*field_hist_ptr->fieldvals)[cur_index] = field_val_sum;
-      (*field_hist_ptr->timevals)[cur_index]  = a_cur_time;
-      (*field_hist_ptr->timestep)[cur_index]  = a_cur_step;
-      field_hist_ptr->cur_entry += 1;
-      
-#ifdef CH_MPI
-      if (procID()==0) { // write out a file for each watchpoint
-#endif
-         //overwrite any existing file; this one is for Visit (with no column for the step)
-         ofstream fieldout( fname_suf.c_str(), ios::out ); 
-         fieldout << "# " << inode_hist[0] << ", " << inode_hist[1] << endl;
-
-         //overwrite any existing file; this one is for human viewing (1st column for the step)
-         ofstream fieldout_step( fname_step.c_str(), ios::out ); 
-         fieldout_step << "# step  time  potential at ix,iy = " << inode_hist[0] << ", " << inode_hist[1] <<  endl;
-
-         for (int j(0); j<field_hist_ptr->cur_entry; j++) {
-            fieldout << (*field_hist_ptr->timevals)[j] << " "
-                     << (*field_hist_ptr->fieldvals)[j] << endl;
-            fieldout_step << (*field_hist_ptr->timestep)[j] << " "
-                          << (*field_hist_ptr->timevals)[j] << " "
-                          << (*field_hist_ptr->fieldvals)[j] << endl;
-         }
-         fieldout.close();
-         fieldout_step.close();
-#ifdef CH_MPI
+
+      const long long step( a_cur_step );
+      const double time( a_cur_time );
+      m_hist_stream.write( (const char*)&step, sizeof(long long) );
+      m_hist_stream.write( (const char*)&time, sizeof(double) );
+      for (int ihist(0); ihist<m_hist_count; ihist++) {
+         const double value( field_val_sum[ihist] );
+         m_hist_stream.write( (const char*)&value, sizeof(double) );
+      }
+
+      if (++m_hist_unflushed >= m_hist_flush_freq) {
+         m_hist_stream.flush();
+         m_hist_unflushed = 0;
       }
-#endif
    }
 }
 
@@ -2507,8 +2747,10 @@ void GKOps::writeCheckpointFile( HDF5Handle& a_handle ) const
 {
    CH_assert( isDefined() );
    char buff[100];
-   hsize_t flatdims[1], count[1], sizebuff[1];
+   hsize_t flatdims[1], count[1];
 
+   // The samples themselves are in the history stream; only the watchpoint
+   // locations are saved, to check them on restart
    for (int ihist(0); ihist<m_hist_count; ihist++) {
 
       const FieldHist *field_hist_ptr = &m_fieldHistLists[ihist];
@@ -2516,23 +2758,6 @@ void GKOps::writeCheckpointFile( HDF5Handle& a_handle ) const
       sprintf(buff,"field_hist_%d", ihist+1);
       a_handle.setGroup(buff);
 
-      flatdims[0] = 1;
-      count[0] = 1;
-      sizebuff[0] = field_hist_ptr->valsize;
-
-      hid_t sizedataspace = H5Screate_simple(1, flatdims, NULL);
-#ifdef H516
-      hid_t sizedataset   = H5Dcreate(a_handle.groupID(), "size",
-                        H5T_NATIVE_INT, sizedataspace, H5P_DEFAULT);
-#else
-      hid_t sizedataset   = H5Dcreate(a_handle.groupID(), "size",
-                        H5T_NATIVE_INT, sizedataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-#endif
-      hid_t szmemdataspace = H5Screate_simple(1, count, NULL);
-      H5Dwrite(sizedataset, H5T_NATIVE_INT, szmemdataspace, sizedataspace,
-             H5P_DEFAULT, sizebuff);
-      H5Dclose(sizedataset);
-
       int indices[CFG_DIM];
 
       for (int i = 0; i < CFG_DIM; i++) {
@@ -2554,68 +2779,6 @@ void GKOps::writeCheckpointFile( HDF5Handle& a_handle ) const
       H5Dwrite(indexdataset, H5T_NATIVE_INT, imemdataspace, indexdataspace,
              H5P_DEFAULT, indices);
       H5Dclose(indexdataset);
-      flatdims[0] =  field_hist_ptr->valsize;
-      count[0] =  field_hist_ptr->valsize;
-
-      //cout << "valsize = " << field_hist_ptr->valsize << endl;
-
-      Real *rbuff = new Real[field_hist_ptr->valsize];
-
-      for (int i = 0; i < field_hist_ptr->valsize; i++) {
-        rbuff[i] = (*field_hist_ptr->fieldvals)[i];
-      }
-      hid_t fielddataspace = H5Screate_simple(1, flatdims, NULL);
-#ifdef H516
-      hid_t fielddataset   = H5Dcreate(a_handle.groupID(), "field",
-                        H5T_NATIVE_REAL, fielddataspace, H5P_DEFAULT);
-#else
-      hid_t fielddataset   = H5Dcreate(a_handle.groupID(), "field",
-                        H5T_NATIVE_REAL, fielddataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-#endif
-      hid_t fmemdataspace = H5Screate_simple(1, count, NULL);
-      H5Dwrite(fielddataset, H5T_NATIVE_REAL, fmemdataspace, fielddataspace,
-             H5P_DEFAULT, rbuff);
-      H5Dclose(fielddataset);
-
-      for (int i = 0; i < field_hist_ptr->valsize; i++) {
-        rbuff[i] = (*field_hist_ptr->timevals)[i];
-      }
-      hid_t timedataspace = H5Screate_simple(1, flatdims, NULL);
-#ifdef H516
-      hid_t timedataset   = H5Dcreate(a_handle.groupID(), "times",
-                                      H5T_NATIVE_REAL, timedataspace, 
-                                      H5P_DEFAULT);
-      
-#else
-      hid_t timedataset   = H5Dcreate(a_handle.groupID(), "times",
-                        H5T_NATIVE_REAL, timedataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-#endif
-      hid_t tmemdataspace = H5Screate_simple(1, count, NULL);
-      H5Dwrite(timedataset, H5T_NATIVE_REAL, tmemdataspace, timedataspace,
-             H5P_DEFAULT, rbuff);
-      H5Dclose(timedataset);
-
-      delete [] rbuff;
-
-      int *ibuff = new int[field_hist_ptr->valsize];
-      for (int i = 0; i < field_hist_ptr->valsize; i++) {
-        ibuff[i] = (*field_hist_ptr->timestep)[i];
-      }
-      hid_t stepdataspace = H5Screate_simple(1, flatdims, NULL);
-#ifdef H516
-      hid_t stepdataset   = H5Dcreate(a_handle.groupID(), "steps",
-                        H5T_NATIVE_INT, stepdataspace, H5P_DEFAULT);
-#else
-      hid_t stepdataset   = H5Dcreate(a_handle.groupID(), "steps",
-                        H5T_NATIVE_INT, stepdataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-#endif
-      hid_t smemdataspace = H5Screate_simple(1, count, NULL);
-      H5Dwrite(stepdataset, H5T_NATIVE_INT, smemdataspace, stepdataspace,
-             H5P_DEFAULT, ibuff);
-      H5Dclose(stepdataset);
-
-      delete [] ibuff;
-
    }
 }
    
@@ -2623,8 +2786,9 @@ void GKOps::readCheckpointFile( HDF5Handle& a_handle, const int& a_cur_step )
 {
    CH_assert( isDefined() );
    char buff[100];
-   hsize_t flatdims[1], count[1], sizebuff[1];
 
+   // Histories saved by earlier versions in the checkpoint are ignored; the
+   // history stream is continued from a_cur_step by writeFieldHistory()
    for (int ihist(0); ihist<m_hist_count; ihist++) {
       
       FieldHist *field_hist_ptr = &m_fieldHistLists[ihist];
@@ -2632,37 +2796,14 @@ void GKOps::readCheckpointFile( HDF5Handle& a_handle, const int& a_cur_step )
       sprintf(buff,"field_hist_%d", ihist+1);
       a_handle.setGroup(buff);
       
-      flatdims[0] =  1;
-      count[0] = 1;
       hsize_t dims[1], maxdims[1];
 
-#ifdef H516
-      hid_t sizedataset   = H5Dopen(a_handle.groupID(), "size");
-#else
-      hid_t sizedataset   = H5Dopen(a_handle.groupID(), "size", H5P_DEFAULT);
-#endif
-      hid_t sizedataspace = H5Dget_space(sizedataset);
-      H5Sget_simple_extent_dims(sizedataspace, dims, maxdims);
-      hid_t szmemdataspace = H5Screate_simple(1, dims, NULL);
-      H5Dread(sizedataset, H5T_NATIVE_INT, szmemdataspace, sizedataspace,
-             H5P_DEFAULT, sizebuff);
-      H5Dclose(sizedataset);
-
-      if (sizebuff[0] >= field_hist_ptr->valsize) {
-         (*field_hist_ptr->fieldvals).resize(sizebuff[0]);
-         (*field_hist_ptr->timevals).resize(sizebuff[0]);
-         (*field_hist_ptr->timestep).resize(sizebuff[0]);
-         field_hist_ptr->valsize = sizebuff[0];
-      }
-
       int indices[CFG_DIM];
       int readin_indices[CFG_DIM];
 
       for (int i = 0; i < CFG_DIM; i++) {
           indices[i] = (field_hist_ptr->grid_indices)[i];
       }
-      flatdims[0] =  CFG_DIM;
-      count[0] =  CFG_DIM;
 
 #ifdef H516
       hid_t indexdataset   = H5Dopen(a_handle.groupID(), "indices");
@@ -2680,71 +2821,6 @@ void GKOps::readCheckpointFile( HDF5Handle& a_handle, const int& a_cur_step )
           MayDay::Error("Grid indices for field history don't match previous run");
         }
       }
-
-      flatdims[0] =  field_hist_ptr->valsize;
-      count[0] =  field_hist_ptr->valsize;
-
-      // cout << "valsize = " << field_hist_ptr->valsize << endl;
-
-      Real *rbuff = new Real[field_hist_ptr->valsize];
-#ifdef H516
-      hid_t fielddataset   = H5Dopen(a_handle.groupID(), "field");
-#else
-      hid_t fielddataset   = H5Dopen(a_handle.groupID(), "field", H5P_DEFAULT);
-#endif
-      hid_t fielddataspace = H5Dget_space(fielddataset);
-      H5Sget_simple_extent_dims(fielddataspace, dims, maxdims);
-      hid_t fmemdataspace = H5Screate_simple(1, dims, NULL);
-      H5Dread(fielddataset, H5T_NATIVE_REAL, fmemdataspace, fielddataspace,
-             H5P_DEFAULT, rbuff);
-      H5Dclose(fielddataset);
-      for (int i = 0; i < field_hist_ptr->valsize; i++) {
-        (*field_hist_ptr->fieldvals)[i] = rbuff[i];
-      }
-
-#ifdef H516
-      hid_t timedataset   = H5Dopen(a_handle.groupID(), "times");
-#else
-      hid_t timedataset   = H5Dopen(a_handle.groupID(), "times", H5P_DEFAULT);
-#endif
-      hid_t timedataspace = H5Dget_space(timedataset);
-      H5Sget_simple_extent_dims(timedataspace, dims, maxdims);
-      hid_t tmemdataspace = H5Screate_simple(1, dims, NULL);
-      H5Dread(timedataset, H5T_NATIVE_REAL, tmemdataspace, timedataspace,
-             H5P_DEFAULT, rbuff);
-      H5Dclose(timedataset);
-      for (int i = 0; i < field_hist_ptr->valsize; i++) {
-        (*field_hist_ptr->timevals)[i] = rbuff[i];
-      }
-
-      delete [] rbuff;
-
-      int *ibuff = new int[field_hist_ptr->valsize];
-#ifdef H516
-      hid_t stepdataset   = H5Dopen(a_handle.groupID(), "steps");
-#else
-      hid_t stepdataset   = H5Dopen(a_handle.groupID(), "steps", H5P_DEFAULT);
-#endif
-      hid_t stepdataspace = H5Dget_space(stepdataset);
-      H5Sget_simple_extent_dims(stepdataspace, dims, maxdims);
-      hid_t smemdataspace = H5Screate_simple(1, dims, NULL);
-      H5Dread(stepdataset, H5T_NATIVE_INT, smemdataspace, stepdataspace,
-             H5P_DEFAULT, ibuff);
-      H5Dclose(stepdataset);
-      for (int i = 0; i < field_hist_ptr->valsize; i++) {
-        (*field_hist_ptr->timestep)[i] = ibuff[i];
-      }
-
-      field_hist_ptr->cur_entry = field_hist_ptr->valsize; //where to add new entries
-      for (int i = 0; i < field_hist_ptr->valsize; i++) {
-        if (ibuff[i] > a_cur_step || (i>0 && ibuff[i] == 0)) {
-          field_hist_ptr->cur_entry = i; // first location in table for next entry
-          break;
-        }
-      }
-
-      delete [] ibuff;
-
    }
 }
 
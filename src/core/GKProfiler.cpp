@@ -0,0 +1,242 @@
+#include "GKProfiler.H"
+#include "MayDay.H"
+#include "SPMD.H"
+
+#include <fstream>
+#include <iomanip>
+#include <sys/time.h>
+
+#include "NamespaceHeader.H"
+
+
+GKProfiler& GKProfiler::instance()
+{
+   static GKProfiler inst;
+   return inst;
+}
+
+
+GKProfiler::GKProfiler()
+   : m_depth(0),
+     m_file_started(false)
+{
+   for (int p(0); p<NUM_PHASES; p++) {
+      for (int c(0); c<NUM_COUNTERS; c++) {
+         m_counters[p][c] = 0.0;
+      }
+   }
+}
+
+
+double GKProfiler::wallTime()
+{
+#ifdef CH_MPI
+   return MPI_Wtime();
+#else
+   struct timeval tv;
+   gettimeofday( &tv, NULL );
+   return (double)tv.tv_sec + 1.0e-6 * (double)tv.tv_usec;
+#endif
+}
+
+
+const char* GKProfiler::phaseName( const Phase a_phase )
+{
+   switch (a_phase) {
+   case VLASOV:      return "vlasov";
+   case BC_FILL:     return "bc_fill";
+   case FIELD_SOLVE: return "field_solve";
+   case COLLISIONS:  return "collisions";
+   case MOMENTS:     return "moments";
+   case EXCHANGE:    return "exchange";
+   case IO:          return "io";
+   default:          return "unknown";
+   }
+}
+
+
+GKProfiler::Region::Region( const Phase a_phase )
+{
+   GKProfiler::instance().open( a_phase );
+   m_start = GKProfiler::wallTime();
+}
+
+
+GKProfiler::Region::~Region()
+{
+   GKProfiler::instance().close( GKProfiler::wallTime() - m_start );
+}
+
+
+GKProfiler::Wait::Wait()
+   : m_start( GKProfiler::wallTime() )
+{
+}
+
+
+GKProfiler::Wait::~Wait()
+{
+   GKProfiler::instance().addWait( GKProfiler::wallTime() - m_start );
+}
+
+
+void GKProfiler::open( const Phase a_phase )
+{
+   // Deeper nesting than s_max_depth is counted but not attributed
+   if (m_depth < s_max_depth) {
+      m_open[m_depth] = a_phase;
+      m_counters[a_phase][NUM_CALLS] += 1.0;
+   }
+   m_depth++;
+}
+
+
+void GKProfiler::close( const double a_elapsed )
+{
+   CH_assert( m_depth>0 );
+   m_depth--;
+   if (m_depth < s_max_depth) {
+      m_counters[m_open[m_depth]][WALL_TIME] += a_elapsed;
+   }
+}
+
+
+void GKProfiler::addWait( const double a_elapsed )
+{
+   // A phase open at several levels is only charged once
+   bool charged[NUM_PHASES] = {false};
+   for (int d(0); d<m_depth && d<s_max_depth; d++) {
+      if (!charged[m_open[d]]) {
+         m_counters[m_open[d]][WAIT_TIME] += a_elapsed;
+         charged[m_open[d]] = true;
+      }
+   }
+}
+
+
+void GKProfiler::addBytes( const long long a_bytes )
+{
+   bool charged[NUM_PHASES] = {false};
+   for (int d(0); d<m_depth && d<s_max_depth; d++) {
+      if (!charged[m_open[d]]) {
+         m_counters[m_open[d]][NUM_BYTES] += (double)a_bytes;
+         charged[m_open[d]] = true;
+      }
+   }
+}
+
+
+long long GKProfiler::storageBytes( const LevelData<FArrayBox>& a_data )
+{
+   long long bytes(0);
+   for (DataIterator dit( a_data.dataIterator() ); dit.ok(); ++dit) {
+      bytes += (long long)a_data[dit].box().numPts() * a_data.nComp() * sizeof(Real);
+   }
+   return bytes;
+}
+
+
+long long GKProfiler::storageBytes( const LevelData<FluxBox>& a_data )
+{
+   long long bytes(0);
+   for (DataIterator dit( a_data.dataIterator() ); dit.ok(); ++dit) {
+      for (int dir(0); dir<SpaceDim; dir++) {
+         bytes += (long long)a_data[dit][dir].box().numPts() * a_data.nComp() * sizeof(Real);
+      }
+   }
+   return bytes;
+}
+
+
+long long GKProfiler::storageBytes( const CFG::LevelData<CFG::FArrayBox>& a_data )
+{
+   long long bytes(0);
+   for (CFG::DataIterator dit( a_data.dataIterator() ); dit.ok(); ++dit) {
+      bytes += (long long)a_data[dit].box().numPts() * a_data.nComp() * sizeof(Real);
+   }
+   return bytes;
+}
+
+
+void GKProfiler::write( const std::string& a_filename,
+                        const std::string& a_format,
+                        const int          a_step,
+                        const Real         a_time )
+{
+   const bool csv( a_format == "csv" );
+   if ( !csv && a_format != "json" ) {
+      MayDay::Error( "GKProfiler::write: format must be \"json\" or \"csv\"" );
+   }
+
+   // Three reductions of all counters, whatever the number of phases
+   const int n( NUM_PHASES * NUM_COUNTERS );
+   double* local( &(m_counters[0][0]) );
+   double min_val[n], max_val[n], sum_val[n];
+#ifdef CH_MPI
+   MPI_Reduce( local, min_val, n, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD );
+   MPI_Reduce( local, max_val, n, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD );
+   MPI_Reduce( local, sum_val, n, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD );
+#else
+   for (int i(0); i<n; i++) {
+      min_val[i] = max_val[i] = sum_val[i] = local[i];
+   }
+#endif
+
+   for (int i(0); i<n; i++) {
+      local[i] = 0.0;
+   }
+
+   if (procID()==0) {
+
+      // The first write of this run truncates the file and writes the CSV
+      // header, so that the profile of a previous run is not appended to
+      const bool new_file( !m_file_started );
+      m_file_started = true;
+
+      std::ofstream out( a_filename.c_str(),
+                         std::ios::out | (new_file ? std::ios::trunc : std::ios::app) );
+      out << std::setprecision(9);
+
+      const char* counter_name[NUM_COUNTERS] = { "wall", "mpi_wait", "calls", "bytes" };
+      const double num_procs( numProc() );
+
+      if (csv) {
+         if (new_file) {
+            out << "step,time,phase";
+            for (int c(0); c<NUM_COUNTERS; c++) {
+               out << "," << counter_name[c] << "_min"
+                   << "," << counter_name[c] << "_avg"
+                   << "," << counter_name[c] << "_max";
+            }
+            out << std::endl;
+         }
+         for (int p(0); p<NUM_PHASES; p++) {
+            out << a_step << "," << a_time << "," << phaseName( Phase(p) );
+            for (int c(0); c<NUM_COUNTERS; c++) {
+               const int i( p * NUM_COUNTERS + c );
+               out << "," << min_val[i] << "," << sum_val[i] / num_procs << "," << max_val[i];
+            }
+            out << std::endl;
+         }
+      }
+      else {
+         out << "{\"step\": " << a_step << ", \"time\": " << a_time
+             << ", \"ranks\": " << numProc() << ", \"phases\": {";
+         for (int p(0); p<NUM_PHASES; p++) {
+            out << (p ? ", " : "") << "\"" << phaseName( Phase(p) ) << "\": {";
+            for (int c(0); c<NUM_COUNTERS; c++) {
+               const int i( p * NUM_COUNTERS + c );
+               out << (c ? ", " : "") << "\"" << counter_name[c] << "\": {"
+                   << "\"min\": " << min_val[i]
+                   << ", \"avg\": " << sum_val[i] / num_procs
+                   << ", \"max\": " << max_val[i] << "}";
+            }
+            out << "}";
+         }
+         out << "}}" << std::endl;
+      }
+   }
+}
+
+
+#include "NamespaceFooter.H"
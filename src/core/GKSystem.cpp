@@ -1,10 +1,13 @@
 #include "GKSystem.H"
+#include "GKProfiler.H"
 #include "CONSTANTS.H"
 #include "FORT_PROTO.H"
 #include "inspect.H"
 
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 
 #include "MillerPhaseCoordSys.H"
 #include "SlabPhaseCoordSys.H"
@@ -66,12 +69,20 @@ GKSystem::GKSystem( ParmParse& a_pp, bool a_use_external_TI )
      m_enforce_step_positivity(false),
      m_max_grid_size(0),
      m_ghostVect(4*IntVect::Unit),
+     m_weighted_decomposition(false),
+     m_decomp_boxes_per_proc(1),
      m_ti_class("rk"),
      m_ti_method("4"),
      m_gk_ops(NULL),
      m_initial_conditions(NULL),
      m_boundary_conditions(NULL),
      m_state_comp( GKState(m_ghostVect) ),
+     m_state_phys_valid(false),
+     m_num_phys_updates(0),
+     m_error_control(false),
+     m_checkpoint_writer(NULL),
+     m_checkpoint_compression(0),
+     m_verify_restart(false),
      m_hdf_potential(false),
      m_hdf_efield(false),
      m_hdf_density(false),
@@ -106,6 +117,8 @@ GKSystem::GKSystem( ParmParse& a_pp, bool a_use_external_TI )
    
    parseParameters( ppgksys );
 
+   const double setup_start( GKProfiler::wallTime() );
+
    createConfigurationSpace();
    
    createVelocitySpace();
@@ -152,6 +165,31 @@ GKSystem::GKSystem( ParmParse& a_pp, bool a_use_external_TI )
       MayDay::Warning( "Not using electrons with dynamic E field" );
    
    setupFieldHistories();
+
+   // The metric data computed during the setup is now complete and may be
+   // stored for later runs
+   const CFG::MetricCache& metric_cache( m_mag_geom->metricCache() );
+   const bool using_metric_cache( metric_cache.isDefined() );
+   const int num_loaded( metric_cache.numLoaded() );
+   const int num_stored( metric_cache.numStored() );
+   m_mag_geom->writeMetricCache();
+
+   double setup_time( GKProfiler::wallTime() - setup_start );
+#ifdef CH_MPI
+   double local_setup_time( setup_time );
+   MPI_Allreduce( &local_setup_time, &setup_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD );
+#endif
+   if (procID()==0) {
+      cout << "Geometry and operator setup time: " << setup_time << " s";
+      if ( using_metric_cache ) {
+         cout << " (metric cache: " << num_loaded << " entries loaded, "
+              << num_stored << " computed and stored)";
+      }
+      else {
+         cout << " (metric cache not used)";
+      }
+      cout << endl;
+   }
 }
 
 
@@ -173,8 +211,8 @@ GKSystem::initialize( const int a_cur_step )
       m_gk_ops->initializePotential( 0.0 );
    }
 
-   // Initialize the physical state variables
-   m_gk_ops->divideJ( m_state_comp, m_state_phys );
+   // The physical state variables are computed on demand
+   invalidatePhysicalState();
    
    // Initialize the electric field:
    // a.  If the fixed_efield option is true, then the field is calculated
@@ -182,13 +220,14 @@ GKSystem::initialize( const int a_cur_step )
    //     or (if restarting) m_gk_ops->initializePotential().
    // b.  If the fixed_efield option is false, then both the potential and
    //     associated field are computed.
-   m_gk_ops->initializeElectricField( m_state_phys, a_cur_step );
+   m_gk_ops->initializeElectricField( physicalState(), a_cur_step );
 }
 
 
 
 GKSystem::~GKSystem()
 {
+   delete m_checkpoint_writer;
    delete m_phase_geom;
    delete m_phase_grid;
    delete m_phase_coords;
@@ -698,7 +737,19 @@ GKSystem::createPhaseSpace( ParmParse& a_ppgksys )
 
   // Construct the phase space grid
 
-  m_phase_grid = new PhaseGrid(domains, decomps, m_phase_decomposition, m_mag_geom_type);
+  if (m_weighted_decomposition) {
+     PhaseDecompositionCosts costs;
+     for (int block=0; block<m_decomp_block_weights.size(); ++block) {
+        costs.block_weights.push_back(m_decomp_block_weights[block]);
+     }
+     costs.boxes_per_proc = m_decomp_boxes_per_proc;
+     readPhaseDecompositionCosts( costs );
+
+     m_phase_grid = new PhaseGrid(domains, decomps, m_phase_decomposition, m_mag_geom_type, &costs);
+  }
+  else {
+     m_phase_grid = new PhaseGrid(domains, decomps, m_phase_decomposition, m_mag_geom_type);
+  }
 
   if (m_verbosity>0) {
      m_phase_grid->print(m_ghostVect);
@@ -1104,6 +1155,9 @@ void GKSystem::advance( Real& a_cur_time,
                         int&  a_step_number)
 {
    CH_assert(m_use_native_time_integrator);
+   if (m_error_control) {
+      m_state_prev.copy( m_state_comp );
+   }
    m_integrator->setTimeStepSize( a_dt );
    m_integrator->advance( a_cur_time, m_state_comp );
    m_integrator->getCurrentTime( a_cur_time );
@@ -1112,7 +1166,50 @@ void GKSystem::advance( Real& a_cur_time,
    if (m_enforce_step_positivity) {
       enforcePositivity( m_state_comp.dataKinetic() );
    }
-   m_gk_ops->divideJ( m_state_comp, m_state_phys );
+   invalidatePhysicalState();
+}
+
+
+const GKState& GKSystem::physicalState()
+{
+   if (!m_state_phys_valid) {
+      m_gk_ops->divideJ( m_state_comp, m_state_phys );
+      m_state_phys_valid = true;
+      m_num_phys_updates++;
+   }
+   return m_state_phys;
+}
+
+
+bool GKSystem::defineErrorControl( const Real a_rtol, const Real a_atol )
+{
+   if ( !m_use_native_time_integrator ||
+        !m_integrator->defineErrorControl( a_rtol, a_atol ) ) {
+      return false;
+   }
+   if (!m_error_control) {
+      m_state_prev.define( m_state_comp );
+   }
+   m_error_control = true;
+   return true;
+}
+
+
+void GKSystem::getStepError( Real& a_error, int& a_order ) const
+{
+   CH_assert(m_error_control);
+   m_integrator->getErrorEstimate( a_error, a_order );
+}
+
+
+void GKSystem::rejectStep( const Real a_cur_time,
+                           const int  a_step_number )
+{
+   CH_assert(m_error_control);
+   m_state_comp.copy( m_state_prev );
+   invalidatePhysicalState();
+   m_integrator->setCurrentTime( a_cur_time );
+   m_integrator->setTimeStep( a_step_number );
 }
 
 
@@ -1192,6 +1289,8 @@ void GKSystem::writePlotFile(const char    *prefix,
                              const int     cur_step,
                              const double& cur_time )
 {
+   GK_PROFILE(IO);
+
    // If the efield and potential are fixed, only consider plotting them at step 0
    if ( !m_gk_ops->fixedEField() || cur_step == 0 ) {
    
@@ -1222,7 +1321,8 @@ void GKSystem::writePlotFile(const char    *prefix,
    int vpar_index (m_fixed_plotindices[3]);
    int mu_index (m_fixed_plotindices[4]);
 
-   const KineticSpeciesPtrVect& kinetic_species( m_state_phys.dataKinetic() );
+   const GKState& state_phys( physicalState() );
+   const KineticSpeciesPtrVect& kinetic_species( state_phys.dataKinetic() );
    for (int species(0); species<kinetic_species.size(); species++) {
       const KineticSpecies& soln_species( *(kinetic_species[species]) );
 
@@ -1446,7 +1546,7 @@ void GKSystem::writePlotFile(const char    *prefix,
    }
 
    //Plot fluid species profiles
-   const CFG::FluidSpeciesPtrVect& fluids( m_state_phys.dataFluid() );
+   const CFG::FluidSpeciesPtrVect& fluids( state_phys.dataFluid() );
    for (int species(0); species<fluids.size(); species++) {
       const CFG::FluidSpecies& fluid_species( *(fluids[species]) );
       
@@ -1462,7 +1562,7 @@ void GKSystem::writePlotFile(const char    *prefix,
    }
 
    //Plot fields
-   const CFG::FieldPtrVect& fields( m_state_phys.dataField() );
+   const CFG::FieldPtrVect& fields( state_phys.dataField() );
    for (int comp(0); comp<fields.size(); comp++) {
       const CFG::Field& field_comp( *(fields[comp]) );
       
@@ -1481,10 +1581,152 @@ void GKSystem::writePlotFile(const char    *prefix,
 
       
 
+// Checksum of the valid cells of a distribution function that does not
+// depend on the box layout or number of processes: a wrapping sum over all
+// cells and components of a hash of the cell, component and bits of the
+// value.  Collective.
+inline
+unsigned long long mixChecksumBits( unsigned long long a_bits )
+{
+   a_bits ^= a_bits >> 33;
+   a_bits *= 0xff51afd7ed558ccdULL;
+   a_bits ^= a_bits >> 33;
+   a_bits *= 0xc4ceb9fe1a85ec53ULL;
+   a_bits ^= a_bits >> 33;
+   return a_bits;
+}
+
+
+unsigned long long dfnChecksum( const LevelData<FArrayBox>& a_dfn )
+{
+   // Sum of a hash of every valid cell's value and global index, so that it
+   // does not depend on the layout.  The cells are visited a row (along the
+   // first direction, contiguous in memory) at a time.
+   unsigned long long local_sum(0);
+   const DisjointBoxLayout& grids( a_dfn.disjointBoxLayout() );
+   for (DataIterator dit(grids); dit.ok(); ++dit) {
+      const FArrayBox& fab( a_dfn[dit] );
+      const Box& box( grids[dit] );
+      const int length( box.size(0) );
+      Box rows( box );
+      rows.setBig( 0, box.smallEnd(0) );
+      for (int n(0); n<a_dfn.nComp(); n++) {
+         for (BoxIterator bit(rows); bit.ok(); ++bit) {
+            const IntVect& iv( bit() );
+            unsigned long long row_key( n );
+            for (int dir(1); dir<SpaceDim; dir++) {
+               row_key = mixChecksumBits( row_key + (unsigned long long)(long long)iv[dir] );
+            }
+            const Real* values( &fab(iv,n) );
+            for (int i(0); i<length; i++) {
+               const unsigned long long key( mixChecksumBits( row_key + (unsigned long long)(long long)(iv[0] + i) ) );
+               unsigned long long bits(0);
+               memcpy( &bits, &values[i], sizeof(Real) );
+               local_sum += mixChecksumBits( key ^ bits );
+            }
+         }
+      }
+   }
+
+   unsigned long long sum( local_sum );
+#ifdef CH_MPI
+   MPI_Allreduce( &local_sum, &sum, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD );
+#endif
+   return sum;
+}
+
+
+// Reads LevelData that may have been written on a different box layout (e.g.,
+// before a restart rebalanced the decomposition) onto the current layout.
+template <class T>
+void readOntoLayout( HDF5Handle&              a_handle,
+                     LevelData<T>&            a_data,
+                     const DisjointBoxLayout& a_grids,
+                     const bool               a_redefine )
+{
+   Vector<Box> file_boxes;
+   read( a_handle, file_boxes );
+
+   bool same_layout = (file_boxes.size() == a_grids.size());
+   int k = 0;
+   for (LayoutIterator lit(a_grids.layoutIterator()); same_layout && lit.ok(); ++lit) {
+      same_layout = (a_grids[lit()] == file_boxes[k++]);
+   }
+
+   if ( same_layout ) {
+      read( a_handle, a_data, "data", a_grids, Interval(0,a_data.nComp()-1), a_redefine );
+   }
+   else {
+      Vector<int> procs;
+      LoadBalance( procs, file_boxes );
+      DisjointBoxLayout file_grids( file_boxes, procs, a_grids.physDomain() );
+
+      LevelData<T> file_data;
+      read( a_handle, file_data, "data", file_grids );
+      if ( a_redefine ) {
+         a_data.define( a_grids, file_data.nComp(), file_data.ghostVect() );
+      }
+      file_data.copyTo( a_data );
+   }
+}
+
+
 void GKSystem::writeCheckpointFile( HDF5Handle&  a_handle,
                                     const int    a_cur_step,
                                     const double a_cur_time,
                                     const double a_cur_dt )
+{
+   GK_PROFILE(IO);
+   writeCheckpointData( a_handle, a_cur_step, a_cur_time, a_cur_dt, false );
+}
+
+
+void GKSystem::writeCheckpointFileAsync( const std::string& a_filename,
+                                         const int          a_cur_step,
+                                         const double       a_cur_time,
+                                         const double       a_cur_dt )
+{
+   GK_PROFILE(IO);
+   if ( !m_checkpoint_writer ) {
+      m_checkpoint_writer = new AsyncCheckpointWriter;
+   }
+
+   // HDF5 may only be used by one thread at a time
+   m_checkpoint_writer->wait();
+
+   // Write everything but the distribution functions now; they are staged
+   // and appended to the file in the background
+   HDF5Handle handle( a_filename, HDF5Handle::CREATE );
+   writeCheckpointData( handle, a_cur_step, a_cur_time, a_cur_dt, true );
+   handle.close();
+
+   m_checkpoint_writer->stage( a_filename, m_state_comp.dataKinetic() );
+   m_checkpoint_writer->start();
+}
+
+
+void GKSystem::waitForCheckpoint()
+{
+   if ( m_checkpoint_writer ) {
+      m_checkpoint_writer->wait();
+   }
+}
+
+
+void GKSystem::printCheckpointTimes()
+{
+   if ( m_checkpoint_writer ) {
+      m_checkpoint_writer->wait();
+      m_checkpoint_writer->printTimes();
+   }
+}
+
+
+void GKSystem::writeCheckpointData( HDF5Handle&  a_handle,
+                                    const int    a_cur_step,
+                                    const double a_cur_time,
+                                    const double a_cur_dt,
+                                    const bool   a_staged_dfn )
 {
    pout() << "writing checkpoint file" << endl;
 
@@ -1493,57 +1735,95 @@ void GKSystem::writeCheckpointFile( HDF5Handle&  a_handle,
       cout << "Writing checkpoint file" << endl;
    }
 
+   const KineticSpeciesPtrVect& kinetic_species( m_state_comp.dataKinetic() );
+   const CFG::FluidSpeciesPtrVect& fluid_species( m_state_comp.dataFluid() );
+   const CFG::FieldPtrVect& fields( m_state_comp.dataField() );
+
    HDF5HeaderData header;
-   const int RESTART_VERSION(2); // to distinguish from future versions
+   const int RESTART_VERSION(3); // to distinguish from future versions
    header.m_int ["cur_step"]        = a_cur_step;
    header.m_real["cur_time"]        = a_cur_time;
    header.m_real["cur_dt"]          = a_cur_dt;
    header.m_real["Er_lo"]           = m_gk_ops->getLoRadialField();
    header.m_real["Er_hi"]           = m_gk_ops->getHiRadialField();
    header.m_int ["restart_version"] = RESTART_VERSION;
+   header.m_int ["staged_dfn"]      = a_staged_dfn? 1: 0;
+   header.m_int ["num_procs"]       = numProc();
+
+   // Names of the species stored in the dfn_<n>, fluid_<n> and field_<n>
+   // groups, so that a restart can select and match them by name
+   header.m_int ["num_kinetic_species"] = kinetic_species.size();
+   for (int species(0); species<kinetic_species.size(); species++) {
+      char buff[100];
+      sprintf( buff, "kinetic_species_%d", species + 1 );
+      header.m_string[buff] = kinetic_species[species]->name();
+
+      // verified after a restart, whatever the layout read onto
+      if ( m_verify_restart ) {
+         sprintf( buff, "dfn_checksum_%d", species + 1 );
+         char checksum[20];
+         sprintf( checksum, "%016llx", dfnChecksum( kinetic_species[species]->distributionFunction() ) );
+         header.m_string[buff] = checksum;
+      }
+   }
+   header.m_int ["num_fluid_species"] = fluid_species.size();
+   for (int species(0); species<fluid_species.size(); species++) {
+      char buff[100];
+      sprintf( buff, "fluid_species_%d", species + 1 );
+      header.m_string[buff] = fluid_species[species]->name();
+   }
+   header.m_int ["num_fields"] = fields.size();
+   for (int field(0); field<fields.size(); field++) {
+      char buff[100];
+      sprintf( buff, "field_%d", field + 1 );
+      header.m_string[buff] = fields[field]->name();
+   }
    header.writeToFile( a_handle );
 
    if ( m_gk_ops->usingAmpereLaw() ) {
-      // save the averaged radial E-field in 4D injected form
-      LevelData<FArrayBox> Er_cell_injected;
-      m_phase_geom->injectConfigurationToPhase( m_gk_ops->getErAverageCell(), Er_cell_injected);
+      // save the averaged radial E-field in its configuration-space layout
       a_handle.setGroup( "Er_cell" );
-      write(a_handle,Er_cell_injected.boxLayout());
-      write(a_handle,Er_cell_injected,"data",Er_cell_injected.ghostVect());
- 
-      LevelData<FluxBox> Er_face_injected;
-      m_phase_geom->injectConfigurationToPhase( m_gk_ops->getErAverageFace(), Er_face_injected);
+      AsyncCheckpointWriter::writeConfigurationData( a_handle, m_gk_ops->getErAverageCell(), m_checkpoint_compression );
+
       a_handle.setGroup( "Er_face" );
-      write(a_handle,Er_face_injected.boxLayout());
-      write(a_handle,Er_face_injected,"data",Er_face_injected.ghostVect());
+      AsyncCheckpointWriter::writeConfigurationData( a_handle, m_gk_ops->getErAverageFace(), m_checkpoint_compression );
 
-      LevelData<FArrayBox> E_tilde_cell_injected;
-      m_phase_geom->injectConfigurationToPhase( m_gk_ops->getETildeCell(), E_tilde_cell_injected);
       a_handle.setGroup( "E_tilde_cell" );
-      write(a_handle,E_tilde_cell_injected.boxLayout());
-      write(a_handle,E_tilde_cell_injected,"data",E_tilde_cell_injected.ghostVect());
- 
-      LevelData<FluxBox> E_tilde_face_injected;
-      m_phase_geom->injectConfigurationToPhase( m_gk_ops->getETildeFace(), E_tilde_face_injected);
+      AsyncCheckpointWriter::writeConfigurationData( a_handle, m_gk_ops->getETildeCell(), m_checkpoint_compression );
+
       a_handle.setGroup( "E_tilde_face" );
-      write(a_handle,E_tilde_face_injected.boxLayout());
-      write(a_handle,E_tilde_face_injected,"data",E_tilde_face_injected.ghostVect());
+      AsyncCheckpointWriter::writeConfigurationData( a_handle, m_gk_ops->getETildeFace(), m_checkpoint_compression );
    }
    
-   const KineticSpeciesPtrVect& kinetic_species( m_state_comp.dataKinetic() );
-   for (int species(0); species<kinetic_species.size(); species++) {
+   if ( !a_staged_dfn ) {
+      for (int species(0); species<kinetic_species.size(); species++) {
+
+         // Get solution distribution function for the current species
+         KineticSpecies& soln_species( *(kinetic_species[species]) );
+         LevelData<FArrayBox> & soln_dfn = soln_species.distributionFunction();
+         char buff[100];
+         sprintf( buff, "dfn_%d", species + 1 );
+         a_handle.setGroup( buff );
+         write( a_handle, soln_dfn.boxLayout() );
+         write( a_handle, soln_dfn, "data" );
+      }
+   }
 
-      // Get solution distribution function for the current species
-      KineticSpecies& soln_species( *(kinetic_species[species]) );
-      LevelData<FArrayBox> & soln_dfn = soln_species.distributionFunction();
+   for (int species(0); species<fluid_species.size(); species++) {
+      char buff[100];
+      sprintf( buff, "fluid_%d", species + 1 );
+      a_handle.setGroup( buff );
+      AsyncCheckpointWriter::writeConfigurationData( a_handle, fluid_species[species]->data(), m_checkpoint_compression );
+   }
+
+   for (int field(0); field<fields.size(); field++) {
       char buff[100];
-      sprintf( buff, "dfn_%d", species + 1 );
+      sprintf( buff, "field_%d", field + 1 );
       a_handle.setGroup( buff );
-      write( a_handle, soln_dfn.boxLayout() );
-      write( a_handle, soln_dfn, "data" );
+      AsyncCheckpointWriter::writeConfigurationData( a_handle, fields[field]->data(), m_checkpoint_compression );
    }
 
-   // JAFH: Need to do something similar here for m_fluid_species and m_fields
+   writePhaseDecompositionCosts( a_handle );
 
    MPI_Barrier(MPI_COMM_WORLD);
    if (procID()==0) {
@@ -1554,11 +1834,44 @@ void GKSystem::writeCheckpointFile( HDF5Handle&  a_handle,
 }
 
 
+// Returns the one-based group of a species in a checkpoint, or 0 if the
+// species is not there or not selected for restart.  Checkpoints without
+// species names (restart_version < 3) only hold the kinetic species, in order.
+inline
+int checkpointGroup( HDF5HeaderData&                 a_header,
+                     const std::string&              a_kind,
+                     const std::string&              a_count_key,
+                     const std::string&              a_name,
+                     const int                       a_position,
+                     const std::vector<std::string>& a_selected )
+{
+   if ( !a_selected.empty() &&
+        std::find( a_selected.begin(), a_selected.end(), a_name ) == a_selected.end() ) {
+      return 0;
+   }
+
+   if ( a_header.m_int.find( a_count_key ) == a_header.m_int.end() ) {
+      return (a_kind == "kinetic_species")? a_position + 1: 0;
+   }
+
+   const int count( a_header.m_int[a_count_key] );
+   for (int n(1); n<=count; n++) {
+      char buff[100];
+      sprintf( buff, "%s_%d", a_kind.c_str(), n );
+      if ( a_header.m_string[buff] == a_name ) {
+         return n;
+      }
+   }
+   return 0;
+}
+
+
 void GKSystem::readCheckpointFile( HDF5Handle& a_handle,
                                    int&        a_cur_step,
                                    double&     a_cur_time,
                                    double&     a_cur_dt )
 {
+   GK_PROFILE(IO);
    //pout() << "reading checkpoint file" << endl;
    HDF5HeaderData header;
    header.readFromFile( a_handle );
@@ -1566,55 +1879,299 @@ void GKSystem::readCheckpointFile( HDF5Handle& a_handle,
    a_cur_step = header.m_int ["cur_step"];
    a_cur_time = header.m_real["cur_time"];
    a_cur_dt   = header.m_real["cur_dt"];
+   const bool staged_dfn = ( header.m_int.find("staged_dfn") != header.m_int.end()
+                             && header.m_int["staged_dfn"] == 1 );
    m_gk_ops->setLoRadialField(header.m_real["Er_lo"]);
    m_gk_ops->setHiRadialField(header.m_real["Er_hi"]);
-   //   const int restart_version = header.m_int ["restart_version"];
+   const int restart_version = ( header.m_int.find("restart_version") != header.m_int.end() )?
+                               header.m_int["restart_version"]: 0;
+
+   KineticSpeciesPtrVect& kinetic_species( m_state_comp.dataKinetic() );
+   CFG::FluidSpeciesPtrVect& fluid_species( m_state_comp.dataFluid() );
+   CFG::FieldPtrVect& fields( m_state_comp.dataField() );
+
+   // Locate every species before reading any: those not restored from the
+   // file are set to their initial conditions, which sets the whole state
+   bool initialize(false);
+   std::vector<int> kinetic_group( kinetic_species.size() );
+   for (int species(0); species<kinetic_species.size(); species++) {
+      kinetic_group[species] = checkpointGroup( header, "kinetic_species", "num_kinetic_species",
+                                                kinetic_species[species]->name(), species, m_restart_species );
+      if ( kinetic_group[species] == 0 ) initialize = true;
+   }
+   std::vector<int> fluid_group( fluid_species.size() );
+   for (int species(0); species<fluid_species.size(); species++) {
+      fluid_group[species] = checkpointGroup( header, "fluid_species", "num_fluid_species",
+                                              fluid_species[species]->name(), species, m_restart_species );
+      if ( fluid_group[species] == 0 ) initialize = true;
+   }
+   std::vector<int> field_group( fields.size() );
+   for (int field(0); field<fields.size(); field++) {
+      field_group[field] = checkpointGroup( header, "field", "num_fields",
+                                            fields[field]->name(), field, m_restart_species );
+      if ( field_group[field] == 0 ) initialize = true;
+   }
+
+   if ( initialize ) {
+      if (procID()==0) {
+         cout << "Setting the species not restored from the checkpoint to their initial conditions" << endl;
+      }
+      m_gk_ops->initializeState( m_state_comp, a_cur_time );
+   }
 
    if ( m_gk_ops->usingAmpereLaw() ) {
-      a_handle.setGroup("Er_cell");
-      CFG::LevelData<CFG::FArrayBox> Er_cell_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
-      LevelData<FArrayBox> Er_cell_injected;
-      m_phase_geom->injectConfigurationToPhase(Er_cell_config, Er_cell_injected);
-      read( a_handle, Er_cell_injected, "data", Er_cell_injected.disjointBoxLayout() );
-      m_gk_ops->setErAverage( Er_cell_injected );
+      if ( restart_version >= 3 ) {
+         const CFG::DisjointBoxLayout& mag_grids( m_mag_geom->gridsFull() );
+
+         a_handle.setGroup("Er_cell");
+         CFG::LevelData<CFG::FArrayBox> Er_cell(mag_grids, 3, CFG::IntVect::Unit);
+         AsyncCheckpointWriter::readConfigurationData( a_handle, Er_cell );
+         m_gk_ops->setErAverage( Er_cell );
+
+         a_handle.setGroup("Er_face");
+         CFG::LevelData<CFG::FluxBox> Er_face(mag_grids, 3, CFG::IntVect::Unit);
+         AsyncCheckpointWriter::readConfigurationData( a_handle, Er_face );
+         m_gk_ops->setErAverage( Er_face );
+
+         a_handle.setGroup("E_tilde_cell");
+         CFG::LevelData<CFG::FArrayBox> E_tilde_cell(mag_grids, 3, CFG::IntVect::Unit);
+         AsyncCheckpointWriter::readConfigurationData( a_handle, E_tilde_cell );
+         m_gk_ops->setETilde( E_tilde_cell );
+
+         a_handle.setGroup("E_tilde_face");
+         CFG::LevelData<CFG::FluxBox> E_tilde_face(mag_grids, 3, CFG::IntVect::Unit);
+         AsyncCheckpointWriter::readConfigurationData( a_handle, E_tilde_face );
+         m_gk_ops->setETilde( E_tilde_face );
+      }
+      else {
+         // earlier checkpoints hold these fields in 4D injected form
+         a_handle.setGroup("Er_cell");
+         CFG::LevelData<CFG::FArrayBox> Er_cell_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
+         LevelData<FArrayBox> Er_cell_injected;
+         m_phase_geom->injectConfigurationToPhase(Er_cell_config, Er_cell_injected);
+         readOntoLayout( a_handle, Er_cell_injected, Er_cell_injected.disjointBoxLayout(), true );
+         m_gk_ops->setErAverage( Er_cell_injected );
     
-      a_handle.setGroup("Er_face");
-      CFG::LevelData<CFG::FluxBox> Er_face_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
-      LevelData<FluxBox> Er_face_injected;
-      m_phase_geom->injectConfigurationToPhase(Er_face_config, Er_face_injected);
-      read( a_handle, Er_face_injected, "data", Er_face_injected.disjointBoxLayout() );
-      m_gk_ops->setErAverage( Er_face_injected );
-
-      a_handle.setGroup("E_tilde_cell");
-      CFG::LevelData<CFG::FArrayBox> E_tilde_cell_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
-      LevelData<FArrayBox> E_tilde_cell_injected;
-      m_phase_geom->injectConfigurationToPhase(E_tilde_cell_config, E_tilde_cell_injected);
-      read( a_handle, E_tilde_cell_injected, "data", E_tilde_cell_injected.disjointBoxLayout() );
-      m_gk_ops->setETilde( E_tilde_cell_injected );
+         a_handle.setGroup("Er_face");
+         CFG::LevelData<CFG::FluxBox> Er_face_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
+         LevelData<FluxBox> Er_face_injected;
+         m_phase_geom->injectConfigurationToPhase(Er_face_config, Er_face_injected);
+         readOntoLayout( a_handle, Er_face_injected, Er_face_injected.disjointBoxLayout(), true );
+         m_gk_ops->setErAverage( Er_face_injected );
+
+         a_handle.setGroup("E_tilde_cell");
+         CFG::LevelData<CFG::FArrayBox> E_tilde_cell_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
+         LevelData<FArrayBox> E_tilde_cell_injected;
+         m_phase_geom->injectConfigurationToPhase(E_tilde_cell_config, E_tilde_cell_injected);
+         readOntoLayout( a_handle, E_tilde_cell_injected, E_tilde_cell_injected.disjointBoxLayout(), true );
+         m_gk_ops->setETilde( E_tilde_cell_injected );
     
-      a_handle.setGroup("E_tilde_face");
-      CFG::LevelData<CFG::FluxBox> E_tilde_face_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
-      LevelData<FluxBox> E_tilde_face_injected;
-      m_phase_geom->injectConfigurationToPhase(E_tilde_face_config, E_tilde_face_injected);
-      read( a_handle, E_tilde_face_injected, "data", E_tilde_face_injected.disjointBoxLayout() );
-      m_gk_ops->setETilde( E_tilde_face_injected );
+         a_handle.setGroup("E_tilde_face");
+         CFG::LevelData<CFG::FluxBox> E_tilde_face_config(m_mag_geom->grids(), 3, CFG::IntVect::Unit);
+         LevelData<FluxBox> E_tilde_face_injected;
+         m_phase_geom->injectConfigurationToPhase(E_tilde_face_config, E_tilde_face_injected);
+         readOntoLayout( a_handle, E_tilde_face_injected, E_tilde_face_injected.disjointBoxLayout(), true );
+         m_gk_ops->setETilde( E_tilde_face_injected );
+      }
    }
 
-   KineticSpeciesPtrVect& kinetic_species( m_state_comp.dataKinetic() );
+   // The distribution functions are read onto the current layout, which
+   // may differ from that of the file in boxes and number of processes
+   double dfn_time(0.);
+   int num_dfn_read(0);
    for (int species(0); species<kinetic_species.size(); species++) {
+      if ( kinetic_group[species] == 0 ) continue;
 
       // Get solution distribution function for the current species
       KineticSpecies& soln_species( *(kinetic_species[species]) );
       LevelData<FArrayBox>& soln_dfn = soln_species.distributionFunction();
       char buff[100];
-      sprintf( buff, "dfn_%d", species + 1 );
+      sprintf( buff, "dfn_%d", kinetic_group[species] );
       a_handle.setGroup( buff );
-      read( a_handle, soln_dfn, "data", soln_dfn.disjointBoxLayout(), Interval(0,soln_dfn.nComp()-1), false );
+      const double start( GKProfiler::wallTime() );
+      if ( staged_dfn ) {
+         AsyncCheckpointWriter::read( a_handle, soln_dfn );
+      }
+      else {
+         readOntoLayout( a_handle, soln_dfn, soln_dfn.disjointBoxLayout(), false );
+      }
+      dfn_time += GKProfiler::wallTime() - start;
+      num_dfn_read++;
+
+      sprintf( buff, "dfn_checksum_%d", kinetic_group[species] );
+      if ( m_verify_restart && header.m_string.find( buff ) != header.m_string.end() ) {
+         char checksum[20];
+         sprintf( checksum, "%016llx", dfnChecksum( soln_dfn ) );
+         if ( header.m_string[buff] != checksum ) {
+            MayDay::Error( "GKSystem::readCheckpointFile: distribution function differs from the checkpoint after redistribution" );
+         }
+      }
    }
 
-   // JAFH: Need to do something similar here for m_fluid_species and m_fields
+   if ( num_dfn_read > 0 ) {
+      double max_dfn_time( dfn_time );
+#ifdef CH_MPI
+      MPI_Allreduce( &dfn_time, &max_dfn_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD );
+#endif
+      if (procID()==0) {
+         cout << "Restart: read and redistributed " << num_dfn_read << " distribution function(s)";
+         if ( header.m_int.find("num_procs") != header.m_int.end() ) {
+            cout << " from " << header.m_int["num_procs"] << " onto " << numProc() << " processes";
+         }
+         cout << " in " << max_dfn_time << " s" << endl;
+      }
+   }
+
+   for (int species(0); species<fluid_species.size(); species++) {
+      if ( fluid_group[species] == 0 ) continue;
+      char buff[100];
+      sprintf( buff, "fluid_%d", fluid_group[species] );
+      a_handle.setGroup( buff );
+      AsyncCheckpointWriter::readConfigurationData( a_handle, fluid_species[species]->data() );
+   }
+
+   for (int field(0); field<fields.size(); field++) {
+      if ( field_group[field] == 0 ) continue;
+      char buff[100];
+      sprintf( buff, "field_%d", field_group[field] );
+      a_handle.setGroup( buff );
+      AsyncCheckpointWriter::readConfigurationData( a_handle, fields[field]->data() );
+   }
 
    m_gk_ops->readCheckpointFile( a_handle, a_cur_step );
+
+   // The state was replaced by the checkpoint data
+   invalidatePhysicalState();
+}
+
+
+void GKSystem::writePhaseDecompositionCosts( HDF5Handle& a_handle ) const
+{
+   // Save the kernel time measured on each phase space box since the last
+   // checkpoint, so that a cost-weighted decomposition can rebalance on restart
+   Vector<Box> boxes;
+   Vector<Real> work;
+   m_phase_geom->getBoxWork( boxes, work );
+
+   const DisjointBoxLayout& grids( m_phase_grid->disjointBoxLayout() );
+   Vector<Real> load( numProc(), 0. );
+   Real total_work( 0. );
+   int k = 0;
+   for (LayoutIterator lit(grids.layoutIterator()); lit.ok(); ++lit) {
+      load[grids.procID(lit())] += work[k];
+      total_work += work[k++];
+   }
+   Real max_load( 0. );
+   for (int proc=0; proc<load.size(); ++proc) {
+      if (load[proc] > max_load) max_load = load[proc];
+   }
+   if (procID()==0 && total_work > 0.) {
+      cout << "Measured phase space load imbalance (max/mean) since last checkpoint: "
+           << max_load * numProc() / total_work << endl;
+   }
+
+   a_handle.setGroup( "phase_decomposition" );
+
+   hsize_t flatdims[1], count[1];
+
+   int *ibuff = new int[2*PDIM*boxes.size()];
+   for (int n=0; n<boxes.size(); ++n) {
+      for (int dir=0; dir<PDIM; ++dir) {
+         ibuff[2*PDIM*n + dir] = boxes[n].smallEnd(dir);
+         ibuff[2*PDIM*n + PDIM + dir] = boxes[n].bigEnd(dir);
+      }
+   }
+   flatdims[0] = 2*PDIM*boxes.size();
+   count[0] = 2*PDIM*boxes.size();
+   hid_t boxdataspace = H5Screate_simple(1, flatdims, NULL);
+#ifdef H516
+   hid_t boxdataset   = H5Dcreate(a_handle.groupID(), "boxes",
+                                  H5T_NATIVE_INT, boxdataspace, H5P_DEFAULT);
+#else
+   hid_t boxdataset   = H5Dcreate(a_handle.groupID(), "boxes",
+                                  H5T_NATIVE_INT, boxdataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+#endif
+   hid_t bmemdataspace = H5Screate_simple(1, count, NULL);
+   H5Dwrite(boxdataset, H5T_NATIVE_INT, bmemdataspace, boxdataspace,
+            H5P_DEFAULT, ibuff);
+   H5Dclose(boxdataset);
+   delete [] ibuff;
+
+   flatdims[0] = work.size();
+   count[0] = work.size();
+   hid_t costdataspace = H5Screate_simple(1, flatdims, NULL);
+#ifdef H516
+   hid_t costdataset   = H5Dcreate(a_handle.groupID(), "costs",
+                                   H5T_NATIVE_REAL, costdataspace, H5P_DEFAULT);
+#else
+   hid_t costdataset   = H5Dcreate(a_handle.groupID(), "costs",
+                                   H5T_NATIVE_REAL, costdataspace, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+#endif
+   hid_t cmemdataspace = H5Screate_simple(1, count, NULL);
+   H5Dwrite(costdataset, H5T_NATIVE_REAL, cmemdataspace, costdataspace,
+            H5P_DEFAULT, &work[0]);
+   H5Dclose(costdataset);
+
+   m_phase_geom->resetBoxWork();
+}
+
+
+void GKSystem::readPhaseDecompositionCosts( PhaseDecompositionCosts& a_costs ) const
+{
+   // When restarting, pick up the per-box work measured by the previous run
+   ParmParse ppsim( "simulation" );
+   std::string restart_file;
+   if ( !ppsim.contains( "restart_file" ) ) return;
+   ppsim.get( "restart_file", restart_file );
+
+   HDF5Handle handle( restart_file, HDF5Handle::OPEN_RDONLY );
+
+   // Checkpoints written before the costs were saved have no such group
+   if ( handle.setGroup( "phase_decomposition" ) == 0 ) {
+
+      hsize_t dims[1];
+
+#ifdef H516
+      hid_t costdataset = H5Dopen(handle.groupID(), "costs");
+#else
+      hid_t costdataset = H5Dopen(handle.groupID(), "costs", H5P_DEFAULT);
+#endif
+      hid_t costdataspace = H5Dget_space(costdataset);
+      H5Sget_simple_extent_dims(costdataspace, dims, NULL);
+      int num_boxes = dims[0];
+
+      a_costs.measured_costs.resize(num_boxes);
+      hid_t cmemdataspace = H5Screate_simple(1, dims, NULL);
+      H5Dread(costdataset, H5T_NATIVE_REAL, cmemdataspace, costdataspace,
+              H5P_DEFAULT, &a_costs.measured_costs[0]);
+      H5Dclose(costdataset);
+
+      int *ibuff = new int[2*PDIM*num_boxes];
+      dims[0] = 2*PDIM*num_boxes;
+#ifdef H516
+      hid_t boxdataset = H5Dopen(handle.groupID(), "boxes");
+#else
+      hid_t boxdataset = H5Dopen(handle.groupID(), "boxes", H5P_DEFAULT);
+#endif
+      hid_t boxdataspace = H5Dget_space(boxdataset);
+      hid_t bmemdataspace = H5Screate_simple(1, dims, NULL);
+      H5Dread(boxdataset, H5T_NATIVE_INT, bmemdataspace, boxdataspace,
+              H5P_DEFAULT, ibuff);
+      H5Dclose(boxdataset);
+
+      a_costs.measured_boxes.resize(num_boxes);
+      for (int n=0; n<num_boxes; ++n) {
+         IntVect lo, hi;
+         for (int dir=0; dir<PDIM; ++dir) {
+            lo[dir] = ibuff[2*PDIM*n + dir];
+            hi[dir] = ibuff[2*PDIM*n + PDIM + dir];
+         }
+         a_costs.measured_boxes[n] = Box(lo, hi);
+      }
+      delete [] ibuff;
+   }
+
+   handle.close();
 }
 
 
@@ -1628,7 +2185,21 @@ void GKSystem::setupFieldHistories()
 
 void GKSystem::writeFieldHistory(int cur_step, double cur_time, bool startup_flag)
 {
-  m_gk_ops->writeFieldHistory( cur_step, cur_time, startup_flag );
+  GK_PROFILE(IO);
+  // Moment probes need the physical-space species
+  const KineticSpeciesPtrVect& kinetic_species( m_gk_ops->historyUsesKineticSpecies( cur_step, startup_flag ) ?
+                                                physicalState().dataKinetic() :
+                                                m_state_comp.dataKinetic() );
+  m_gk_ops->writeFieldHistory( cur_step, cur_time, startup_flag, kinetic_species );
+}
+
+
+void GKSystem::writeProfile( const std::string& a_filename,
+                             const std::string& a_format,
+                             const int          a_cur_step,
+                             const double       a_cur_time )
+{
+   GKProfiler::instance().write( a_filename, a_format, a_cur_step, a_cur_time );
 }
 
 
@@ -1661,8 +2232,10 @@ void GKSystem::preTimeStep(int a_cur_step, Real a_cur_time)
       m_integrator->setCurrentTime( a_cur_time );
       m_integrator->setTimeStep( a_cur_step );
    }
-   m_gk_ops->divideJ( m_state_comp, m_state_phys );
-   m_gk_ops->preTimeStep( a_cur_step, a_cur_time, m_state_comp, m_state_phys );
+   // The physical state is only needed by some collision models
+   const GKState& state_phys( m_gk_ops->preTimeStepUsesPhysicalState()
+                              ? physicalState() : m_state_phys );
+   m_gk_ops->preTimeStep( a_cur_step, a_cur_time, m_state_comp, state_phys );
 }
 
 
@@ -1680,7 +2253,6 @@ void printTimeStep( const Real& a_dt,
 void GKSystem::postTimeStep(int a_cur_step, Real a_dt, Real a_cur_time)
 {
   m_gk_ops->postTimeStep( a_cur_step, a_cur_time, m_state_comp );
-  m_gk_ops->divideJ( m_state_comp, m_state_phys );
   if (procID() == 0) {
     cout << "  ----\n";
     cout << "  dt: " << a_dt << std::endl;
@@ -1692,6 +2264,12 @@ void GKSystem::postTimeStep(int a_cur_step, Real a_dt, Real a_cur_time)
     printTimeStep( dt_transport, "    Transport : ", a_dt ); 
     Real dt_neutrals = m_gk_ops->dtScaleNeutrals( m_state_comp, a_cur_step );
     printTimeStep( dt_neutrals, "    Neutrals  : ", a_dt ); 
+    if (m_verbosity) {
+      cout << "    Workspace : " << m_gk_ops->workspaceBytesReusedLastStep() / (1024.0*1024.0)
+           << " MB of temporary allocations avoided (rank 0)\n";
+      cout << "    Phys. state: " << m_num_phys_updates
+           << " divisions by J since start\n";
+    }
     cout << "  ----\n";
   }
 }
@@ -1739,6 +2317,16 @@ inline void GKSystem::printParameters() const
 #endif
       }
 
+      if (m_weighted_decomposition) {
+         cout << "weighted_decomposition = true, decomp_boxes_per_proc = " << m_decomp_boxes_per_proc << endl;
+         if (m_decomp_block_weights.size() > 0) {
+            cout << "decomp_block_weights = ";
+            for (int i=0; i<m_decomp_block_weights.size(); i++)
+               cout << m_decomp_block_weights[i] << " ";
+            cout << endl;
+         }
+      }
+
       cout << "enforce_positivity = " << (m_enforce_step_positivity||m_enforce_stage_positivity) << endl;
       std::string ptype("stage");
       if (m_enforce_step_positivity)
@@ -1802,6 +2390,31 @@ void GKSystem::parseParameters( ParmParse&         a_ppgksys )
       for (int i=0; i<VEL_DIM; ++i) CH_assert( m_velocity_decomposition[i]>0 );
    }
 
+   // Cost-weighted phase space decomposition: relative cost of a cell in
+   // each block and the number of boxes to aim for per process
+   a_ppgksys.query("weighted_decomposition", m_weighted_decomposition);
+   a_ppgksys.query("decomp_boxes_per_proc", m_decomp_boxes_per_proc);
+   if (a_ppgksys.contains("decomp_block_weights")) {
+      int num_weights = a_ppgksys.countval("decomp_block_weights");
+      m_decomp_block_weights.resize( num_weights );
+      a_ppgksys.getarr( "decomp_block_weights", m_decomp_block_weights, 0, num_weights );
+   }
+
+   // Deflate level of the configuration-space checkpoint data, and the
+   // species (kinetic, fluid or field) to read on restart
+   a_ppgksys.query("checkpoint_compression", m_checkpoint_compression);
+   if (m_checkpoint_compression < 0 || m_checkpoint_compression > 9) {
+      MayDay::Error("gksystem.checkpoint_compression must be between 0 and 9");
+   }
+   // Checksums of the distribution functions, written to the checkpoints
+   // and verified after they are read back
+   a_ppgksys.query("verify_restart", m_verify_restart);
+   if (a_ppgksys.contains("restart_species")) {
+      int num_species = a_ppgksys.countval("restart_species");
+      m_restart_species.resize( num_species );
+      a_ppgksys.getarr( "restart_species", m_restart_species, 0, num_species );
+   }
+
    // time integration method to use 
    a_ppgksys.query("ti_class",m_ti_class);
    a_ppgksys.query("ti_method",m_ti_method);
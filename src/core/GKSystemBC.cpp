@@ -1,6 +1,7 @@
 #include "GKSystemBC.H"
 
 #include "KineticSpeciesBCFactory.H"
+#include "GKProfiler.H"
 
 #undef CH_SPACEDIM
 #define CH_SPACEDIM CFG_DIM
@@ -56,6 +57,8 @@ void GKSystemBC::executeInternalExchanges( KineticSpecies& a_species ) const
    LevelData<FArrayBox>& dfn( a_species.distributionFunction() );
    const PhaseGeom& geometry( a_species.phaseSpaceGeometry() );
    // Fill ghost cells except for those on physical boundaries
+   GK_PROFILE(EXCHANGE);
+   GK_PROFILE_WAIT();
    geometry.fillInternalGhosts(dfn);
 }
 
@@ -82,6 +82,43 @@ int computeVectorSize( const KineticSpeciesPtrVect& a_kinetic_species,
    return total_size;
 }
 
+bool GKRHSData::sameLayout( const GKRHSData& a_Y ) const
+{
+   if ( !isDefined() || !a_Y.isDefined()
+        || m_kinetic_species.size() != a_Y.m_kinetic_species.size()
+        || m_fluid_species.size() != a_Y.m_fluid_species.size()
+        || m_fields.size() != a_Y.m_fields.size() ) {
+      return false;
+   }
+   for (int s(0); s<m_kinetic_species.size(); s++) {
+      const LevelData<FArrayBox>& dfn( m_kinetic_species[s]->distributionFunction() );
+      const LevelData<FArrayBox>& Y_dfn( a_Y.m_kinetic_species[s]->distributionFunction() );
+      if ( !(dfn.disjointBoxLayout() == Y_dfn.disjointBoxLayout())
+           || dfn.nComp() != Y_dfn.nComp() || dfn.ghostVect() != Y_dfn.ghostVect() ) {
+         return false;
+      }
+   }
+   for (int s(0); s<m_fluid_species.size(); s++) {
+      const CFG::LevelData<CFG::FArrayBox>& data( m_fluid_species[s]->data() );
+      const CFG::LevelData<CFG::FArrayBox>& Y_data( a_Y.m_fluid_species[s]->data() );
+      if ( !(data.disjointBoxLayout() == Y_data.disjointBoxLayout())
+           || data.nComp() != Y_data.nComp() || data.ghostVect() != Y_data.ghostVect() ) {
+         return false;
+      }
+   }
+   for (int s(0); s<m_fields.size(); s++) {
+      const CFG::LevelData<CFG::FArrayBox>& data( m_fields[s]->data() );
+      const CFG::LevelData<CFG::FArrayBox>& Y_data( a_Y.m_fields[s]->data() );
+      if ( !(data.disjointBoxLayout() == Y_data.disjointBoxLayout())
+           || data.nComp() != Y_data.nComp() || data.ghostVect() != Y_data.ghostVect() ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+////////////////////////////////////////////////////////////////////
+
 int GKState::getVectorSize()
 {
    CH_assert( isDefined() );
@@ -311,6 +348,98 @@ void GKRHSData::increment( const GKState& a_delta,
 
 ////////////////////////////////////////////////////////////////////
 
+inline
+void linearCombinationData( KineticSpeciesPtrVect& a_kinetic_species,
+                            const KineticSpeciesPtrVect& a_kinetic_species_0,
+                            CFG::FluidSpeciesPtrVect& a_fluid_species,
+                            const CFG::FluidSpeciesPtrVect& a_fluid_species_0,
+                            CFG::FieldPtrVect& a_fields,
+                            const CFG::FieldPtrVect& a_fields_0,
+                            const Real& a_a0,
+                            const GKRHSData* const* a_R,
+                            const Real* a_a,
+                            const int a_n )
+{
+   CH_assert( a_kinetic_species.size()==a_kinetic_species_0.size() );
+   CH_assert( a_fluid_species.size()==a_fluid_species_0.size() );
+   CH_assert( a_fields.size()==a_fields_0.size() );
+
+   Vector<const LevelData<FArrayBox>*> kinetic_terms( a_n );
+   for (int s(0); s<a_kinetic_species.size(); s++) {
+      for (int k(0); k<a_n; k++) {
+         kinetic_terms[k] = &( a_R[k]->dataKinetic()[s]->distributionFunction() );
+      }
+      GKUtils::linearCombinationLevelData( a_kinetic_species[s]->distributionFunction(),
+                                           a_a0,
+                                           a_kinetic_species_0[s]->distributionFunction(),
+                                           kinetic_terms,
+                                           a_a );
+   }
+
+   Vector<const CFG::LevelData<CFG::FArrayBox>*> cfg_terms( a_n );
+   for (int s(0); s<a_fluid_species.size(); s++) {
+      for (int k(0); k<a_n; k++) {
+         cfg_terms[k] = &( a_R[k]->dataFluid()[s]->data() );
+      }
+      CFG::GKUtils::linearCombinationLevelData( a_fluid_species[s]->data(),
+                                                a_a0,
+                                                a_fluid_species_0[s]->data(),
+                                                cfg_terms,
+                                                a_a );
+   }
+   for (int s(0); s<a_fields.size(); s++) {
+      for (int k(0); k<a_n; k++) {
+         cfg_terms[k] = &( a_R[k]->dataField()[s]->data() );
+      }
+      CFG::GKUtils::linearCombinationLevelData( a_fields[s]->data(),
+                                                a_a0,
+                                                a_fields_0[s]->data(),
+                                                cfg_terms,
+                                                a_a );
+   }
+}
+
+void GKState::linearCombination( const GKState& a_X0,
+                                 const Real& a_a0,
+                                 const GKRHSData* const* a_R,
+                                 const Real* a_a,
+                                 const int a_n )
+{
+   CH_assert( isDefined() );
+   linearCombinationData( m_kinetic_species, a_X0.dataKinetic(),
+                          m_fluid_species, a_X0.dataFluid(),
+                          m_fields, a_X0.dataField(),
+                          a_a0, a_R, a_a, a_n );
+}
+
+void GKRHSData::linearCombination( const GKRHSData& a_X0,
+                                   const Real& a_a0,
+                                   const GKRHSData* const* a_R,
+                                   const Real* a_a,
+                                   const int a_n )
+{
+   CH_assert( isDefined() );
+   linearCombinationData( m_kinetic_species, a_X0.dataKinetic(),
+                          m_fluid_species, a_X0.dataFluid(),
+                          m_fields, a_X0.dataField(),
+                          a_a0, a_R, a_a, a_n );
+}
+
+void GKRHSData::linearCombination( const GKState& a_X0,
+                                   const Real& a_a0,
+                                   const GKRHSData* const* a_R,
+                                   const Real* a_a,
+                                   const int a_n )
+{
+   CH_assert( isDefined() );
+   linearCombinationData( m_kinetic_species, a_X0.dataKinetic(),
+                          m_fluid_species, a_X0.dataFluid(),
+                          m_fields, a_X0.dataField(),
+                          a_a0, a_R, a_a, a_n );
+}
+
+////////////////////////////////////////////////////////////////////
+
 Real GKRHSData::dotProduct( const GKRHSData& a_vector )
 {
    CH_assert( isDefined() );
@@ -350,6 +479,53 @@ Real GKRHSData::dotProduct( const GKRHSData& a_vector )
 
    return sum;
 }
+
+////////////////////////////////////////////////////////////////////
+
+void GKRHSData::mDotProduct( const int a_n,
+                             const GKRHSData a_Y[],
+                             Real* a_dots )
+{
+   CH_assert( isDefined() );
+   std::vector<double> sum_local( a_n, 0.0 );
+
+   for (int k(0); k<a_n; k++) {
+
+      const KineticSpeciesPtrVect& b_kinetic_species( a_Y[k].dataKinetic() );
+      CH_assert( m_kinetic_species.size()==b_kinetic_species.size() );
+      for (int s(0); s<m_kinetic_species.size(); s++) {
+         sum_local[k] += GKUtils::innerProductLevelData(
+            m_kinetic_species[s]->distributionFunction(),
+            b_kinetic_species[s]->distributionFunction() );
+      }
+
+      const  CFG::FluidSpeciesPtrVect& b_fluid_species( a_Y[k].dataFluid() );
+      CH_assert( m_fluid_species.size()==b_fluid_species.size() );
+      for (int s(0); s<m_fluid_species.size(); s++) {
+         sum_local[k] += CFG::GKUtils::innerProductLevelData(
+            m_fluid_species[s]->data(),
+            b_fluid_species[s]->data() );
+      }
+
+      const  CFG::FieldPtrVect& b_fields( a_Y[k].dataField() );
+      CH_assert( m_fields.size()==b_fields.size() );
+      for (int s(0); s<m_fields.size(); s++) {
+         sum_local[k] += CFG::GKUtils::innerProductLevelData(
+            m_fields[s]->data(),
+            b_fields[s]->data() );
+      }
+   }
+
+   if (a_n > 0) {
+#ifdef CH_MPI
+      std::vector<double> sum( a_n, 0.0 );
+      MPI_Allreduce( &(sum_local[0]), &(sum[0]), a_n, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD );
+      for (int k(0); k<a_n; k++) a_dots[k] = sum[k];
+#else
+      for (int k(0); k<a_n; k++) a_dots[k] = sum_local[k];
+#endif
+   }
+}
    
 ////////////////////////////////////////////////////////////////////
    
@@ -1,5 +1,6 @@
 #include "Simulation.H"
 #include <limits>
+#include <cmath>
 
 #include "NamespaceHeader.H"
 
@@ -12,7 +13,13 @@ Simulation<SYSTEM>::printParameters()
    pout() << "maximum step = " << m_max_step << endl;
    pout() << "maximum time = " << m_max_time << endl;
    pout() << "checkpoint interval = " << m_checkpoint_interval << endl;
+   pout() << "asynchronous checkpoints = " << m_async_checkpoint << endl;
    pout() << "plot interval = " << m_plot_interval << endl;
+   pout() << "error control = " << m_error_control << endl;
+   pout() << "profile interval = " << m_profile_interval << endl;
+#ifdef _OPENMP
+   pout() << "threads per rank = " << omp_get_max_threads() << endl;
+#endif
 }
 
 
@@ -56,6 +63,12 @@ Simulation<SYSTEM>::writePlotFile()
    //   pout() << "plot file name = " << iter_str << endl;
    //}
 
+   // Plot files are written synchronously, so any background checkpoint
+   // write must finish first
+   if (m_async_checkpoint) {
+      m_system->waitForCheckpoint();
+   }
+
    // HDF5Handle handle( iter_str, HDF5Handle::CREATE );
    // Instead of dummy file with prefix, use prefix for all plot files.
    m_system->writePlotFile( iter_str, m_cur_step, m_cur_time);
@@ -92,14 +105,29 @@ Simulation<SYSTEM>::writeCheckpointFile()
       pout() << "checkpoint file name = " << iter_str << endl;
    }
 
-   HDF5Handle handle( iter_str, HDF5Handle::CREATE );
-   m_system->writeCheckpointFile( handle, m_cur_step, m_cur_time, m_cur_dt );
-   handle.close();
+   if (m_async_checkpoint) {
+      m_system->writeCheckpointFileAsync( iter_str, m_cur_step, m_cur_time, m_cur_dt );
+   }
+   else {
+      HDF5Handle handle( iter_str, HDF5Handle::CREATE );
+      m_system->writeCheckpointFile( handle, m_cur_step, m_cur_time, m_cur_dt );
+      handle.close();
+   }
 #else
    MayDay::Error( "restart only defined with hdf5" );
 #endif
 }
 
+template <class SYSTEM> inline void
+Simulation<SYSTEM>::writeProfile()
+{
+   if (m_verbosity>=3) {
+      pout() << "Simulation<SYSTEM>::writeProfile" << endl;
+   }
+   const std::string filename( "profile." + m_profile_format );
+   m_system->writeProfile( filename, m_profile_format, m_cur_step, m_cur_time );
+}
+
 template <class SYSTEM> inline void
 Simulation<SYSTEM>::initializeTimers()
 {
@@ -128,12 +156,23 @@ Simulation<SYSTEM>::Simulation( ParmParse& a_pp )
        m_init_dt_frac(0.1),
        m_cfl(1.0),
        m_adapt_dt(true),
+       m_error_control(false),
+       m_error_rtol(1.0e-4),
+       m_error_atol(0.0),
+       m_max_rejections(10),
+       m_error_prev(1.0),
+       m_error_dt(-1.0),
+       m_accepted_steps(0),
+       m_rejected_steps(0),
        m_checkpoint_interval(0),
        m_last_checkpoint(0),
        m_checkpoint_prefix( "chk" ),
+       m_async_checkpoint(false),
        m_plot_interval(0),
        m_last_plot(0),
        m_plot_prefix( "plt" ),
+       m_profile_interval(0),
+       m_profile_format( "json" ),
        m_system( NULL )
 #ifdef CH_USE_TIMER
 ,
@@ -163,6 +202,11 @@ Simulation<SYSTEM>::Simulation( ParmParse& a_pp )
    m_system->initialize(m_cur_step);
    m_system->printDiagnostics();
 
+   if ( m_error_control &&
+        !m_system->defineErrorControl( m_error_rtol, m_error_atol ) ) {
+      MayDay::Error( "error_control requires a time integration method with an embedded error estimate!" );
+   }
+
    if ( m_plot_interval>=0 ) {
       writePlotFile();
       m_last_plot = m_cur_step;
@@ -222,6 +266,9 @@ void Simulation<SYSTEM>::advance()
       }
       m_cur_step = m_cur_step - m_subiterations + 1;
    }
+   else if (m_error_control) {
+      advanceWithErrorControl();
+   }
    else {
       m_system->advance( m_cur_time, m_cur_dt, m_cur_step );
    }
@@ -249,6 +296,10 @@ void Simulation<SYSTEM>::advance()
       writeCheckpointFile();
       m_last_checkpoint = m_cur_step;
    }
+
+   if ( m_profile_interval>0 && (m_cur_step % m_profile_interval)==0 ) {
+      writeProfile();
+   }
 }
 
 
@@ -270,6 +321,14 @@ void Simulation<SYSTEM>::finalize()
       writeCheckpointFile();
    }
 
+   if (m_async_checkpoint) {
+      m_system->printCheckpointTimes();
+   }
+
+   if ( m_profile_interval>0 && (m_cur_step % m_profile_interval)!=0 ) {
+      writeProfile();
+   }
+
    if (!procID()) {
      cout << "----\n";
    }
@@ -279,6 +338,10 @@ void Simulation<SYSTEM>::finalize()
    }
    m_system->printTimeIntegratorCounts();
    if (!procID()) {
+     if (m_error_control) {
+       cout << "  Error control: " << m_accepted_steps << " steps accepted, "
+            << m_rejected_steps << " steps rejected\n";
+     }
      cout << "----\n";
    }
 
@@ -336,12 +399,26 @@ void Simulation<SYSTEM>::parseParameters( ParmParse& a_ppsim )
       }
    }
 
+   // Choose the time step from the embedded error estimate
+   if ( a_ppsim.query( "error_control", m_error_control ) && m_error_control ) {
+      if (!m_adapt_dt) {
+         MayDay::Error( "fixed_dt and error_control are mutually exclusive!" );
+      }
+      a_ppsim.query( "error_tolerance", m_error_rtol );
+      CH_assert( m_error_rtol>0.0 );
+      a_ppsim.query( "error_abs_tolerance", m_error_atol );
+      CH_assert( m_error_atol>=0.0 );
+      a_ppsim.query( "max_step_rejections", m_max_rejections );
+      CH_assert( m_max_rejections>=0 );
+   }
+
    /* possibly redundant check */
    if (m_adapt_dt) m_fixed_dt_subiteration = false;
 
    // Set up checkpointing
    a_ppsim.query( "checkpoint_interval", m_checkpoint_interval );
    a_ppsim.query( "checkpoint_prefix", m_checkpoint_prefix );
+   a_ppsim.query( "async_checkpoint", m_async_checkpoint );
 
    // Set up plot file writing
    a_ppsim.query( "plot_interval", m_plot_interval );
@@ -349,6 +426,32 @@ void Simulation<SYSTEM>::parseParameters( ParmParse& a_ppsim )
 
    // History parameter parsing moved to GKSystem.cpp
 
+   // Set up profiling output
+   a_ppsim.query( "profile_interval", m_profile_interval );
+   if ( m_profile_interval < 0 ) {
+      MayDay::Error( "profile_interval must be non-negative!" );
+   }
+   a_ppsim.query( "profile_format", m_profile_format );
+   if ( m_profile_format != "json" && m_profile_format != "csv" ) {
+      MayDay::Error( "profile_format must be \"json\" or \"csv\"!" );
+   }
+
+   // Number of threads used by the threaded box loops on each MPI rank
+   // (defaults to the OpenMP runtime setting, e.g., OMP_NUM_THREADS)
+   int num_threads(0);
+   if ( a_ppsim.query( "num_threads", num_threads ) ) {
+      if ( num_threads<=0 ) {
+         MayDay::Error( "num_threads must be positive!" );
+      }
+#ifdef _OPENMP
+      omp_set_num_threads( num_threads );
+#else
+      if ( num_threads>1 && procID()==0 ) {
+         cout << "Warning: simulation.num_threads ignored; not compiled with OpenMP" << endl;
+      }
+#endif
+   }
+
    if (m_verbosity) {
       printParameters();
    }
@@ -389,6 +492,63 @@ inline void Simulation<SYSTEM>::setFixedTimeStep( const Real& a_dt_stable )
 }
 
 
+template <class SYSTEM>
+void Simulation<SYSTEM>::advanceWithErrorControl()
+{
+   // PI controller (Gustafsson) for accepted steps, elementary controller
+   // for retries; the factors are bounded so that a single poor estimate
+   // cannot collapse or blow up the step
+   const Real safety( 0.9 );
+   const Real min_factor( 0.2 );
+   const Real max_factor( 5.0 );
+
+   const Real start_time( m_cur_time );
+   const int start_step( m_cur_step );
+
+   for (int rejections(0); ; rejections++) {
+
+      const Real dt( m_cur_dt );
+      m_system->advance( m_cur_time, m_cur_dt, m_cur_step );
+
+      Real error;
+      int order;
+      m_system->getStepError( error, order );
+      error = std::max( error, 1.0e-10 );
+      const Real k( order + 1 );
+
+      if ( error <= 1.0 || rejections == m_max_rejections ) {
+         Real factor = safety * pow( error, -0.7/k ) * pow( m_error_prev, 0.4/k );
+         factor = std::min( max_factor, std::max( min_factor, factor ) );
+         m_error_dt = dt * factor;
+         m_error_prev = error;
+         m_accepted_steps++;
+
+         if (!procID()) {
+            cout << "  Step accepted: dt = " << dt << ", error = " << error
+                 << ", next dt = " << m_error_dt << endl;
+            if (error > 1.0) {
+               cout << "  Warning: step accepted after " << rejections
+                    << " rejections with error above tolerance" << endl;
+            }
+         }
+         break;
+      }
+
+      Real factor = std::max( min_factor, safety * pow( error, -1.0/k ) );
+      m_system->rejectStep( start_time, start_step );
+      m_cur_time = start_time;
+      m_cur_step = start_step;
+      m_cur_dt = dt * factor;
+      m_rejected_steps++;
+
+      if (!procID()) {
+         cout << "  Step rejected: dt = " << dt << ", error = " << error
+              << ", retrying with dt = " << m_cur_dt << endl;
+      }
+   }
+}
+
+
 template <class SYSTEM>
 void Simulation<SYSTEM>::postTimeStep()
 {
@@ -406,7 +566,13 @@ void Simulation<SYSTEM>::preTimeStep()
       // not initial time step
       if ( m_adapt_dt ) { 
          // adjustable time step
-         m_cur_dt = std::min( dt_stable, m_max_dt_grow * m_cur_dt );
+         if ( m_error_control && m_error_dt>0.0 ) {
+            // error-controlled time step, bounded by the stable time step
+            m_cur_dt = std::min( dt_stable, m_error_dt );
+         }
+         else {
+            m_cur_dt = std::min( dt_stable, m_max_dt_grow * m_cur_dt );
+         }
       } else {                 
          // fixed time step
          setFixedTimeStep( dt_stable );
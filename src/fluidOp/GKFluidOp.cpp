@@ -144,5 +144,24 @@ Real GKFluidOp::computeTimeScale( const FieldPtrVect&        fields,
   return (count ? scale : -1);
 }
 
+void GKFluidOp::computeDtAndTimeScale( const FieldPtrVect&        fields,
+                                       const FluidSpeciesPtrVect& fluids,
+                                       Real&                      dt,
+                                       Real&                      time_scale )
+{
+  std::map<std::string,int>::iterator it;
+  dt = DBL_MAX;
+  Real scale = DBL_MAX;
+  int count = 0;
+  for (it=m_fluid_model_name.begin(); it!=m_fluid_model_name.end(); ++it) {
+    Real tmp_dt = m_fluid_model[it->second]->computeDt(fields, fluids);
+    dt = (tmp_dt < dt ? tmp_dt : dt);
+    Real tmp = m_fluid_model[it->second]->TimeScale(fields, fluids);
+    scale = (tmp < scale ? tmp : scale);
+    count++;
+  }
+  time_scale = (count ? scale : -1);
+}
+
 
 #include "NamespaceFooter.H"
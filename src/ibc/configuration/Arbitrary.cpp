@@ -191,6 +191,8 @@ void Arbitrary::setPointwise( FArrayBox&              a_data,
    
    a_data.setVal(0.0);
 
+   FArrayBox locs( box, SpaceDim );
+
    BoxIterator bit(a_data.box());
    for (bit.begin(); bit.ok(); ++bit)
    {
@@ -228,15 +230,20 @@ void Arbitrary::setPointwise( FArrayBox&              a_data,
 
 
       
+      for (int dir=0; dir<SpaceDim; dir++) {
+         locs(iv,dir) = loc[dir];
+      }
+   }
+
+   // Evaluate the compiled formula over the whole box at once
+   const double* vars[ParsingSpace::NUMVARS_] = {NULL, NULL, NULL, NULL, NULL};
+   vars[ParsingSpace::VX_] = locs.dataPtr(0);
+   vars[ParsingSpace::VY_] = locs.dataPtr(1);
 #if CFG_DIM==3
-       Real val = m_pscore->calc3d(loc[0],loc[1],loc[2]);
-#else
-       Real val = m_pscore->calc2d(loc[0],loc[1]);
+   vars[ParsingSpace::VZ_] = locs.dataPtr(2);
 #endif
 
-       a_data(iv,0) += val;
-
-   }
+   m_pscore->evaluate( box.numPts(), vars, a_data.dataPtr(0) );
 }
 
 
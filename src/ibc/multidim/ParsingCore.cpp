@@ -626,6 +626,7 @@ UserQueue::~UserQueue()
 int ParsingCore::preProcess()
 {
     manipStr=formula;
+    m_compiled=false;
     std::string postFixList[6]={"inverse","INVERSE","Inverse","square","SQUARE","Square"};
     std::string macroList1[6]={"pi","PI","Pi","ans","ANS","Ans"};
     std::string varList1[12]={"x","X","y","Y","z","Z","mu","MU","Mu","vpar","VPAR","Vpar"};
@@ -1188,6 +1189,16 @@ int ParsingCore::inToPostFix()
                         break;
                 }
             }
+            else if( m_compiling && serviceOperData.getPreInPost()==ParsingSpace::VAR_ ){
+                //bound at evaluation time by the bytecode, see compile()
+                parserStr=serviceOperData.codeToStr();
+                //DEBUG
+                postStr+="{";
+                postStr+=parserStr;
+                postStr+="}";
+                //
+                postFix.valStrEnqueue(parserStr);
+            }
             else if( serviceOperData.getPreInPost()==ParsingSpace::VAR_ ){
                         std::stringstream ss;
                 switch(serviceOperData.getIdenCode() ){
@@ -1600,5 +1611,305 @@ double ParsingCore::calculate(double operand2, OperatorData op)
     return temp;
 }
 
+int ParsingCore::compile()
+{
+    //Lower the postfix queue once into a flat stack bytecode.  Literals are
+    //parsed here and variables become loads, so that evaluation does no
+    //string handling.
+    OperatorData serviceOperData;
+    queueData    bufferQData;
+    int depth=0;
+    int err=ParsingSpace::NOERR_;
+
+    m_byteCode.resize(0);
+    m_stackDepth=0;
+    while( postFix.showCnt() ){
+        postFix.dequeue();
+    }
 
+    m_compiling=true;
+    err=inToPostFix();
+    m_compiling=false;
 
+    while( postFix.showCnt() ){
+        bufferQData=postFix.dequeue();
+        if( err!=ParsingSpace::NOERR_ ){
+            continue;
+        }
+        byteCodeData bc;
+        bc.code=0;
+        bc.val=0.0;
+        if(bufferQData.kind){
+            const std::string& valStr=bufferQData.sQv.obCstr;
+            if( !valStr.empty() && valStr[valStr.length()-1]=='\'' ){
+                bc.kind=ParsingSpace::BC_VAR_;
+                switch( serviceOperData.operToCode(valStr) ){
+                    case ParsingSpace::X__:    bc.code=ParsingSpace::VX_; break;
+                    case ParsingSpace::Y__:    bc.code=ParsingSpace::VY_; break;
+                    case ParsingSpace::Z__:    bc.code=ParsingSpace::VZ_; break;
+                    case ParsingSpace::VPAR__: bc.code=ParsingSpace::VVPAR_; break;
+                    case ParsingSpace::MU__:   bc.code=ParsingSpace::VMU_; break;
+                    default: err=ParsingSpace::ERR_PFEV_;
+                }
+            }
+            else{
+                bc.kind=ParsingSpace::BC_CONST_;
+                bc.val=atof(valStr.c_str());
+            }
+            depth++;
+        }
+        else{
+            OperatorData op=bufferQData.sQv.obOperatorData;
+            int nargs=0;
+            bc.code=op.getIdenCode();
+            if(op.getPreInPost()==ParsingSpace::PREFIX_){
+                bc.kind=ParsingSpace::BC_PREFIX_;
+                nargs=1;
+            }
+            else if(op.getPreInPost()==ParsingSpace::INFIX_){
+                bc.kind=ParsingSpace::BC_INFIX_;
+                nargs=2;
+            }
+            else if(op.getPreInPost()==ParsingSpace::POSTFIX_){
+                bc.kind=ParsingSpace::BC_POSTFIX_;
+                nargs=1;
+            }
+            if( nargs==0 || depth<nargs ){
+                err=ParsingSpace::ERR_PFEV_;
+                continue;
+            }
+            depth-=nargs-1;
+
+            //fold operators whose operands are all constants
+            const int n=m_byteCode.size();
+            if( n>=nargs && m_byteCode[n-1].kind==ParsingSpace::BC_CONST_
+                && (nargs==1 || m_byteCode[n-2].kind==ParsingSpace::BC_CONST_) ){
+                if(nargs==1){
+                    if(bc.kind==ParsingSpace::BC_PREFIX_){
+                        applyPrefix(bc.code,1,&m_byteCode[n-1].val);
+                    }
+                    else{
+                        applyPostfix(bc.code,1,&m_byteCode[n-1].val);
+                    }
+                }
+                else{
+                    applyInfix(bc.code,1,&m_byteCode[n-2].val,&m_byteCode[n-1].val);
+                    m_byteCode.pop_back();
+                }
+                continue;
+            }
+        }
+        if( err==ParsingSpace::NOERR_ ){
+            m_byteCode.push_back(bc);
+            if(depth>m_stackDepth){
+                m_stackDepth=depth;
+            }
+        }
+    }
+    if( err==ParsingSpace::NOERR_ && depth<1 ){
+        err=ParsingSpace::ERR_PFEV_;
+    }
+    if( err!=ParsingSpace::NOERR_ ){
+        m_byteCode.resize(0);
+        m_stackDepth=0;
+    }
+
+    m_pointStack.resize(m_stackDepth);
+    m_compiled=true;
+    return err;
+}
+
+void ParsingCore::evaluate(int npts, const double* const vars[ParsingSpace::NUMVARS_], double* res)
+{
+    if(!m_compiled){
+        compile();
+    }
+    std::vector<double> stk(m_stackDepth*s_batchSize);
+    for(int start=0;start<npts;start+=s_batchSize){
+        const int n=(npts-start<s_batchSize)? npts-start : s_batchSize;
+        const double* batchVars[ParsingSpace::NUMVARS_];
+        for(int v=0;v<ParsingSpace::NUMVARS_;v++){
+            batchVars[v]=(vars[v]==NULL)? NULL : vars[v]+start;
+        }
+        run(n,batchVars,res+start,stk.empty()? NULL : &stk[0],s_batchSize);
+    }
+    if(npts>0){
+        result=res[npts-1];
+    }
+}
+
+double ParsingCore::evaluatePoint()
+{
+    if(!m_compiled){
+        compile();
+    }
+    const double* vars[ParsingSpace::NUMVARS_]={NULL,NULL,NULL,NULL,NULL};
+    run(1,vars,&result,m_pointStack.empty()? NULL : &m_pointStack[0],1);
+    return result;
+}
+
+void ParsingCore::run(int npts, const double* const vars[], double* res, double* stk, int stride)
+{
+    //stk holds the operand stack, one row of stride values per level
+    if(m_byteCode.empty()){
+        for(int i=0;i<npts;i++){
+            res[i]=0.0;
+        }
+        return;
+    }
+    const double scalars[ParsingSpace::NUMVARS_]={m_x,m_y,m_z,m_vpar,m_mu};
+    double* top=stk-stride;
+    for(size_t k=0;k<m_byteCode.size();k++){
+        const byteCodeData& bc=m_byteCode[k];
+        switch(bc.kind){
+            case ParsingSpace::BC_CONST_:
+                top+=stride;
+                for(int i=0;i<npts;i++){
+                    top[i]=bc.val;
+                }
+                break;
+            case ParsingSpace::BC_VAR_:
+                top+=stride;
+                if(vars[bc.code]!=NULL){
+                    const double* src=vars[bc.code];
+                    for(int i=0;i<npts;i++){
+                        top[i]=src[i];
+                    }
+                }
+                else{
+                    for(int i=0;i<npts;i++){
+                        top[i]=scalars[bc.code];
+                    }
+                }
+                break;
+            case ParsingSpace::BC_PREFIX_:
+                applyPrefix(bc.code,npts,top);
+                break;
+            case ParsingSpace::BC_INFIX_:
+                top-=stride;
+                applyInfix(bc.code,npts,top,top+stride);
+                break;
+            case ParsingSpace::BC_POSTFIX_:
+                applyPostfix(bc.code,npts,top);
+                break;
+        }
+    }
+    for(int i=0;i<npts;i++){
+        res[i]=top[i];
+    }
+}
+
+//The apply functions below are the array versions of the calculate()
+//overloads and must be kept consistent with them.
+void ParsingCore::applyPrefix(int code, int n, double* a)
+{
+    const double toRad=(isRad)? 1.0 : 3.14159265358979323846/180.0;
+    const double fromRad=(isRad)? 1.0 : 180.0/3.14159265358979323846;
+    switch(code){
+        case ParsingSpace::SIN_:
+            for(int i=0;i<n;i++) a[i]=sin(a[i]*toRad);
+            break;
+        case ParsingSpace::COS_:
+            for(int i=0;i<n;i++) a[i]=cos(a[i]*toRad);
+            break;
+        case ParsingSpace::TAN_:
+            for(int i=0;i<n;i++) a[i]=tan(a[i]*toRad);
+            break;
+        case ParsingSpace::CSC_:
+            for(int i=0;i<n;i++) a[i]=1.0/sin(a[i]*toRad);
+            break;
+        case ParsingSpace::SEC_:
+            for(int i=0;i<n;i++) a[i]=1.0/cos(a[i]*toRad);
+            break;
+        case ParsingSpace::COT_:
+            for(int i=0;i<n;i++) a[i]=1.0/tan(a[i]*toRad);
+            break;
+        case ParsingSpace::ASIN_:
+            for(int i=0;i<n;i++) a[i]=asin(a[i])*fromRad;
+            break;
+        case ParsingSpace::ACOS_:
+            for(int i=0;i<n;i++) a[i]=acos(a[i])*fromRad;
+            break;
+        case ParsingSpace::ATAN_:
+            for(int i=0;i<n;i++) a[i]=atan(a[i])*fromRad;
+            break;
+        case ParsingSpace::ABS_:
+            for(int i=0;i<n;i++) a[i]=fabs(a[i]);
+            break;
+        case ParsingSpace::LOG_:
+            for(int i=0;i<n;i++) a[i]=log10(a[i]);
+            break;
+        case ParsingSpace::LN_:
+            for(int i=0;i<n;i++) a[i]=log(a[i]);
+            break;
+        case ParsingSpace::TENPOWER_:
+        case ParsingSpace::EP_:
+            for(int i=0;i<n;i++) a[i]=pow(10,a[i]);
+            break;
+        case ParsingSpace::EXPF_:
+            for(int i=0;i<n;i++) a[i]=exp(a[i]);
+            break;
+        case ParsingSpace::SQRT_:
+            for(int i=0;i<n;i++) a[i]=sqrt(a[i]);
+            break;
+        case ParsingSpace::SINH_:
+            for(int i=0;i<n;i++) a[i]=sinh(a[i]);
+            break;
+        case ParsingSpace::COSH_:
+            for(int i=0;i<n;i++) a[i]=cosh(a[i]);
+            break;
+        case ParsingSpace::TANH_:
+            for(int i=0;i<n;i++) a[i]=tanh(a[i]);
+            break;
+        case ParsingSpace::MINUS_:
+            for(int i=0;i<n;i++) a[i]=-a[i];
+            break;
+        default:
+            ;
+    }
+}
+
+void ParsingCore::applyInfix(int code, int n, double* a, const double* b)
+{
+    switch(code){
+        case ParsingSpace::ADD_:
+            for(int i=0;i<n;i++) a[i]=a[i]+b[i];
+            break;
+        case ParsingSpace::SUBTRACT_:
+            for(int i=0;i<n;i++) a[i]=a[i]-b[i];
+            break;
+        case ParsingSpace::MULTI_:
+        case ParsingSpace::PMHM_:
+        case ParsingSpace::PPHM_:
+            for(int i=0;i<n;i++) a[i]=a[i]*b[i];
+            break;
+        case ParsingSpace::DIVIDE_:
+            for(int i=0;i<n;i++) a[i]=a[i]/b[i];
+            break;
+        case ParsingSpace::POWER_:
+            for(int i=0;i<n;i++) a[i]=pow(a[i],b[i]);
+            break;
+        case ParsingSpace::NSQRT_:
+            for(int i=0;i<n;i++) a[i]=pow(b[i],1.0/b[i]);
+            break;
+        case ParsingSpace::EI_:
+            for(int i=0;i<n;i++) a[i]=a[i]*pow(10,b[i]);
+            break;
+        default:
+            for(int i=0;i<n;i++) a[i]=0.0;
+    }
+}
+
+void ParsingCore::applyPostfix(int code, int n, double* a)
+{
+    switch(code){
+        case ParsingSpace::INVERSE_:
+            for(int i=0;i<n;i++) a[i]=pow(a[i],-1);
+            break;
+        case ParsingSpace::SQUARE_:
+            for(int i=0;i<n;i++) a[i]=pow(a[i],2);
+            break;
+        default:
+            for(int i=0;i<n;i++) a[i]=0.0;
+    }
+}
@@ -92,6 +92,8 @@ AnnulusPhaseBC::AnnulusPhaseBC( const std::string& a_name,
    m_bdry_name[MU_UPPER] = "mu_upper";
 
    parseParameters( a_pp );
+
+   m_inflow_time_dependent = PhaseBCUtils::isTimeDependent( m_inflow_function );
 }
 
 
@@ -150,16 +152,15 @@ void AnnulusPhaseBC::apply( KineticSpecies& a_species_comp,
    const MultiBlockCoordSys& coord_sys( *(geometry.coordSysPtr()) );
 
    LevelData<FArrayBox>& BfJ( a_species_comp.distributionFunction() );
-   const DisjointBoxLayout& grids( BfJ.disjointBoxLayout() );
-   const IntVect& ghost_vect( BfJ.ghostVect() );
 
-   BoundaryBoxLayoutPtrVect all_bdry_layouts;
-   PhaseBCUtils::defineBoundaryBoxLayouts( all_bdry_layouts, grids, coord_sys, ghost_vect );
+   m_bdry_cache.define( a_species_comp, coord_sys );
+   BoundaryBoxLayoutPtrVect& all_bdry_layouts( m_bdry_cache.layouts() );
+   KineticSpeciesPtrVect& all_bdry_data( m_bdry_cache.data() );
 
-   KineticSpeciesPtrVect all_bdry_data;
-   PhaseBCUtils::defineInflowDataStorage( all_bdry_data, all_bdry_layouts, a_species_comp );
-   
-   fillInflowData( all_bdry_data, all_bdry_layouts, a_time );
+   if ( m_bdry_cache.needsFill( m_inflow_time_dependent ) ) {
+      fillInflowData( all_bdry_data, all_bdry_layouts, a_time );
+      m_bdry_cache.setFilled();
+   }
 
    if (m_radial_extrapolate) {
 
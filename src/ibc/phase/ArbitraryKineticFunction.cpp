@@ -138,23 +138,26 @@ void ArbitraryKineticFunction::setPointValues( FArrayBox&                a_dfn,
 
    a_dfn.setVal(0.0);
 
-   BoxIterator bit(a_dfn.box());
-   for (bit.begin(); bit.ok(); ++bit)
-   {
-       IntVect iv = bit();
-       RealVect loc(iv);
-       loc *= a_amrDx;
+   // Evaluate the compiled formula over the whole box at once
+   FArrayBox loc( box, PDIM );
+   BoxIterator bit( box );
+   for (bit.begin(); bit.ok(); ++bit) {
+      const IntVect iv( bit() );
+      for (int dir=0; dir<PDIM; dir++) {
+         loc(iv,dir) = iv[dir] * a_amrDx[dir];
+      }
+   }
 
+   const double* vars[ParsingSpace::NUMVARS_] = {NULL, NULL, NULL, NULL, NULL};
+   vars[ParsingSpace::VX_] = loc.dataPtr(0);
+   vars[ParsingSpace::VY_] = loc.dataPtr(1);
 #if PDIM==5
-       Real val = m_pscore->calc5d(loc[0],loc[1],loc[2],loc[3],loc[4]);
-#else
-       Real val = m_pscore->calc4d(loc[0],loc[1],loc[2],loc[3]);
+   vars[ParsingSpace::VZ_] = loc.dataPtr(2);
 #endif
-       a_dfn(iv,0) += val;
-
-   }
-
+   vars[ParsingSpace::VVPAR_] = loc.dataPtr(PDIM-2);
+   vars[ParsingSpace::VMU_] = loc.dataPtr(PDIM-1);
 
+   m_pscore->evaluate( box.numPts(), vars, a_dfn.dataPtr(0) );
 }
 
 
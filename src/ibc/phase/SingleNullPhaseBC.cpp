@@ -138,6 +138,8 @@ SingleNullPhaseBC::SingleNullPhaseBC( const std::string& a_name,
    m_bdry_name[MU_UPPER] = "mu_upper";
 
    parseParameters( a_pp );
+
+   m_inflow_time_dependent = PhaseBCUtils::isTimeDependent( m_inflow_function );
 }
 
 
@@ -196,21 +198,15 @@ void SingleNullPhaseBC::apply( KineticSpecies& a_species_comp,
       dynamic_cast<const SingleNullPhaseCoordSys&>( geometry.phaseCoordSys()) );
 
    LevelData<FArrayBox>& u( a_species_comp.distributionFunction() );
-   const DisjointBoxLayout& grids( u.disjointBoxLayout() );
-   const IntVect& ghost_vect( u.ghostVect() );
-
-   BoundaryBoxLayoutPtrVect all_bdry_layouts;
-   PhaseBCUtils::defineBoundaryBoxLayouts( all_bdry_layouts,
-                                           grids,
-                                           coord_sys,
-                                           ghost_vect );
 
-   KineticSpeciesPtrVect all_bdry_data;
-   PhaseBCUtils::defineInflowDataStorage( all_bdry_data,
-                                          all_bdry_layouts,
-                                          a_species_comp );
+   m_bdry_cache.define( a_species_comp, coord_sys );
+   BoundaryBoxLayoutPtrVect& all_bdry_layouts( m_bdry_cache.layouts() );
+   KineticSpeciesPtrVect& all_bdry_data( m_bdry_cache.data() );
 
-   fillInflowData( all_bdry_data, all_bdry_layouts, a_time );
+   if ( m_bdry_cache.needsFill( m_inflow_time_dependent ) ) {
+      fillInflowData( all_bdry_data, all_bdry_layouts, a_time );
+      m_bdry_cache.setFilled();
+   }
 
    PhaseBCUtils::setInflowOutflowBC( u,
                                      all_bdry_layouts,
@@ -3,6 +3,7 @@
 #include "BlockRegister.H"
 #include "SparseCoupling.H"
 #include "MBSolverF_F.H"
+#include "ParmParse.H"
 
 #include "NamespaceHeader.H"
 
@@ -14,8 +15,19 @@ MBHypreSolver::MBHypreSolver( const MultiBlockLevelGeom&  a_geom,
                               const int                   a_discretization_order )
    : MBSolver(a_geom, a_discretization_order),
      m_hypre_allocated(false),
-     m_A(NULL)
+     m_A(NULL),
+     m_solver_allocated(false),
+     m_solver_current(false),
+     m_precond_reuse(0),
+     m_stale_solves(0),
+     m_num_setups(0),
+     m_matvec_vdata(NULL)
 {
+   // Number of solves for which an existing AMG hierarchy is retained
+   // after the matrix has been reconstructed (0 = rebuild immediately)
+   ParmParse pp( pp_name.c_str() );
+   pp.query( "precond_reuse", m_precond_reuse );
+
    createHypreData();
 }
       
@@ -23,6 +35,7 @@ MBHypreSolver::MBHypreSolver( const MultiBlockLevelGeom&  a_geom,
 
 MBHypreSolver::~MBHypreSolver()
 {
+   destroySolver();
    destroyHypreData();
 }
 
@@ -36,77 +49,31 @@ MBHypreSolver::multiplyMatrix( const LevelData<FArrayBox>&  a_in,
       MayDay::Error( "GKPoisson::applyOperator(): Operator has not yet been initialized!" );
    }
 
-   /* Create temporary Hypre vector objects */
-
-   HYPRE_SStructVector in_vector;
-   HYPRE_SStructVector out_vector;
-
-   HYPRE_SStructVectorCreate(MPI_COMM_WORLD, m_grid, &in_vector);
-   HYPRE_SStructVectorCreate(MPI_COMM_WORLD, m_grid, &out_vector);
-
-   HYPRE_SStructVectorSetObjectType(in_vector, m_hypre_object_type);
-   HYPRE_SStructVectorSetObjectType(out_vector, m_hypre_object_type);
-
-   HYPRE_SStructVectorInitialize(in_vector);
-   HYPRE_SStructVectorInitialize(out_vector);
-
    // Copy the input LevelData to its Hypre vector
 
-   int var = 0;
-
-   const DisjointBoxLayout& grids = a_in.disjointBoxLayout();
-
-   for (DataIterator dit(grids); dit.ok(); ++dit) {
-      const Box & box = grids[dit];
-      int block_number = m_coord_sys_ptr->whichBlock(grids[dit]);
+   copyToHypreVector(a_in, m_mv_in);
+   HYPRE_SStructVectorSetConstantValues(m_mv_out, 0.);
 
-      IntVect lower(box.loVect());
-      IntVect upper(box.hiVect());
+   HYPRE_SStructVectorAssemble(m_mv_in);
+   HYPRE_SStructVectorAssemble(m_mv_out);
 
-      FArrayBox tmp(box,1);
-      tmp.copy(a_in[dit]);
+   // Do the matrix-vector multiply; the matvec setup is retained until
+   // the matrix is reconstructed
 
-      HYPRE_SStructVectorSetBoxValues(in_vector, block_number, lower.dataPtr(), upper.dataPtr(),
-                                      var, tmp.dataPtr());
+   if (m_matvec_vdata == NULL) {
+      hypre_SStructMatvecCreate( &m_matvec_vdata );
+      hypre_SStructMatvecSetup(m_matvec_vdata, m_A, m_mv_in);
    }
 
-   HYPRE_SStructVectorAssemble(in_vector);
-   HYPRE_SStructVectorAssemble(out_vector);
-
-   // Do the matrix-vector multiply
-
-   void *matvec_vdata;
-   hypre_SStructMatvecCreate( &matvec_vdata );
-
-   hypre_SStructMatvecSetup(matvec_vdata, m_A, in_vector);
-
-   hypre_SStructMatvecCompute(matvec_vdata, 1., m_A, in_vector, 1., out_vector);
-
-   hypre_SStructMatvecDestroy (matvec_vdata);
+   hypre_SStructMatvecCompute(m_matvec_vdata, 1., m_A, m_mv_in, 1., m_mv_out);
 
    if (m_hypre_object_type == HYPRE_PARCSR) {
-     HYPRE_SStructVectorGather(out_vector);
+     HYPRE_SStructVectorGather(m_mv_out);
    }
 
    // Copy the output Hypre vector to its LevelData
 
-   for (DataIterator dit(grids); dit.ok(); ++dit) {
-      const Box & box = grids[dit];
-      int block_number = m_coord_sys_ptr->whichBlock(grids[dit]);
-
-      IntVect lower(box.loVect());
-      IntVect upper(box.hiVect());
-
-      FArrayBox tmp(box,1);
-
-      HYPRE_SStructVectorGetBoxValues(out_vector, block_number,
-                                      lower.dataPtr(), upper.dataPtr(), var, tmp.dataPtr());
-
-      a_out[dit].copy(tmp);
-   }
-
-   HYPRE_SStructVectorDestroy(out_vector);
-   HYPRE_SStructVectorDestroy(in_vector);
+   copyFromHypreVector(m_mv_out, a_out);
 }
 
 
@@ -165,17 +132,30 @@ MBHypreSolver::solve( const LevelData<FArrayBox>&  a_rhs,
    HYPRE_SStructVectorAssemble(m_b);
    HYPRE_SStructVectorAssemble(m_x);
 
+   if ( m_method != "GMRES" && m_method != "AMG" ) {
+      MayDay::Error("MBHypreSolver::solve(): Unknown method, only GMRES or AMG recognized");
+   }
+
+   // Rebuild the solver (and AMG hierarchy) only if the method changed, or if
+   // the matrix was reconstructed and the outdated hierarchy has already been
+   // used for m_precond_reuse solves
+   if ( m_solver_allocated && m_solver_method != m_method ) {
+      destroySolver();
+   }
+   if ( m_solver_allocated && !m_solver_current && m_stale_solves >= m_precond_reuse ) {
+      destroySolver();
+   }
+
    if ( m_method == "GMRES" ) {
       AMG_preconditioned_GMRES( m_A, m_A, m_b, m_method_tol, m_method_max_iter,
                                 m_precond_tol, m_precond_max_iter, m_method_verbose, m_x );
    }
-   else if ( m_method == "AMG" ) {
-      AMG( m_A, m_b, m_method_tol, m_method_max_iter, m_method_verbose, m_x );
-   }
    else {
-      MayDay::Error("MBHypreSolver::solve(): Unknown method, only GMRES or AMG recognized");
+      AMG( m_A, m_b, m_method_tol, m_method_max_iter, m_method_verbose, m_x );
    }
 
+   if ( !m_solver_current ) m_stale_solves++;
+
    copyFromHypreVector(m_x, a_solution);
 
    a_solution.exchange();
@@ -206,6 +186,13 @@ MBHypreSolver::constructMatrixGeneral( LevelData<FArrayBox>&  a_alpha_coefficien
    constructHypreMatrix(a_alpha_coefficient, a_tensor_coefficient, a_beta_coefficient, a_bc,
                         m_A_graph, m_A_stencil_values, m_A_diagonal_offset, m_A_unstructured_coupling,
                         fourth_order, m_A, m_rhs_from_bc);
+
+   // The AMG hierarchy and matvec setup refer to the old coefficients
+   m_solver_current = false;
+   if (m_matvec_vdata) {
+      hypre_SStructMatvecDestroy(m_matvec_vdata);
+      m_matvec_vdata = NULL;
+   }
 }
 
 
@@ -366,6 +353,16 @@ MBHypreSolver::createHypreData()
 
       HYPRE_SStructVectorInitialize(m_b);
       HYPRE_SStructVectorInitialize(m_x);
+
+      /* Work vectors for multiplyMatrix() */
+      HYPRE_SStructVectorCreate(MPI_COMM_WORLD, m_grid, &m_mv_in);
+      HYPRE_SStructVectorCreate(MPI_COMM_WORLD, m_grid, &m_mv_out);
+
+      HYPRE_SStructVectorSetObjectType(m_mv_in, m_hypre_object_type);
+      HYPRE_SStructVectorSetObjectType(m_mv_out, m_hypre_object_type);
+
+      HYPRE_SStructVectorInitialize(m_mv_in);
+      HYPRE_SStructVectorInitialize(m_mv_out);
    }
 
    m_hypre_allocated = true;
@@ -377,10 +374,16 @@ void
 MBHypreSolver::destroyHypreData()
 {
    if (m_hypre_allocated) {
+      if (m_matvec_vdata) {
+         hypre_SStructMatvecDestroy(m_matvec_vdata);
+         m_matvec_vdata = NULL;
+      }
       if (m_A) {
          HYPRE_SStructMatrixDestroy(m_A);
          m_A = NULL;
       }
+      HYPRE_SStructVectorDestroy(m_mv_out);
+      HYPRE_SStructVectorDestroy(m_mv_in);
       HYPRE_SStructVectorDestroy(m_x);
       HYPRE_SStructVectorDestroy(m_b);
       HYPRE_SStructGraphDestroy(m_A_graph);
@@ -954,7 +957,6 @@ MBHypreSolver::AMG( const HYPRE_SStructMatrix&  a_matrix,
                     const bool                  a_verbose,
                     const HYPRE_SStructVector&  a_x ) const
 {
-   HYPRE_Solver          par_solver;
    HYPRE_ParCSRMatrix    par_A;
    HYPRE_ParVector       par_b;
    HYPRE_ParVector       par_x;
@@ -963,35 +965,40 @@ MBHypreSolver::AMG( const HYPRE_SStructMatrix&  a_matrix,
    HYPRE_SStructVectorGetObject(a_b, (void **) &par_b);
    HYPRE_SStructVectorGetObject(a_x, (void **) &par_x);
 
-   HYPRE_BoomerAMGCreate(&par_solver);
-   HYPRE_BoomerAMGSetTol(par_solver, a_tol);
-   HYPRE_BoomerAMGSetMaxIter(par_solver, a_max_iter);
-   HYPRE_BoomerAMGSetPrintLevel(par_solver, 0);
-
-   // Algorithm options
-   HYPRE_BoomerAMGSetStrongThreshold(par_solver, 0.25);
-   HYPRE_BoomerAMGSetCoarsenType(par_solver, 6);  // Falgout coarsening
-   //   HYPRE_BoomerAMGSetRelaxType(par_solver, 3);  // hybrid Gauss-Seidel
-   //   HYPRE_BoomerAMGSetCycleRelaxType(par_solver, 3, 3);  // hybrid Gauss-Seidel on coarsest level
-   //   HYPRE_BoomerAMGSetCycleRelaxType(par_solver, 9, 3);  // Gaussian elimination on coarsest level
-   //   HYPRE_BoomerAMGSetCycleType(par_solver, 1);  // V = 1, W = 2
-   //   HYPRE_BoomerAMGSetCycleNumSweeps(par_solver, 1, 1);  // 1 sweep on down cycle
-   //   HYPRE_BoomerAMGSetCycleNumSweeps(par_solver, 1, 2);  // 1 sweep on up cycle
-   //   HYPRE_BoomerAMGSetCycleNumSweeps(par_solver, 1, 3);  // 1 sweeps on coarsest level
-
-   HYPRE_BoomerAMGSetup(par_solver, par_A, par_b, par_x);
-   HYPRE_BoomerAMGSolve(par_solver, par_A, par_b, par_x);
+   if ( !m_solver_allocated ) {
+      HYPRE_BoomerAMGCreate(&m_par_solver);
+      HYPRE_BoomerAMGSetPrintLevel(m_par_solver, 0);
+
+      // Algorithm options
+      HYPRE_BoomerAMGSetStrongThreshold(m_par_solver, 0.25);
+      HYPRE_BoomerAMGSetCoarsenType(m_par_solver, 6);  // Falgout coarsening
+      //   HYPRE_BoomerAMGSetRelaxType(m_par_solver, 3);  // hybrid Gauss-Seidel
+      //   HYPRE_BoomerAMGSetCycleRelaxType(m_par_solver, 3, 3);  // hybrid Gauss-Seidel on coarsest level
+      //   HYPRE_BoomerAMGSetCycleRelaxType(m_par_solver, 9, 3);  // Gaussian elimination on coarsest level
+      //   HYPRE_BoomerAMGSetCycleType(m_par_solver, 1);  // V = 1, W = 2
+      //   HYPRE_BoomerAMGSetCycleNumSweeps(m_par_solver, 1, 1);  // 1 sweep on down cycle
+      //   HYPRE_BoomerAMGSetCycleNumSweeps(m_par_solver, 1, 2);  // 1 sweep on up cycle
+      //   HYPRE_BoomerAMGSetCycleNumSweeps(m_par_solver, 1, 3);  // 1 sweeps on coarsest level
+
+      HYPRE_BoomerAMGSetup(m_par_solver, par_A, par_b, par_x);
+
+      solverCreated("AMG", a_verbose);
+   }
+
+   // Convergence parameters may change between solves without a new setup
+   HYPRE_BoomerAMGSetTol(m_par_solver, a_tol);
+   HYPRE_BoomerAMGSetMaxIter(m_par_solver, a_max_iter);
+
+   HYPRE_BoomerAMGSolve(m_par_solver, par_A, par_b, par_x);
 
    int num_iterations;
-   HYPRE_BoomerAMGGetNumIterations(par_solver, &num_iterations);
+   HYPRE_BoomerAMGGetNumIterations(m_par_solver, &num_iterations);
    double final_res_norm;
-   HYPRE_BoomerAMGGetFinalRelativeResidualNorm(par_solver, &final_res_norm);
+   HYPRE_BoomerAMGGetFinalRelativeResidualNorm(m_par_solver, &final_res_norm);
    if (a_verbose && procID()==0) {
       cout << "      AMG solver residual = " << final_res_norm << " after " << num_iterations << " iterations" << endl;
    }
 
-   HYPRE_BoomerAMGDestroy(par_solver);
-
    if (m_hypre_object_type == HYPRE_PARCSR) {
       HYPRE_SStructVectorGather(a_x);
    }
@@ -1010,8 +1017,6 @@ MBHypreSolver::AMG_preconditioned_GMRES( const HYPRE_SStructMatrix&  a_matrix,
                                          const bool                  a_verbose,
                                          const HYPRE_SStructVector&  a_x ) const
 {
-   HYPRE_Solver          par_solver;
-   HYPRE_Solver          par_precond;
    HYPRE_ParCSRMatrix    par_A;
    HYPRE_ParCSRMatrix    par_P;
    HYPRE_ParVector       par_b;
@@ -1022,39 +1027,45 @@ MBHypreSolver::AMG_preconditioned_GMRES( const HYPRE_SStructMatrix&  a_matrix,
    HYPRE_SStructVectorGetObject(a_b, (void **) &par_b);
    HYPRE_SStructVectorGetObject(a_x, (void **) &par_x);
 
-   HYPRE_ParCSRGMRESCreate(MPI_COMM_WORLD, &par_solver);
+   if ( !m_solver_allocated ) {
+      HYPRE_ParCSRGMRESCreate(MPI_COMM_WORLD, &m_par_solver);
+      HYPRE_GMRESSetPrintLevel(m_par_solver, 2);
+      HYPRE_GMRESSetLogging(m_par_solver, 1);
 
-   /* set the GMRES paramaters */
-   HYPRE_GMRESSetMaxIter(par_solver, a_max_iter);
-   HYPRE_GMRESSetTol(par_solver, a_tol);
-   HYPRE_GMRESSetPrintLevel(par_solver, 2);
-   HYPRE_GMRESSetLogging(par_solver, 1);
+      /* use BoomerAMG as preconditioner */
+      HYPRE_BoomerAMGCreate(&m_par_precond);
+      HYPRE_BoomerAMGSetCoarsenType(m_par_precond, 6);
+      HYPRE_BoomerAMGSetStrongThreshold(m_par_precond, 0.25);
+      HYPRE_BoomerAMGSetPrintLevel(m_par_precond, 0);
+      HYPRE_BoomerAMGSetPrintFileName(m_par_precond, "ex9.out.log");
 
-   /* use BoomerAMG as preconditioner */
-   HYPRE_BoomerAMGCreate(&par_precond);
-   HYPRE_BoomerAMGSetCoarsenType(par_precond, 6);
-   HYPRE_BoomerAMGSetStrongThreshold(par_precond, 0.25);
-   HYPRE_BoomerAMGSetTol(par_precond, a_amg_tol);
-   HYPRE_BoomerAMGSetPrintLevel(par_precond, 0);
-   HYPRE_BoomerAMGSetPrintFileName(par_precond, "ex9.out.log");
-   HYPRE_BoomerAMGSetMaxIter(par_precond, a_amg_max_iter);
+      /* set the preconditioner */
+      HYPRE_ParCSRGMRESSetPrecond(m_par_solver,
+                                  HYPRE_BoomerAMGSolve,
+                                  HYPRE_BoomerAMGSetup,
+                                  m_par_precond);
 
-   /* set the preconditioner */
-   HYPRE_ParCSRGMRESSetPrecond(par_solver,
-                               HYPRE_BoomerAMGSolve,
-                               HYPRE_BoomerAMGSetup,
-                               par_precond);
+      /* the AMG hierarchy is built here and retained across solves */
+      HYPRE_GMRESSetup(m_par_solver, (HYPRE_Matrix)par_P, (HYPRE_Vector)par_b, (HYPRE_Vector)par_x);
+
+      solverCreated("GMRES", a_verbose);
+   }
 
-   HYPRE_GMRESSetup(par_solver, (HYPRE_Matrix)par_P, (HYPRE_Vector)par_b, (HYPRE_Vector)par_x);
-   HYPRE_GMRESSolve(par_solver, (HYPRE_Matrix)par_A, (HYPRE_Vector)par_b, (HYPRE_Vector)par_x);
+   /* set the GMRES and preconditioner convergence parameters */
+   HYPRE_GMRESSetMaxIter(m_par_solver, a_max_iter);
+   HYPRE_GMRESSetTol(m_par_solver, a_tol);
+   HYPRE_BoomerAMGSetTol(m_par_precond, a_amg_tol);
+   HYPRE_BoomerAMGSetMaxIter(m_par_precond, a_amg_max_iter);
+
+   HYPRE_GMRESSolve(m_par_solver, (HYPRE_Matrix)par_A, (HYPRE_Vector)par_b, (HYPRE_Vector)par_x);
 
    // Get number of preconditioner iterations used
    int num_final_iterations;
-   HYPRE_GMRESGetNumIterations(par_solver, &num_final_iterations);
+   HYPRE_GMRESGetNumIterations(m_par_solver, &num_final_iterations);
 
    // Get final preconditioner residual norm
    double final_norm2;
-   HYPRE_GMRESGetFinalRelativeResidualNorm(par_solver, &final_norm2);
+   HYPRE_GMRESGetFinalRelativeResidualNorm(m_par_solver, &final_norm2);
 
    if (a_verbose && procID()==0) {
       cout << "      GMRES residual = " << final_norm2 << " after " << num_final_iterations << " iterations" << endl;
@@ -1067,6 +1078,40 @@ MBHypreSolver::AMG_preconditioned_GMRES( const HYPRE_SStructMatrix&  a_matrix,
 
 
 
+void
+MBHypreSolver::solverCreated( const string&  a_method,
+                              const bool     a_verbose ) const
+{
+   m_solver_method = a_method;
+   m_solver_allocated = true;
+   m_solver_current = true;
+   m_stale_solves = 0;
+   m_num_setups++;
+
+   if (a_verbose && procID()==0) {
+      cout << "      Hypre " << a_method << " setup #" << m_num_setups << endl;
+   }
+}
+
+
+
+void
+MBHypreSolver::destroySolver() const
+{
+   if (m_solver_allocated) {
+      if (m_solver_method == "GMRES") {
+         HYPRE_ParCSRGMRESDestroy(m_par_solver);
+         HYPRE_BoomerAMGDestroy(m_par_precond);
+      }
+      else {
+         HYPRE_BoomerAMGDestroy(m_par_solver);
+      }
+      m_solver_allocated = false;
+   }
+}
+
+
+
 void
 MBHypreSolver::copyToHypreVector( const LevelData<FArrayBox>&  a_in,
                                   HYPRE_SStructVector&         a_out ) const
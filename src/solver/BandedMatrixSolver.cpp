@@ -0,0 +1,96 @@
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "BandedMatrixSolver.H"
+
+#include "NamespaceHeader.H"
+
+void BandedMatrixSolver::factor(const BandedMatrix& a_P, Real a_diag)
+{
+  m_nrow = a_P.getNRows();
+  int istart = a_P.getRowStart();
+
+  /* extract the local block in CSR form, sorted by column */
+  m_rowptr.assign(m_nrow+1,0);
+  m_diag.assign(m_nrow,-1);
+  m_cols.clear();
+  m_vals.clear();
+
+  std::vector< std::pair<int,Real> > row;
+  for (int i=0; i<m_nrow; i++) {
+    row.clear();
+    const int  *icols = a_P.getCols(i);
+    const Real *data  = a_P.getRowData(i);
+    for (int j=0; j<a_P.getNCols(i); j++) {
+      int col = icols[j] - istart;
+      if ((col >= 0) && (col < m_nrow)) row.push_back(std::make_pair(col,data[j]));
+    }
+    std::sort(row.begin(),row.end());
+
+    m_rowptr[i] = m_cols.size();
+    for (int j=0; j<row.size(); j++) {
+      if ((m_cols.size() > m_rowptr[i]) && (m_cols.back() == row[j].first)) {
+        m_vals.back() += row[j].second;
+      } else {
+        if (row[j].first == i) m_diag[i] = m_cols.size();
+        m_cols.push_back(row[j].first);
+        m_vals.push_back(row[j].second);
+      }
+    }
+    if (m_diag[i] < 0) {
+      /* insert a diagonal entry to keep the factorization well defined */
+      int p = m_rowptr[i];
+      while ((p < m_cols.size()) && (m_cols[p] < i)) p++;
+      m_cols.insert(m_cols.begin()+p,i);
+      m_vals.insert(m_vals.begin()+p,a_diag);
+      m_diag[i] = p;
+    }
+  }
+  m_rowptr[m_nrow] = m_cols.size();
+
+  /* ILU(0), row by row (IKJ ordering) */
+  std::vector<int> pos(m_nrow,-1);
+  for (int i=0; i<m_nrow; i++) {
+    for (int p=m_rowptr[i]; p<m_rowptr[i+1]; p++) pos[m_cols[p]] = p;
+
+    for (int p=m_rowptr[i]; p<m_diag[i]; p++) {
+      int k = m_cols[p];
+      m_vals[p] /= m_vals[m_diag[k]];
+      for (int q=m_diag[k]+1; q<m_rowptr[k+1]; q++) {
+        int j = pos[m_cols[q]];
+        if (j >= 0) m_vals[j] -= m_vals[p] * m_vals[q];
+      }
+    }
+    if (std::fabs(m_vals[m_diag[i]]) < 1e-14*std::fabs(a_diag)) {
+      m_vals[m_diag[i]] = (a_diag != 0.0 ? a_diag : 1.0);
+    }
+
+    for (int p=m_rowptr[i]; p<m_rowptr[i+1]; p++) pos[m_cols[p]] = -1;
+  }
+
+  m_is_Factored = true;
+  m_count++;
+  return;
+}
+
+void BandedMatrixSolver::solve(Real* a_x, const Real* a_b) const
+{
+  CH_assert(m_is_Factored);
+
+  /* forward substitution with the unit lower factor */
+  for (int i=0; i<m_nrow; i++) {
+    Real sum = a_b[i];
+    for (int p=m_rowptr[i]; p<m_diag[i]; p++) sum -= m_vals[p] * a_x[m_cols[p]];
+    a_x[i] = sum;
+  }
+
+  /* backward substitution with the upper factor */
+  for (int i=m_nrow-1; i>=0; i--) {
+    Real sum = a_x[i];
+    for (int p=m_diag[i]+1; p<m_rowptr[i+1]; p++) sum -= m_vals[p] * a_x[m_cols[p]];
+    a_x[i] = sum / m_vals[m_diag[i]];
+  }
+  return;
+}
+
+#include "NamespaceFooter.H"
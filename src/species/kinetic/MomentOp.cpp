@@ -19,6 +19,9 @@
 #include "DisjointBoxLayout.H"
 #include "ProblemDomain.H"
 #include "MayDay.H"
+#include "CH_Timer.H"
+#include "GKProfiler.H"
+#include "LayoutMatch.H"
 
 #include "KineticSpecies.H"
 #include "PhaseBlockCoordSys.H"
@@ -46,9 +49,16 @@ void MomentOp::computeIntegrand( LevelData<FArrayBox>& a_integrand,
    int kernel_ncomp = a_kernel.nComponents();
    a_integrand.define( dfn.getBoxes(), dfn_ncomp*kernel_ncomp, dfn.ghostVect());
 
+   if ( !( (dfn_ncomp > 1 && kernel_ncomp == 1) || (dfn_ncomp == 1 && kernel_ncomp >= 1) ) ) {
+      const std::string msg( "MomentOp: Not implemented for this combination of dfn_comp and kernel_comp. ");
+      MayDay::Error( msg.c_str() );
+   }
+
    // Initialize the integrand with the distribution function.
-   DataIterator dit = a_integrand.dataIterator();
-   for (dit.begin(); dit.ok(); ++dit) {
+   DataIterator boxes = a_integrand.dataIterator();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
      if (dfn_ncomp > 1 && kernel_ncomp == 1) {
        for (int dfn_comp=0; dfn_comp<dfn_ncomp; ++dfn_comp) {
          a_integrand[dit].copy(dfn[dit],dfn_comp,dfn_comp*kernel_ncomp,kernel_ncomp);
@@ -59,10 +69,6 @@ void MomentOp::computeIntegrand( LevelData<FArrayBox>& a_integrand,
 	  a_integrand[dit].copy(dfn[dit],0,comp,1);
        }
      }
-     else {
-       const std::string msg( "MomentOp: Not implemented for this combination of dfn_comp and kernel_comp. ");
-       MayDay::Error( msg.c_str() );
-     }
    }
 
    a_kernel.eval( a_integrand, a_kinetic_species );
@@ -79,9 +85,16 @@ void MomentOp::computeIntegrand( LevelData<FArrayBox>& a_integrand,
    int kernel_ncomp = a_kernel.nComponents();
    a_integrand.define( a_function.getBoxes(), func_ncomp*kernel_ncomp, a_function.ghostVect());
 
+   if ( !( (func_ncomp > 1 && kernel_ncomp == 1) || (func_ncomp == 1 && kernel_ncomp >= 1) ) ) {
+      const std::string msg( "MomentOp: Not implemented for this combination of func_comp and kernel_comp. ");
+      MayDay::Error( msg.c_str() );
+   }
+
    // Initialize the integrand with the distribution function.                                                                               
-   DataIterator dit = a_integrand.dataIterator();
-   for (dit.begin(); dit.ok(); ++dit) {
+   DataIterator boxes = a_integrand.dataIterator();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
      if (func_ncomp > 1 && kernel_ncomp == 1) {
        for (int ncomp=0; ncomp<func_ncomp; ++ncomp) {
 	 a_integrand[dit].copy(a_function[dit],ncomp,ncomp*kernel_ncomp,kernel_ncomp);
@@ -92,15 +105,122 @@ void MomentOp::computeIntegrand( LevelData<FArrayBox>& a_integrand,
 	 a_integrand[dit].copy(a_function[dit],0,comp,1);
        }
      }
-     else {
-       const std::string msg( "MomentOp: Not implemented for this combination of func_comp and kernel_comp. ");
-       MayDay::Error( msg.c_str() );
-     }
    }
 
    a_kernel.eval( a_integrand, a_kinetic_species );
 }
 
+// Maximum number of cached reduction plans of each kind
+static const int s_max_plans = 8;
+
+// Copies a_src onto a_grids, which must have the same boxes and processor
+// assignment, so that copiers cached for a_grids can be applied
+inline
+void copyToLayout( LevelData<FArrayBox>&       a_dst,
+                   const LevelData<FArrayBox>& a_src,
+                   const DisjointBoxLayout&    a_grids )
+{
+   a_dst.define(a_grids, a_src.nComp(), a_src.ghostVect());
+
+   DataIterator sdit = a_src.dataIterator();
+   DataIterator ddit = a_dst.dataIterator();
+   for (sdit.begin(),ddit.begin(); sdit.ok()&&ddit.ok(); ++sdit,++ddit) {
+      a_dst[ddit].copy(a_src[sdit]);
+   }
+}
+
+
+inline
+void copyToLayout( CP1::LevelData<CP1::FArrayBox>&       a_dst,
+                   const CP1::LevelData<CP1::FArrayBox>& a_src,
+                   const CP1::DisjointBoxLayout&         a_grids )
+{
+   a_dst.define(a_grids, a_src.nComp(), a_src.ghostVect());
+
+   CP1::DataIterator sdit = a_src.dataIterator();
+   CP1::DataIterator ddit = a_dst.dataIterator();
+   for (sdit.begin(),ddit.begin(); sdit.ok()&&ddit.ok(); ++sdit,++ddit) {
+      a_dst[ddit].copy(a_src[sdit]);
+   }
+}
+
+
+const MomentOp::MuReductionPlan&
+MomentOp::muReductionPlan( const DisjointBoxLayout& a_grids,
+                           const IntVect&           a_ghosts,
+                           const ProblemDomain&     a_domain ) const
+{
+   for (int n=0; n<m_mu_plans.size(); ++n) {
+      const MuReductionPlan& plan = m_mu_plans[n];
+      if ( plan.ghosts == a_ghosts && sameDecomposition( plan.grids, a_grids ) ) {
+         return plan;
+      }
+   }
+
+   // Layouts that keep changing must not grow the cache without bound
+   if ( m_mu_plans.size() >= s_max_plans ) {
+      m_mu_plans.resize(0);
+   }
+
+   CH_TIME("MomentOp::muReductionPlan::define_copier");
+
+   MuReductionPlan plan;
+   plan.grids = a_grids;
+   plan.ghosts = a_ghosts;
+   adjCellLo(plan.degenerate_grids, a_grids, MU_DIR, -1);
+
+   IntVect degenerate_ghosts(a_ghosts);
+   degenerate_ghosts[MU_DIR] = 0;
+
+   plan.copier = RefCountedPtr<Copier>( new ReductionCopier( a_grids,
+                                                             plan.degenerate_grids,
+                                                             a_domain,
+                                                             degenerate_ghosts,
+                                                             MU_DIR ) );
+   m_mu_plans.push_back(plan);
+
+   return m_mu_plans[m_mu_plans.size()-1];
+}
+
+
+const MomentOp::VpReductionPlan&
+MomentOp::vpReductionPlan( const CP1::DisjointBoxLayout& a_grids,
+                           const CP1::IntVect&           a_ghosts,
+                           const CP1::ProblemDomain&     a_domain ) const
+{
+   for (int n=0; n<m_vp_plans.size(); ++n) {
+      const VpReductionPlan& plan = m_vp_plans[n];
+      if ( plan.ghosts == a_ghosts && sameDecomposition( plan.grids, a_grids ) ) {
+         return plan;
+      }
+   }
+
+   // Layouts that keep changing must not grow the cache without bound
+   if ( m_vp_plans.size() >= s_max_plans ) {
+      m_vp_plans.resize(0);
+   }
+
+   CH_TIME("MomentOp::vpReductionPlan::define_copier");
+
+   VpReductionPlan plan;
+   plan.grids = a_grids;
+   plan.ghosts = a_ghosts;
+   adjCellLo(plan.degenerate_grids, a_grids, VPARALLEL_DIR, -1);
+
+   CP1::IntVect degenerate_ghosts(a_ghosts);
+   degenerate_ghosts[VPARALLEL_DIR] = 0;
+
+   plan.copier = RefCountedPtr<CP1::Copier>( new CP1::ReductionCopier( a_grids,
+                                                                       plan.degenerate_grids,
+                                                                       a_domain,
+                                                                       degenerate_ghosts,
+                                                                       VPARALLEL_DIR ) );
+   m_vp_plans.push_back(plan);
+
+   return m_vp_plans[m_vp_plans.size()-1];
+}
+
+
 inline
 void MomentOp::partialIntegralMu( CP1::LevelData<CP1::FArrayBox>& a_result,
                                   const LevelData<FArrayBox>&     a_integrand,
@@ -111,33 +231,43 @@ void MomentOp::partialIntegralMu( CP1::LevelData<CP1::FArrayBox>& a_result,
       MayDay::Error("MomentOp::partialIntegralMu(): a_result is already defined");
    }
 
-   DisjointBoxLayout degenerate_grids;
-   adjCellLo(degenerate_grids, a_integrand.getBoxes(), MU_DIR, -1);
+   const MuReductionPlan& plan = muReductionPlan( a_integrand.getBoxes(),
+                                                  a_integrand.ghostVect(),
+                                                  a_domain );
 
    IntVect degenerate_ghosts(a_integrand.ghostVect());
    degenerate_ghosts[MU_DIR] = 0;
 
-   LevelData<FArrayBox> degenerate_integrand(degenerate_grids, a_integrand.nComp(), degenerate_ghosts);
+   LevelData<FArrayBox> degenerate_integrand(plan.degenerate_grids, a_integrand.nComp(), degenerate_ghosts);
 
    // The SumOp below should initialize the destination, but doesn't
-   DataIterator dit = degenerate_integrand.dataIterator();
-   for (dit.begin(); dit.ok(); ++dit) {
+   DataIterator boxes = degenerate_integrand.dataIterator();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       degenerate_integrand[dit].setVal(0.);
    }
 
-   // sum reduce onto thin LevelData
-   const ReductionCopier reduceCopier( a_integrand.getBoxes(),
-                                       degenerate_integrand.getBoxes(),
-                                       a_domain,
-				       degenerate_ghosts,
-                                       MU_DIR );
+   // The cached copier is bound to the plan's layout.  The integrand is
+   // normally on the layout of the distribution function, for which the
+   // plan was built, so the full integrand is only copied when it is not
+   LevelData<FArrayBox> integrand_copy;
+   if ( !(plan.grids == a_integrand.getBoxes()) ) {
+      copyToLayout( integrand_copy, a_integrand, plan.grids );
+   }
+   const LevelData<FArrayBox>& integrand = integrand_copy.isDefined()? integrand_copy: a_integrand;
 
+   // sum reduce onto thin LevelData
+   CH_TIME("MomentOp::partialIntegralMu::reduce");
    const SumOp op_mu( MU_DIR );
-   a_integrand.copyTo( a_integrand.interval(),
-                       degenerate_integrand,
-                       degenerate_integrand.interval(),
-                       reduceCopier,
-                       op_mu );
+   {
+      GK_PROFILE_WAIT();
+      integrand.copyTo( integrand.interval(),
+                        degenerate_integrand,
+                        degenerate_integrand.interval(),
+                        *plan.copier,
+                        op_mu );
+   }
 
    sliceLevelDataLocalOnly( a_result, degenerate_integrand, a_slice_mu );
 }
@@ -153,13 +283,14 @@ void MomentOp::partialIntegralVp( CFG::LevelData<CFG::FArrayBox>&       a_result
       MayDay::Error("MomentOp::partialIntegralVp(): a_result is already defined");
    }
 
-   CP1::DisjointBoxLayout degenerate_grids;
-   adjCellLo(degenerate_grids, a_integrand.getBoxes(), VPARALLEL_DIR, -1);
+   const VpReductionPlan& plan = vpReductionPlan( a_integrand.getBoxes(),
+                                                  a_integrand.ghostVect(),
+                                                  a_domain );
 
    CP1::IntVect degenerate_ghosts(a_integrand.ghostVect());
    degenerate_ghosts[VPARALLEL_DIR] = 0;
 
-   CP1::LevelData<CP1::FArrayBox> degenerate_integrand(degenerate_grids, a_integrand.nComp(), degenerate_ghosts);
+   CP1::LevelData<CP1::FArrayBox> degenerate_integrand(plan.degenerate_grids, a_integrand.nComp(), degenerate_ghosts);
 
    // The SumOp below should initialize the destination, but doesn't
    CP1::DataIterator dit = degenerate_integrand.dataIterator();
@@ -167,17 +298,24 @@ void MomentOp::partialIntegralVp( CFG::LevelData<CFG::FArrayBox>&       a_result
       degenerate_integrand[dit].setVal(0.);
    }
 
-   const CP1::ReductionCopier reduceCopier( a_integrand.getBoxes(),
-                                            degenerate_integrand.getBoxes(),
-                                            a_domain,
-					    degenerate_ghosts,
-                                            VPARALLEL_DIR );
+   // The integrand arrives on a freshly sliced layout, so move it onto the
+   // layout the cached copier is bound to (this is mu-reduced data only)
+   CP1::LevelData<CP1::FArrayBox> integrand_copy;
+   if ( !(plan.grids == a_integrand.getBoxes()) ) {
+      copyToLayout( integrand_copy, a_integrand, plan.grids );
+   }
+   const CP1::LevelData<CP1::FArrayBox>& integrand = integrand_copy.isDefined()? integrand_copy: a_integrand;
+
+   CH_TIME("MomentOp::partialIntegralVp::reduce");
    const CP1::SumOp op_vp( VPARALLEL_DIR );
-   a_integrand.copyTo( a_integrand.interval(),
-                       degenerate_integrand,
-                       degenerate_integrand.interval(),
-                       reduceCopier,
-                       op_vp );
+   {
+      GK_PROFILE_WAIT();
+      integrand.copyTo( integrand.interval(),
+                        degenerate_integrand,
+                        degenerate_integrand.interval(),
+                        *plan.copier,
+                        op_vp );
+   }
 
    sliceLevelDataLocalOnly( a_result, degenerate_integrand, a_slice_vp );
 }
@@ -206,28 +344,39 @@ void scaleResult( CFG::LevelData<CFG::FArrayBox>& a_result,
 
 
 
+void MomentOp::integrateVelocity( CFG::LevelData<CFG::FArrayBox>& a_moment,
+                                  const LevelData<FArrayBox>&     a_integrand,
+                                  const PhaseGeom&                a_geometry ) const
+{
+   const ProblemDomain& domain = a_geometry.domain();
+
+   SliceSpec slice_mu(MU_DIR, domain.domainBox().smallEnd(MU_DIR));
+   CP1::SliceSpec slice_vp(VPARALLEL_DIR, domain.domainBox().smallEnd(VPARALLEL_DIR));
+
+   CP1::LevelData<CP1::FArrayBox> partial_integrand;
+   partialIntegralMu( partial_integrand, a_integrand, domain, slice_mu );
+
+   CP1::ProblemDomain partial_domain( sliceDomain( domain, slice_mu ) );
+
+   partialIntegralVp( a_moment, partial_integrand, partial_domain, slice_vp );
+}
+
+
+
 void MomentOp::compute( CFG::LevelData<CFG::FArrayBox>& a_result,
                         const KineticSpecies&           a_kinetic_species,
                         const Kernel&                   a_kernel ) const
 {
+   GK_PROFILE(MOMENTS);
    CH_assert(a_result.nComp()==a_kernel.nComponents()*a_kinetic_species.distributionFunction().nComp());
    LevelData<FArrayBox> integrand;
    computeIntegrand( integrand, a_kinetic_species, a_kernel );
 
    const PhaseGeom& geometry = a_kinetic_species.phaseSpaceGeometry();
    const VEL::VelCoordSys& vel_coords = geometry.velSpaceCoordSys();
-   const ProblemDomain& domain = geometry.domain();
-
-   SliceSpec slice_mu(MU_DIR, domain.domainBox().smallEnd(MU_DIR));
-   CP1::SliceSpec slice_vp(VPARALLEL_DIR, domain.domainBox().smallEnd(VPARALLEL_DIR));
-
-   CP1::LevelData<CP1::FArrayBox> partial_integrand;
-   partialIntegralMu( partial_integrand, integrand, domain, slice_mu );
-
-   CP1::ProblemDomain partial_domain( sliceDomain( domain, slice_mu ) );
 
    CFG::LevelData<CFG::FArrayBox> moment;
-   partialIntegralVp( moment, partial_integrand, partial_domain, slice_vp );
+   integrateVelocity( moment, integrand, geometry );
 
    const Real scale = a_kernel.scale( a_kinetic_species );
    const Real area = velocitySpaceArea( vel_coords );
@@ -257,24 +406,16 @@ void MomentOp::compute( CFG::LevelData<CFG::FArrayBox>& a_result,
                         const LevelData<FArrayBox>& a_function,
                         const Kernel& a_kernel ) const
 {
+   GK_PROFILE(MOMENTS);
    CH_assert(a_result.nComp()==a_kernel.nComponents()*a_function.nComp());
    LevelData<FArrayBox> integrand;
    computeIntegrand( integrand, a_kinetic_species, a_function, a_kernel );
 
    const PhaseGeom& geometry = a_kinetic_species.phaseSpaceGeometry();
    const VEL::VelCoordSys& vel_coords = geometry.velSpaceCoordSys();
-   const ProblemDomain& domain = geometry.domain();
-
-   SliceSpec slice_mu(MU_DIR, domain.domainBox().smallEnd(MU_DIR));
-   CP1::SliceSpec slice_vp(VPARALLEL_DIR, domain.domainBox().smallEnd(VPARALLEL_DIR));
-
-   CP1::LevelData<CP1::FArrayBox> partial_integrand;
-   partialIntegralMu( partial_integrand, integrand, domain, slice_mu );
-
-   CP1::ProblemDomain partial_domain( sliceDomain( domain, slice_mu ) );
 
    CFG::LevelData<CFG::FArrayBox> moment;
-   partialIntegralVp( moment, partial_integrand, partial_domain, slice_vp );
+   integrateVelocity( moment, integrand, geometry );
 
    const Real scale = a_kernel.scale( a_kinetic_species );
    const Real area = velocitySpaceArea( vel_coords );
@@ -298,4 +439,87 @@ void MomentOp::compute( CFG::LevelData<CFG::FArrayBox>& a_result,
    moment.copyTo(a_result, copier);
 }
 
+
+void MomentOp::computeMany( Vector<CFG::LevelData<CFG::FArrayBox>*>& a_results,
+                            const KineticSpecies&                    a_kinetic_species,
+                            const LevelData<FArrayBox>&              a_function,
+                            const Vector<const Kernel*>&             a_kernels ) const
+{
+   GK_PROFILE(MOMENTS);
+   CH_assert(a_results.size()==a_kernels.size());
+   if (a_function.nComp() != 1) {
+      MayDay::Error( "MomentOp::computeMany(): only single-component functions are supported" );
+   }
+
+   // Stack all kernel integrands into one LevelData
+   int total_ncomp = 0;
+   for (int k=0; k<a_kernels.size(); ++k) {
+      CH_assert(a_results[k]->nComp()==a_kernels[k]->nComponents());
+      total_ncomp += a_kernels[k]->nComponents();
+   }
+
+   LevelData<FArrayBox> integrand( a_function.getBoxes(), total_ncomp, a_function.ghostVect() );
+   DataIterator boxes = integrand.dataIterator();
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
+      for (int comp=0; comp<total_ncomp; ++comp) {
+         integrand[dit].copy(a_function[dit],0,comp,1);
+      }
+   }
+
+   int comp = 0;
+   for (int k=0; k<a_kernels.size(); ++k) {
+      const int kernel_ncomp = a_kernels[k]->nComponents();
+      LevelData<FArrayBox> kernel_integrand;
+      aliasLevelData( kernel_integrand, &integrand, Interval(comp, comp+kernel_ncomp-1) );
+      a_kernels[k]->eval( kernel_integrand, a_kinetic_species );
+      comp += kernel_ncomp;
+   }
+
+   // One reduction for all moments
+   const PhaseGeom& geometry = a_kinetic_species.phaseSpaceGeometry();
+   const VEL::VelCoordSys& vel_coords = geometry.velSpaceCoordSys();
+
+   CFG::LevelData<CFG::FArrayBox> moment;
+   integrateVelocity( moment, integrand, geometry );
+   moment.exchange();
+
+   const Real area = velocitySpaceArea( vel_coords );
+   const Real mass = a_kinetic_species.mass();
+   const CFG::DisjointBoxLayout& src_dbl = moment.disjointBoxLayout();
+
+   CFG::Copier copier;
+   CFG::DisjointBoxLayout copier_dbl;
+   CFG::IntVect copier_ghosts;
+
+   comp = 0;
+   for (int k=0; k<a_kernels.size(); ++k) {
+      const int kernel_ncomp = a_kernels[k]->nComponents();
+      const Real factor = a_kernels[k]->scale( a_kinetic_species ) * area / mass;
+
+      CFG::DataIterator cfg_dit = moment.dataIterator();
+      for (cfg_dit.begin(); cfg_dit.ok(); ++cfg_dit) {
+         moment[cfg_dit].mult( factor, comp, kernel_ncomp );
+      }
+
+      // Results usually share a layout, so the copier is rebuilt only on change
+      CFG::LevelData<CFG::FArrayBox>& result( *a_results[k] );
+      const CFG::DisjointBoxLayout& dst_dbl = result.disjointBoxLayout();
+      if ( k == 0 || !(dst_dbl == copier_dbl) || result.ghostVect() != copier_ghosts ) {
+         copier.ghostDefine(src_dbl,
+                            dst_dbl,
+                            dst_dbl.physDomain(),
+                            moment.ghostVect(),
+                            result.ghostVect());
+         copier_dbl = dst_dbl;
+         copier_ghosts = result.ghostVect();
+      }
+
+      moment.copyTo(Interval(comp, comp+kernel_ncomp-1), result, result.interval(), copier);
+
+      comp += kernel_ncomp;
+   }
+}
+
 #include "NamespaceFooter.H"
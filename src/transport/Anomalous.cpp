@@ -94,10 +94,21 @@ void Anomalous::evalTpmRHS( KineticSpeciesPtrVect&        rhs,
       CFG::LevelData<CFG::FArrayBox> temp_cfg(mag_geom.grids(), 1, cfg_ghostVect);
       CFG::LevelData<CFG::FArrayBox> four_cfg(mag_geom.grids(), 1, cfg_ghostVect);
       CFG::LevelData<CFG::FArrayBox> perp_cfg(mag_geom.grids(), 1, cfg_ghostVect);
-      moment_op.compute(dens_cfg, soln_species, fB, DensityKernel());
-      moment_op.compute(Upar_cfg, soln_species, fB, ParallelMomKernel());
-      moment_op.compute(four_cfg, soln_species, fB, FourthMomentKernel());
-      moment_op.compute(perp_cfg, soln_species, fB, PerpEnergyKernel());
+      DensityKernel density_kernel;
+      ParallelMomKernel parallel_mom_kernel;
+      FourthMomentKernel fourth_moment_kernel;
+      PerpEnergyKernel perp_energy_kernel;
+      Vector<const Kernel*> kernels;
+      Vector<CFG::LevelData<CFG::FArrayBox>*> moments;
+      kernels.push_back(&density_kernel);
+      kernels.push_back(&parallel_mom_kernel);
+      kernels.push_back(&fourth_moment_kernel);
+      kernels.push_back(&perp_energy_kernel);
+      moments.push_back(&dens_cfg);
+      moments.push_back(&Upar_cfg);
+      moments.push_back(&four_cfg);
+      moments.push_back(&perp_cfg);
+      moment_op.computeMany(moments, soln_species, fB, kernels);
       CFG::DataIterator cfg_dit = dens_cfg.dataIterator();
       for (cfg_dit.begin(); cfg_dit.ok(); ++cfg_dit) {
         Upar_cfg[cfg_dit].divide(dens_cfg[cfg_dit]);
@@ -526,10 +537,21 @@ inline void Anomalous::printParameters( const KineticSpeciesPtrVect& soln )
    CFG::LevelData<CFG::FArrayBox> four_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
    CFG::LevelData<CFG::FArrayBox> perp_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
 
-   moment_op.compute(dens_cfg, soln_species, fB, DensityKernel());
-   moment_op.compute(Upar_cfg, soln_species, fB, ParallelMomKernel());
-   moment_op.compute(four_cfg, soln_species, fB, FourthMomentKernel());
-   moment_op.compute(perp_cfg, soln_species, fB, PerpEnergyKernel());
+   DensityKernel density_kernel;
+   ParallelMomKernel parallel_mom_kernel;
+   FourthMomentKernel fourth_moment_kernel;
+   PerpEnergyKernel perp_energy_kernel;
+   Vector<const Kernel*> kernels;
+   Vector<CFG::LevelData<CFG::FArrayBox>*> moments;
+   kernels.push_back(&density_kernel);
+   kernels.push_back(&parallel_mom_kernel);
+   kernels.push_back(&fourth_moment_kernel);
+   kernels.push_back(&perp_energy_kernel);
+   moments.push_back(&dens_cfg);
+   moments.push_back(&Upar_cfg);
+   moments.push_back(&four_cfg);
+   moments.push_back(&perp_cfg);
+   moment_op.computeMany(moments, soln_species, fB, kernels);
    CFG::DataIterator cfg_dit = dens_cfg.dataIterator();
    for (cfg_dit.begin(); cfg_dit.ok(); ++cfg_dit) {
      Upar_cfg[cfg_dit].divide(dens_cfg[cfg_dit]);
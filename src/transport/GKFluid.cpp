@@ -87,8 +87,15 @@ void GKFluid::evalTpmRHS( KineticSpeciesPtrVect&        rhs,
       CFG::LevelData<CFG::FArrayBox> Upar_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
       CFG::LevelData<CFG::FArrayBox> temp_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
       CFG::LevelData<CFG::FArrayBox> four_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
-      moment_op.compute(dens_cfg, soln_species, fB, DensityKernel());
-      moment_op.compute(Upar_cfg, soln_species, fB, ParallelMomKernel());
+      DensityKernel density_kernel;
+      ParallelMomKernel parallel_mom_kernel;
+      Vector<const Kernel*> kernels;
+      Vector<CFG::LevelData<CFG::FArrayBox>*> moments;
+      kernels.push_back(&density_kernel);
+      kernels.push_back(&parallel_mom_kernel);
+      moments.push_back(&dens_cfg);
+      moments.push_back(&Upar_cfg);
+      moment_op.computeMany(moments, soln_species, fB, kernels);
       CFG::DataIterator cfg_dit = dens_cfg.dataIterator();
       for (cfg_dit.begin(); cfg_dit.ok(); ++cfg_dit) {
         Upar_cfg[cfg_dit].divide(dens_cfg[cfg_dit]);
@@ -361,8 +368,15 @@ inline void GKFluid::printParameters( const KineticSpeciesPtrVect& soln )
    CFG::LevelData<CFG::FArrayBox> Upar_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
    CFG::LevelData<CFG::FArrayBox> temp_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
    CFG::LevelData<CFG::FArrayBox> four_cfg(mag_geom.grids(), 1, CFG::IntVect::Unit);
-   moment_op.compute(dens_cfg, soln_species, fB, DensityKernel());
-   moment_op.compute(Upar_cfg, soln_species, fB, ParallelMomKernel());
+   DensityKernel density_kernel;
+   ParallelMomKernel parallel_mom_kernel;
+   Vector<const Kernel*> kernels;
+   Vector<CFG::LevelData<CFG::FArrayBox>*> moments;
+   kernels.push_back(&density_kernel);
+   kernels.push_back(&parallel_mom_kernel);
+   moments.push_back(&dens_cfg);
+   moments.push_back(&Upar_cfg);
+   moment_op.computeMany(moments, soln_species, fB, kernels);
    CFG::DataIterator cfg_dit = dens_cfg.dataIterator();
    for (cfg_dit.begin(); cfg_dit.ok(); ++cfg_dit) {
      Upar_cfg[cfg_dit].divide(dens_cfg[cfg_dit]);
@@ -14,7 +14,8 @@
 #include "NamespaceHeader.H"
 
 GKTransport::GKTransport( const int a_verbose )
-   : m_verbose(a_verbose)
+   : m_verbose(a_verbose),
+     m_num_mu_cells(0)
 {
    bool more_kinetic_species(true);
    int count(0);
@@ -109,6 +110,21 @@ Real GKTransport::computeDt( const KineticSpeciesPtrVect& soln )
 }
 
 Real GKTransport::computeTimeScale( const KineticSpeciesPtrVect& soln )
+{
+   std::vector<Real> local_data;
+   localTimeScaleData( soln, local_data );
+   std::vector<Real> data( local_data );
+#ifdef CH_MPI
+   MPI_Allreduce( &(local_data[0]), &(data[0]), local_data.size(), MPI_CH_REAL, MPI_MIN, MPI_COMM_WORLD );
+#endif
+   int offset(0);
+   Real dt, time_scale;
+   computeDtAndTimeScale( soln, data, offset, dt, time_scale );
+   return time_scale;
+}
+
+void GKTransport::localTimeScaleData( const KineticSpeciesPtrVect& soln,
+                                      std::vector<Real>&           data )
 {
    // get stuff to calculate stability parameters on time step
    const KineticSpecies& soln_species( *(soln[0]) );
@@ -117,7 +133,7 @@ Real GKTransport::computeTimeScale( const KineticSpeciesPtrVect& soln )
    const PhaseGeom& phase_geom = soln_species.phaseSpaceGeometry();
    const ProblemDomain& phase_domain = phase_geom.domain();
    const Box& domain_box = phase_domain.domainBox();
-   int num_mu_cells = domain_box.size(3);
+   m_num_mu_cells = domain_box.size(3);
 
    // get dr and dlnB/dr, and hr
    const LevelData<FArrayBox>& inj_B = phase_geom.getBFieldMagnitude();
@@ -125,7 +141,7 @@ Real GKTransport::computeTimeScale( const KineticSpeciesPtrVect& soln )
    LevelData<FArrayBox> hr(grids, 1, IntVect::Zero); // r metrics
    DataIterator bdit= inj_B.dataIterator();
    LevelData<FArrayBox> dlnB_dr(grids, 1, IntVect::Zero);
-   Real dr;
+   Real dr(0.);
    for (bdit.begin(); bdit.ok(); ++bdit)
    {
      const PhaseBlockCoordSys& block_coord_sys = phase_geom.getBlockCoordSys(dbl[bdit]);
@@ -146,8 +162,6 @@ Real GKTransport::computeTimeScale( const KineticSpeciesPtrVect& soln )
                     CHF_CONST_FRA1(b_on_patch,0),
                     CHF_FRA1(dlnB_dr_on_patch,0));
    }
-   hr.exchange();
-   dlnB_dr.exchange();
 
    // get the minimum value of dlnB/dr and hr
    Real local_minimum(10);     // 10 is just a starting point
@@ -160,12 +174,23 @@ Real GKTransport::computeTimeScale( const KineticSpeciesPtrVect& soln )
       local_minimum = Min( local_minimum, box_min );
       local_minimum_hr = Min( local_minimum_hr, box_min_hr );
    }
-   Real min_dlnB_dr( local_minimum );
-   Real min_hr( local_minimum_hr );
-#ifdef CH_MPI
-   MPI_Allreduce( &local_minimum, &min_dlnB_dr, 1, MPI_CH_REAL, MPI_MAX, MPI_COMM_WORLD );
-   MPI_Allreduce( &local_minimum_hr, &min_hr, 1, MPI_CH_REAL, MPI_MAX, MPI_COMM_WORLD );
-#endif
+
+   // the global values are the maxima over processors, hence the negation
+   data.push_back( -local_minimum );
+   data.push_back( -local_minimum_hr );
+   data.push_back( -dr );
+}
+
+void GKTransport::computeDtAndTimeScale( const KineticSpeciesPtrVect& soln,
+                                         const std::vector<Real>&     data,
+                                         int&                         offset,
+                                         Real&                        dt,
+                                         Real&                        time_scale )
+{
+  const Real min_dlnB_dr( -data[offset++] );
+  const Real min_hr( -data[offset++] );
+  const Real dr( -data[offset++] );
+  const int num_mu_cells( m_num_mu_cells );
 
   // get transport dt_stable for each species
   Vector<Real> dt_stable(soln.size(), DBL_MAX);
@@ -202,9 +227,8 @@ Real GKTransport::computeTimeScale( const KineticSpeciesPtrVect& soln )
       min_dt = Min(min_dt,dt_stable[species]);
     }
   }
-  //return min_dt;
-  return min_dt;
-
+  dt = min_dt;
+  time_scale = min_dt;
 }
 
 void GKTransport::getCellCenteredMetrics(FArrayBox&          metrics_cells,
@@ -8,9 +8,12 @@
 
 #include "mappedLimiterF_F.H"
 #include "altFaceAverages.H"
+#include "altFaceAveragesF_F.H"
 #include "mappedAdvectionFlux.H"
 
 #include "inspect.H"
+#include "GKProfiler.H"
+#include "ThreadScratch.H"
 
 #undef CH_SPACEDIM
 #define CH_SPACEDIM CFG_DIM
@@ -32,7 +35,18 @@ GKVlasov::GKVlasov( ParmParse& a_pp,
   : m_larmor_number(a_larmor_number),
     m_face_avg_type(INVALID),
     m_saved_dt(-1.0),
-    m_dt_dim_factor(1.0)
+    m_dt_dim_factor(1.0),
+    m_cache_velocity(true),
+    m_efield_version(-1),
+    m_count_velocity_computed(0),
+    m_count_velocity_reused(0),
+    m_fused_flux(false),
+    m_fused_tile_size(8),
+    m_fused_flux_warned(false),
+    m_consolidated_exchange(false),
+    m_count_rhs(0),
+    m_count_exchange(0),
+    m_exchange_bytes(0)
 {
    if (a_pp.contains("limiter")) {
       if ( procID()==0 ) MayDay::Warning("GKVlasov: Use of input flag 'limiter' deprecated");
@@ -52,6 +66,18 @@ GKVlasov::GKVlasov( ParmParse& a_pp,
       m_time_step_diagnostics = false;
    }
 
+   if (a_pp.contains("cache_velocity")) {
+      a_pp.get("cache_velocity", m_cache_velocity);
+   }
+
+   a_pp.query("consolidated_exchange", m_consolidated_exchange);
+
+   a_pp.query("fused_flux", m_fused_flux);
+   a_pp.query("fused_tile_size", m_fused_tile_size);
+   if ( m_fused_tile_size<1 ) {
+      MayDay::Error("GKVlasov: fused_tile_size must be positive");
+   }
+
    if (a_pp.contains("face_avg_type")) {
       std::string dummy;
       a_pp.get("face_avg_type", dummy);
@@ -100,19 +126,37 @@ GKVlasov::evalRHS( KineticSpecies&           a_rhs_species,
    const LevelData<FArrayBox>& soln_dfn( a_soln_species.distributionFunction() );
    const DisjointBoxLayout& dbl( soln_dfn.getBoxes() );
 
-   LevelData<FluxBox> velocity( dbl, SpaceDim, IntVect::Unit );
-   a_soln_species.computeVelocity( velocity, a_Efield );
+   m_count_rhs++;
+
+   const LevelData<FluxBox>& velocity( phaseVelocity( a_soln_species, a_Efield, false ) );
 
    const PhaseGeom& geometry( a_rhs_species.phaseSpaceGeometry() );
+   LevelData<FArrayBox>& rhs_dfn( a_rhs_species.distributionFunction() );
+
+   if ( useFusedFlux( geometry, rhs_dfn ) ) {
+      const LevelData<FluxBox>& normal_velocity( phaseNormalVelocity( velocity, geometry ) );
+      computeFusedFluxDivergence( rhs_dfn, soln_dfn, normal_velocity, geometry );
+      return;
+   }
+   else if ( m_fused_flux && !m_fused_flux_warned ) {
+      if ( procID()==0 ) {
+         MayDay::Warning("GKVlasov: fused_flux only applies to single-block, second-order runs; using the unfused flux");
+      }
+      m_fused_flux_warned = true;
+   }
+
    LevelData<FluxBox> flux( dbl, SpaceDim, IntVect::Unit );
+   GKProfiler::instance().addBytes( GKProfiler::storageBytes( flux ) );
    computeFlux( soln_dfn, velocity, flux, geometry );
 
-   LevelData<FArrayBox>& rhs_dfn( a_rhs_species.distributionFunction() );
    const bool OMIT_NT(false);
    geometry.mappedGridDivergence( rhs_dfn, flux, OMIT_NT );
 
    // Divide by cell volume and negate
-   for (DataIterator dit( rhs_dfn.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( rhs_dfn.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const PhaseBlockCoordSys&
          block_coord_sys( geometry.getBlockCoordSys( dbl[dit] ) );
       double fac( -1.0 / block_coord_sys.getMappedCellVolume() );
@@ -138,11 +182,13 @@ GKVlasov::evalRHS( KineticSpecies&                 a_rhs_species,
    const LevelData<FArrayBox>& soln_dfn( a_soln_species.distributionFunction() );
    const DisjointBoxLayout& dbl( soln_dfn.getBoxes() );
     
-   LevelData<FluxBox> velocity( dbl, SpaceDim, IntVect::Unit );
-   a_soln_species.computeVelocity( velocity, a_Efield );
+   m_count_rhs++;
+
+   const LevelData<FluxBox>& velocity( phaseVelocity( a_soln_species, a_Efield, false ) );
     
    const PhaseGeom& geometry( a_rhs_species.phaseSpaceGeometry() );
    LevelData<FluxBox> flux( dbl, SpaceDim, IntVect::Unit );
+   GKProfiler::instance().addBytes( GKProfiler::storageBytes( flux ) );
    computeFlux( soln_dfn, velocity, flux, geometry );
     
    LevelData<FArrayBox>& rhs_dfn( a_rhs_species.distributionFunction() );
@@ -150,7 +196,10 @@ GKVlasov::evalRHS( KineticSpecies&                 a_rhs_species,
    geometry.mappedGridDivergence( rhs_dfn, flux, OMIT_NT );
     
    // Divide by cell volume and negate
-   for (DataIterator dit( rhs_dfn.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( rhs_dfn.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const PhaseBlockCoordSys&
          block_coord_sys( geometry.getBlockCoordSys( dbl[dit] ) );
       double fac( -1.0 / block_coord_sys.getMappedCellVolume() );
@@ -328,29 +377,46 @@ GKVlasov::computeFlux( const LevelData<FArrayBox>& a_dist_fn,
       velocity.   This is where the hyperbolic stuff connects.
    */
 
+   // The upwind face-average routines compute the faces of the boxes grown
+   // by one cell from the distribution function ghost cells, which the caller
+   // has already exchanged.  Everything downstream only reads these faces,
+   // so in consolidated mode the face values are neither stored beyond them
+   // nor exchanged.
+   const bool consolidated( m_consolidated_exchange && m_face_avg_type!=PPM );
+
    // Construct appropriately accurate face-averages of phi and advVel
-   LevelData<FluxBox> faceDist(a_dist_fn.getBoxes(), a_dist_fn.nComp(), a_dist_fn.ghostVect() );
+   const IntVect face_ghosts( consolidated ? IntVect::Unit : a_dist_fn.ghostVect() );
+   LevelData<FluxBox> faceDist(a_dist_fn.getBoxes(), a_dist_fn.nComp(), face_ghosts );
+   GKProfiler::instance().addBytes( GKProfiler::storageBytes( faceDist ) );
 
    // If we're limiting the face-centered values, do it here
    if (m_face_avg_type==PPM) {
       computeFaceAverages( faceDist, a_dist_fn, a_phase_geom.secondOrder() );
-      faceDist.exchange();
+      {
+         GK_PROFILE(EXCHANGE);
+         GK_PROFILE_WAIT();
+         faceDist.exchange();
+      }
+      countExchange( faceDist );
       applyMappedLimiter( faceDist, a_dist_fn, a_velocity, a_phase_geom );
    }
    else if (m_face_avg_type==UW1) {
-      uw1FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom );
+      uw1FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom, !consolidated );
    }
    else if (m_face_avg_type==UW3) {
-      uw3FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom );
+      uw3FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom, !consolidated );
    }
    else if (m_face_avg_type==UW5) {
-      uw5FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom );
+      uw5FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom, !consolidated );
    }
    else if (m_face_avg_type==WENO5) {
-      weno5FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom );
+      weno5FaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom, !consolidated );
    }
    else if (m_face_avg_type==BWENO) {
-      bwenoFaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom );
+      bwenoFaceAverages( faceDist, a_dist_fn, a_velocity, a_phase_geom, !consolidated );
+   }
+   if ( m_face_avg_type!=PPM && !consolidated ) {
+      countExchange( faceDist );
    }
 
    if ( a_phase_geom.secondOrder() ) {
@@ -362,6 +428,7 @@ GKVlasov::computeFlux( const LevelData<FArrayBox>& a_dist_fn,
 
       const DisjointBoxLayout& grids = a_flux.disjointBoxLayout();
       LevelData<FluxBox> fourth_order_flux(grids, SpaceDim, IntVect::Zero);
+      GKProfiler::instance().addBytes( GKProfiler::storageBytes( fourth_order_flux ) );
       
       // Compute computational-space fluxes; in mappedAdvectionFlux.cpp
       computeCompFaceFluxes( fourth_order_flux, faceDist, a_velocity, true );
@@ -369,7 +436,10 @@ GKVlasov::computeFlux( const LevelData<FArrayBox>& a_dist_fn,
       // Compute the second-order flux in valid plus ghost cell faces,
       // then overwrite with the fourth-order flux on the valid faces.
       CH_assert(a_flux.ghostVect() == IntVect::Unit);
-      for (DataIterator dit(grids); dit.ok(); ++dit) {
+      DataIterator boxes( grids );
+#pragma omp parallel for
+      for (int ibox=0; ibox<boxes.size(); ibox++) {
+         const DataIndex& dit( boxes[ibox] );
          a_flux[dit].copy(a_velocity[dit]);
 
          Box box = grow(grids[dit],1);
@@ -381,7 +451,15 @@ GKVlasov::computeFlux( const LevelData<FArrayBox>& a_dist_fn,
       }
    }
 
+   // The second-order flux on the ghost faces is the product of face values
+   // and velocities that are already consistent with the neighboring boxes;
+   // only the fourth-order flux of the neighbors needs to be communicated.
+   if ( consolidated && a_phase_geom.secondOrder() ) return;
+
+   GK_PROFILE(EXCHANGE);
+   GK_PROFILE_WAIT();
    a_flux.exchange();
+   countExchange( a_flux );
 }
 
 
@@ -395,10 +473,7 @@ GKVlasov::computeDt( const LevelData<FluxBox>&    a_Efield,
    for (int s(0); s<a_species_vect.size(); s++) {
 
       const KineticSpecies& species( *(a_species_vect[s]) );
-      const LevelData<FArrayBox>& dfn( species.distributionFunction() );
-
-      LevelData<FluxBox> velocity( dfn.getBoxes(), SpaceDim, IntVect::Unit );
-      species.computeMappedVelocity( velocity, a_Efield );
+      const LevelData<FluxBox>& velocity( phaseVelocity( species, a_Efield, true ) );
 
       const Real UNIT_CFL(1.0);
       const PhaseGeom& geometry( species.phaseSpaceGeometry() );
@@ -420,10 +495,7 @@ GKVlasov::computeTimeScale( const LevelData<FluxBox>&    a_Efield,
    for (int s(0); s<a_species_vect.size(); s++) {
 
       const KineticSpecies& species( *(a_species_vect[s]) );
-      const LevelData<FArrayBox>& dfn( species.distributionFunction() );
-
-      LevelData<FluxBox> velocity( dfn.getBoxes(), SpaceDim, IntVect::Unit );
-      species.computeMappedVelocity( velocity, a_Efield );
+      const LevelData<FluxBox>& velocity( phaseVelocity( species, a_Efield, true ) );
 
       //      const Real UNIT_CFL(1.0);
       const PhaseGeom& geometry( species.phaseSpaceGeometry() );
@@ -437,6 +509,360 @@ GKVlasov::computeTimeScale( const LevelData<FluxBox>&    a_Efield,
 }
 
 
+void
+GKVlasov::localTimeScaleData( const LevelData<FluxBox>&    a_Efield,
+                              const KineticSpeciesPtrVect& a_species_vect,
+                              std::vector<Real>&           a_data )
+{
+   for (int s(0); s<a_species_vect.size(); s++) {
+
+      const KineticSpecies& species( *(a_species_vect[s]) );
+      const LevelData<FluxBox>& velocity( phaseVelocity( species, a_Efield, true ) );
+      const PhaseGeom& geometry( species.phaseSpaceGeometry() );
+
+      if (m_time_step_diagnostics) {
+         // Reports the limiting location (with its own reductions)
+         const Real UNIT_CFL(1.0);
+         computeMappedDtSpecies( velocity, geometry, UNIT_CFL );
+      }
+
+      // Negated, so that the global minimum is the global maximum rate
+      a_data.push_back( -localMappedRate( velocity, geometry ) );
+   }
+}
+
+
+void
+GKVlasov::computeDtAndTimeScale( const KineticSpeciesPtrVect& a_species_vect,
+                                 const std::vector<Real>&     a_data,
+                                 int&                         a_offset,
+                                 Real&                        a_dt,
+                                 Real&                        a_time_scale ) const
+{
+   const Real smallVal = 1.0e-15;
+
+   a_dt = BASEFAB_REAL_SETVAL;
+   a_time_scale = BASEFAB_REAL_SETVAL;
+   for (int s(0); s<a_species_vect.size(); s++) {
+      const Real maxVel( -a_data[a_offset++] );
+
+      // Same estimates as computeMappedDtSpecies and
+      // computeMappedTimeScaleSpecies with unit CFL
+      Real speciesDt(0.), speciesTimeScale(0.);
+      if (maxVel > smallVal) {
+         speciesDt = s_stability_bound[m_face_avg_type] / (maxVel * m_dt_dim_factor);
+         speciesTimeScale = 1.0 / maxVel;
+      }
+
+      a_dt = Min( a_dt, speciesDt );
+      a_time_scale = Min( a_time_scale, speciesTimeScale );
+   }
+}
+
+
+Real
+GKVlasov::localMappedRate( const LevelData<FluxBox>& a_faceVel,
+                           const PhaseGeom&          a_geom ) const
+{
+   // The loop of computeMappedDtSpecies without the global reduction: the
+   // area-weighted normal velocities are averaged to cell centers, their
+   // magnitudes summed over directions and divided by the cell volume
+   const DisjointBoxLayout& grids( a_faceVel.getBoxes() );
+   CH_assert(grids == a_geom.gridsFull());
+
+   LevelData<FArrayBox> cellVolumes(grids, 1, IntVect::Zero);
+   a_geom.getCellVolumes(cellVolumes);
+
+   // Temporaries are allocated here, since the threaded loop must not allocate
+   LevelData<FluxBox> normalVels(grids, 1, IntVect::Zero);
+   LevelData<FArrayBox> cellVels(grids, 1, IntVect::Zero);
+   LevelData<FArrayBox> cellVelDirs(grids, 1, IntVect::Zero);
+
+   Real maxVelLoc = 0.;
+   DataIterator boxes( grids.dataIterator() );
+#pragma omp parallel for reduction(max:maxVelLoc)
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
+      const PhaseBlockCoordSys& block_coord_sys( a_geom.getBlockCoordSys(grids[dit]) );
+      RealVect face_area = block_coord_sys.getMappedFaceArea();
+
+      FluxBox& normalVel( normalVels[dit] );
+      FArrayBox& cellVel( cellVels[dit] );
+      FArrayBox& cellVelDir( cellVelDirs[dit] );
+      cellVel.setVal(0.);
+      for (int dir=0; dir<SpaceDim; dir++) {
+         normalVel[dir].copy(a_faceVel[dit][dir],dir,0,1);
+         normalVel[dir] *= face_area[dir];
+         EdgeToCell(normalVel, 0, cellVelDir, 0, dir);
+         cellVelDir.abs(0,1);
+         cellVel.plus(cellVelDir, 0, 0, 1);
+      }
+
+      cellVel.divide(cellVolumes[dit], 0, 0, 1);
+
+      Real thisMax = cellVel.norm(0,0,1);
+      if (thisMax > maxVelLoc) maxVelLoc = thisMax;
+   }
+
+   return maxVelLoc;
+}
+
+
+const LevelData<FluxBox>&
+GKVlasov::phaseVelocity( const KineticSpecies&     a_species,
+                         const LevelData<FluxBox>& a_Efield,
+                         const bool                a_mapped )
+{
+   // The velocity depends only on the species geometry (which carries the
+   // mass and charge state) and on the electric field
+   const PhaseGeom* geometry( &(a_species.phaseSpaceGeometry()) );
+
+   int index(-1);
+   for (int n(0); n<m_velocity_cache.size(); n++) {
+      if ( m_velocity_cache[n].geometry==geometry && m_velocity_cache[n].mapped==a_mapped ) {
+         index = n;
+         break;
+      }
+   }
+
+   if ( index<0 ) {
+      VelocityCacheEntry entry;
+      entry.geometry = geometry;
+      entry.mapped = a_mapped;
+      entry.efield_version = -1;
+      entry.velocity = RefCountedPtr<LevelData<FluxBox> >( new LevelData<FluxBox> );
+      entry.normal_velocity = RefCountedPtr<LevelData<FluxBox> >( new LevelData<FluxBox> );
+      entry.normal_velocity_valid = false;
+      m_velocity_cache.push_back( entry );
+      index = m_velocity_cache.size() - 1;
+   }
+
+   VelocityCacheEntry& entry( m_velocity_cache[index] );
+   LevelData<FluxBox>& velocity( *(entry.velocity) );
+
+   const bool valid( m_cache_velocity
+                     && m_efield_version>=0
+                     && entry.efield_version==m_efield_version
+                     && velocity.isDefined()
+                     && velocity.getBoxes()==a_species.distributionFunction().getBoxes() );
+
+   if ( valid ) {
+      m_count_velocity_reused++;
+   }
+   else {
+      if ( a_mapped ) {
+         a_species.computeMappedVelocity( velocity, a_Efield );
+      }
+      else {
+         a_species.computeVelocity( velocity, a_Efield );
+      }
+      entry.efield_version = m_efield_version;
+      entry.normal_velocity_valid = false;
+      m_count_velocity_computed++;
+      countExchange( velocity );
+   }
+
+   return velocity;
+}
+
+
+bool
+GKVlasov::useFusedFlux( const PhaseGeom&            a_geom,
+                        const LevelData<FArrayBox>& a_rhs ) const
+{
+   // The fused evaluation omits the fourth-order corrections of the flux
+   // products and the flux averaging at block interfaces, so it is only
+   // used for single-block, second-order runs
+   return m_fused_flux
+      && m_face_avg_type!=PPM
+      && a_geom.secondOrder()
+      && a_geom.phaseCoordSys().numBlocks()==1
+      && a_rhs.ghostVect()==IntVect::Zero;
+}
+
+
+const LevelData<FluxBox>&
+GKVlasov::phaseNormalVelocity( const LevelData<FluxBox>& a_velocity,
+                               const PhaseGeom&          a_geom )
+{
+   int index(-1);
+   for (int n(0); n<m_velocity_cache.size(); n++) {
+      if ( &(*m_velocity_cache[n].velocity)==&a_velocity ) {
+         index = n;
+         break;
+      }
+   }
+   CH_assert( index>=0 );
+
+   VelocityCacheEntry& entry( m_velocity_cache[index] );
+   LevelData<FluxBox>& normal_velocity( *(entry.normal_velocity) );
+
+   if ( !entry.normal_velocity_valid ) {
+      const DisjointBoxLayout& grids( a_velocity.getBoxes() );
+      if ( !normal_velocity.isDefined() || !(normal_velocity.getBoxes()==grids) ) {
+         normal_velocity.define( grids, 1, IntVect::Zero );
+      }
+      for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+         normal_velocity[dit].setVal( 0.0 );
+      }
+      a_geom.computeMetricTermProductAverage( normal_velocity, a_velocity, false );
+      entry.normal_velocity_valid = true;
+   }
+
+   return normal_velocity;
+}
+
+
+void
+GKVlasov::computeFusedFluxDivergence( LevelData<FArrayBox>&       a_rhs,
+                                      const LevelData<FArrayBox>& a_dist_fn,
+                                      const LevelData<FluxBox>&   a_normal_velocity,
+                                      const PhaseGeom&            a_geom ) const
+{
+   /*
+     Second-order evaluation of
+
+        rhs = - divergence( N^T velocity face_average(dist_fn) ) / cell_volume
+
+     one velocity space tile at a time.  The face values and fluxes of a tile
+     only exist in a scratch FArrayBox, so no face data is stored for the
+     whole level and each tile of rhs is completed while it is in cache.
+   */
+   const DisjointBoxLayout& grids( a_rhs.disjointBoxLayout() );
+   const int ncomp( a_dist_fn.nComp() );
+
+   IntVect tile_size( IntVect::Zero );
+   for (int dir(CFG_DIM); dir<SpaceDim; dir++) {
+      tile_size[dir] = m_fused_tile_size;
+   }
+
+   // The face values of a tile, in storage allocated here for the largest
+   // tile, since the threaded loop must not allocate
+   DataIterator boxes( grids.dataIterator() );
+   ThreadScratch scratch(1);
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      Box tile( grids[boxes[ibox]] );
+      for (int dir(0); dir<SpaceDim; dir++) {
+         if ( tile_size[dir]>0 && tile.size(dir)>tile_size[dir] ) {
+            tile.setBig( dir, tile.smallEnd(dir) + tile_size[dir] - 1 );
+         }
+      }
+      for (int dir(0); dir<SpaceDim; dir++) {
+         scratch.reserve( 0, surroundingNodes( tile, dir ), ncomp );
+      }
+   }
+   scratch.allocate();
+
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
+      const double start( GKProfiler::wallTime() );
+      const PhaseBlockCoordSys& block_coord_sys( a_geom.getBlockCoordSys( grids[dit] ) );
+      const double fac( -1.0 / block_coord_sys.getMappedCellVolume() );
+
+      const FArrayBox& this_dist_fn( a_dist_fn[dit] );
+      const FluxBox& this_normal_vel( a_normal_velocity[dit] );
+      FArrayBox& this_rhs( a_rhs[dit] );
+
+      // Tiles of the box in the velocity directions, enumerated rather than
+      // stored, since the threaded loop must not allocate
+      const Box& box( grids[dit] );
+      IntVect num_tiles( IntVect::Unit );
+      int total_tiles(1);
+      for (int dir(0); dir<SpaceDim; dir++) {
+         if ( tile_size[dir]>0 ) {
+            num_tiles[dir] = (box.size(dir) + tile_size[dir] - 1) / tile_size[dir];
+         }
+         total_tiles *= num_tiles[dir];
+      }
+
+      for (int n(0); n<total_tiles; n++) {
+         Box tile( box );
+         int index( n );
+         for (int dir(0); dir<SpaceDim; dir++) {
+            if ( tile_size[dir]>0 ) {
+               const int lo( box.smallEnd(dir) + (index % num_tiles[dir]) * tile_size[dir] );
+               tile.setSmall( dir, lo );
+               tile.setBig( dir, Min( lo + tile_size[dir] - 1, box.bigEnd(dir) ) );
+            }
+            index /= num_tiles[dir];
+         }
+         this_rhs.setVal( 0.0, tile, 0, ncomp );
+
+         for (int dir(0); dir<SpaceDim; dir++) {
+            Box face_box( tile );
+            face_box.surroundingNodes( dir );
+            FArrayBox face_phi( face_box, ncomp, scratch.get( 0, face_box, ncomp ) );
+
+            const FArrayBox& this_normal_vel_dir( this_normal_vel[dir] );
+            if (m_face_avg_type==UW1) {
+               FORT_UW1FACEVALUES( CHF_FRA( face_phi ),
+                                   CHF_CONST_FRA( this_dist_fn ),
+                                   CHF_CONST_FRA1( this_normal_vel_dir, 0 ),
+                                   CHF_BOX( face_box ),
+                                   CHF_CONST_INT( dir ) );
+            }
+            else if (m_face_avg_type==UW3) {
+               FORT_UW3FACEVALUES( CHF_FRA( face_phi ),
+                                   CHF_CONST_FRA( this_dist_fn ),
+                                   CHF_CONST_FRA1( this_normal_vel_dir, 0 ),
+                                   CHF_BOX( face_box ),
+                                   CHF_CONST_INT( dir ) );
+            }
+            else if (m_face_avg_type==UW5) {
+               FORT_UW5FACEVALUES( CHF_FRA( face_phi ),
+                                   CHF_CONST_FRA( this_dist_fn ),
+                                   CHF_CONST_FRA1( this_normal_vel_dir, 0 ),
+                                   CHF_BOX( face_box ),
+                                   CHF_CONST_INT( dir ) );
+            }
+            else if (m_face_avg_type==WENO5) {
+               FORT_WENO5FACEVALUES( CHF_FRA( face_phi ),
+                                     CHF_CONST_FRA( this_dist_fn ),
+                                     CHF_CONST_FRA1( this_normal_vel_dir, 0 ),
+                                     CHF_BOX( face_box ),
+                                     CHF_CONST_INT( dir ) );
+            }
+            else {
+               FORT_BWENOFACEVALUES( CHF_FRA( face_phi ),
+                                     CHF_CONST_FRA( this_dist_fn ),
+                                     CHF_CONST_FRA1( this_normal_vel_dir, 0 ),
+                                     CHF_BOX( face_box ),
+                                     CHF_CONST_INT( dir ) );
+            }
+
+            FORT_INCREMENTFACEFLUXDIVERGENCE( CHF_FRA( this_rhs ),
+                                              CHF_CONST_FRA( face_phi ),
+                                              CHF_CONST_FRA1( this_normal_vel_dir, 0 ),
+                                              CHF_BOX( tile ),
+                                              CHF_CONST_INT( dir ) );
+         }
+
+         this_rhs.mult( fac, tile, 0, ncomp );
+      }
+
+      a_geom.addBoxWork( grids, ibox, GKProfiler::wallTime() - start );
+   }
+}
+
+
+void
+GKVlasov::countExchange( const LevelData<FluxBox>& a_data )
+{
+   // Bytes of the ghost faces of the local boxes, an upper bound of the
+   // data received (it includes the faces at the physical boundaries)
+   const DisjointBoxLayout& grids( a_data.disjointBoxLayout() );
+   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+      for (int dir(0); dir<SpaceDim; dir++) {
+         const long long num_ghost( a_data[dit][dir].box().numPts()
+                                    - surroundingNodes( grids[dit], dir ).numPts() );
+         m_exchange_bytes += num_ghost * a_data.nComp() * sizeof(Real);
+      }
+   }
+   m_count_exchange++;
+}
+
+
 void
 GKVlasov::initialize( KineticSpeciesPtrVect& soln,
                       const Real      time )
@@ -783,6 +1209,7 @@ GKVlasov::applyMappedLimiter( LevelData<FluxBox>&         a_facePhi,
 
    // may need to do exchange on facePhi
    a_facePhi.exchange();
+   countExchange( a_facePhi );
 
    const DisjointBoxLayout& grids = a_facePhi.getBoxes();
 
@@ -805,16 +1232,44 @@ GKVlasov::applyMappedLimiter( LevelData<FluxBox>&         a_facePhi,
       }
    }
 
-   for (DataIterator dit(grids); dit.ok(); ++dit) {
+   // need two laplacian ghost cells for this limiter
+   const int lapBoxGrow = max(normalGrow+2, transverseGrow);
+
+   // The temporaries of the threaded loop below, for which storage is
+   // allocated here: ccLaplacians, centeredLaplacian, D2a, D2aLim, leftPhi
+   // and rightPhi, on the boxes computed as in the loop
+   DataIterator boxes( grids );
+   ThreadScratch scratch(6);
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const Box& gridBox = grids[boxes[ibox]];
+      scratch.reserve(0, grow(gridBox,lapBoxGrow), nComp);
+      for (int dir=0; dir<SpaceDim; dir++) {
+         Box faceBox(gridBox);
+         faceBox.grow(transverseGrow);
+         faceBox.grow(dir,normalGrow - transverseGrow);
+         faceBox.surroundingNodes(dir);
+         Box lapBoxDir(gridBox);
+         lapBoxDir.grow(transverseGrow);
+         lapBoxDir.grow(dir,normalGrow-transverseGrow+1);
+         scratch.reserve(1, grow(faceBox,dir,1), nComp);
+         scratch.reserve(2, lapBoxDir, nComp);
+         scratch.reserve(3, lapBoxDir, nComp);
+         scratch.reserve(4, grow(faceBox,dir,1), nComp);
+         scratch.reserve(5, grow(faceBox,dir,1), nComp);
+      }
+   }
+   scratch.allocate();
+
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const PhaseBlockCoordSys& block_coord_sys = a_geom.getBlockCoordSys(grids[dit]);
       const RealVect& dx = block_coord_sys.dx();
 
       const Box& gridBox = grids[dit];
       Box lapBox(gridBox);
-      // need two laplacian ghost cells for this limiter
-      int lapBoxGrow = max(normalGrow+2, transverseGrow);
       lapBox.grow(lapBoxGrow);
-      FArrayBox ccLaplacians(lapBox, nComp);
+      FArrayBox ccLaplacians(lapBox, nComp, scratch.get(0, lapBox, nComp));
       FluxBox& thisFacePhi = a_facePhi[dit];
       const FArrayBox& thisCellPhi = a_cellPhi[dit];
       const FluxBox& thisNormalVel = normalVel[dit];
@@ -849,7 +1304,8 @@ GKVlasov::applyMappedLimiter( LevelData<FluxBox>&         a_facePhi,
                // need an extra face's worth of the FC laplacians
                grownFaceBox.grow(dir,1);
 
-               FArrayBox centeredLaplacian(grownFaceBox, nComp);
+               FArrayBox centeredLaplacian(grownFaceBox, nComp,
+                                           scratch.get(1, grownFaceBox, nComp));
 
                // compute centered Laplacian
                centeredLaplacian.setVal(0.0);
@@ -888,8 +1344,8 @@ GKVlasov::applyMappedLimiter( LevelData<FluxBox>&         a_facePhi,
             // need this to be grown by one in normal dir
             lapBoxDir.grow(dir,normalGrow-transverseGrow+1);
 
-            FArrayBox D2a(lapBoxDir,nComp);
-            FArrayBox D2aLim(lapBoxDir,nComp);
+            FArrayBox D2a(lapBoxDir,nComp,scratch.get(2,lapBoxDir,nComp));
+            FArrayBox D2aLim(lapBoxDir,nComp,scratch.get(3,lapBoxDir,nComp));
 
             // initialize D2a to be -a_6/(h^2)
             // first compute a_6...
@@ -920,8 +1376,8 @@ GKVlasov::applyMappedLimiter( LevelData<FluxBox>&         a_facePhi,
             //   need to be
             Box growBox( faceBox );
             growBox.grow(dir,1);
-            FArrayBox leftPhi(growBox, nComp);
-            FArrayBox rightPhi(growBox, nComp);
+            FArrayBox leftPhi(growBox, nComp, scratch.get(4, growBox, nComp));
+            FArrayBox rightPhi(growBox, nComp, scratch.get(5, growBox, nComp));
 
             // We operate on the cells of the domain plus one ghost on each
             // end in the current direction
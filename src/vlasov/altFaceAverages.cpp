@@ -17,7 +17,8 @@ void
 bwenoFaceAverages( LevelData<FluxBox>&         a_face_phi,
                    const LevelData<FArrayBox>& a_cell_phi,
                    const LevelData<FluxBox>&   a_face_vel,
-                   const PhaseGeom&            a_geom)
+                   const PhaseGeom&            a_geom,
+                   const bool                  a_exchange )
 {
    CH_assert( a_cell_phi.ghostVect()>=IntVect::Unit );
 
@@ -49,7 +50,10 @@ bwenoFaceAverages( LevelData<FluxBox>&         a_face_phi,
    }
 #endif
 
-   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( grids.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const FArrayBox& this_cell_phi( a_cell_phi[dit] );
       const FluxBox& this_normal_vel( normal_vel[dit] );
       FluxBox& this_face_phi( a_face_phi[dit] );
@@ -80,14 +84,17 @@ bwenoFaceAverages( LevelData<FluxBox>&         a_face_phi,
       } // end loop over directions
    } // end loop over grids
 
-   a_face_phi.exchange();
+   if ( a_exchange ) {
+      a_face_phi.exchange();
+   }
 }
 
 void
 uw5FaceAverages( LevelData<FluxBox>&         a_face_phi,
                  const LevelData<FArrayBox>& a_cell_phi,
                  const LevelData<FluxBox>&   a_face_vel,
-                 const PhaseGeom&            a_geom )
+                 const PhaseGeom&            a_geom,
+                 const bool                  a_exchange )
 {
    CH_assert( a_cell_phi.ghostVect()>=IntVect::Unit );
 
@@ -101,7 +108,10 @@ uw5FaceAverages( LevelData<FluxBox>&         a_face_phi,
    }
    a_geom.computeMetricTermProductAverage( normal_vel, a_face_vel, false );
 
-   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( grids.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const FArrayBox& this_cell_phi( a_cell_phi[dit] );
       const FluxBox& this_normal_vel( normal_vel[dit] );
       FluxBox& this_face_phi( a_face_phi[dit] );
@@ -132,14 +142,17 @@ uw5FaceAverages( LevelData<FluxBox>&         a_face_phi,
       } // end loop over directions
    } // end loop over grids
 
-   a_face_phi.exchange();
+   if ( a_exchange ) {
+      a_face_phi.exchange();
+   }
 }
 
 void
 uw3FaceAverages( LevelData<FluxBox>&         a_face_phi,
                  const LevelData<FArrayBox>& a_cell_phi,
                  const LevelData<FluxBox>&   a_face_vel,
-                 const PhaseGeom&            a_geom )
+                 const PhaseGeom&            a_geom,
+                 const bool                  a_exchange )
 {
    CH_assert( a_cell_phi.ghostVect()>=IntVect::Unit );
 
@@ -153,7 +166,10 @@ uw3FaceAverages( LevelData<FluxBox>&         a_face_phi,
    }
    a_geom.computeMetricTermProductAverage( normal_vel, a_face_vel, false );
 
-   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( grids.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const FArrayBox& this_cell_phi( a_cell_phi[dit] );
       const FluxBox& this_normal_vel( normal_vel[dit] );
       FluxBox& this_face_phi( a_face_phi[dit] );
@@ -184,14 +200,17 @@ uw3FaceAverages( LevelData<FluxBox>&         a_face_phi,
       } // end loop over directions
    } // end loop over grids
 
-   a_face_phi.exchange();
+   if ( a_exchange ) {
+      a_face_phi.exchange();
+   }
 }
 
 void
 uw1FaceAverages( LevelData<FluxBox>&         a_face_phi,
                  const LevelData<FArrayBox>& a_cell_phi,
                  const LevelData<FluxBox>&   a_face_vel,
-                 const PhaseGeom&            a_geom )
+                 const PhaseGeom&            a_geom,
+                 const bool                  a_exchange )
 {
    CH_assert( a_cell_phi.ghostVect()>=IntVect::Unit );
 
@@ -205,7 +224,10 @@ uw1FaceAverages( LevelData<FluxBox>&         a_face_phi,
    }
    a_geom.computeMetricTermProductAverage( normal_vel, a_face_vel, false );
 
-   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( grids.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const FArrayBox& this_cell_phi( a_cell_phi[dit] );
       const FluxBox& this_normal_vel( normal_vel[dit] );
       FluxBox& this_face_phi( a_face_phi[dit] );
@@ -236,14 +258,17 @@ uw1FaceAverages( LevelData<FluxBox>&         a_face_phi,
       } // end loop over directions
    } // end loop over grids
 
-   a_face_phi.exchange();
+   if ( a_exchange ) {
+      a_face_phi.exchange();
+   }
 }
 
 void
 weno5FaceAverages( LevelData<FluxBox>&         a_face_phi,
                    const LevelData<FArrayBox>& a_cell_phi,
                    const LevelData<FluxBox>&   a_face_vel,
-                   const PhaseGeom&            a_geom )
+                   const PhaseGeom&            a_geom,
+                   const bool                  a_exchange )
 {
    CH_assert( a_cell_phi.ghostVect()>=IntVect::Unit );
 
@@ -257,7 +282,10 @@ weno5FaceAverages( LevelData<FluxBox>&         a_face_phi,
    }
    a_geom.computeMetricTermProductAverage( normal_vel, a_face_vel, false );
 
-   for (DataIterator dit( grids.dataIterator() ); dit.ok(); ++dit) {
+   DataIterator boxes( grids.dataIterator() );
+#pragma omp parallel for
+   for (int ibox=0; ibox<boxes.size(); ibox++) {
+      const DataIndex& dit( boxes[ibox] );
       const FArrayBox& this_cell_phi( a_cell_phi[dit] );
       const FluxBox& this_normal_vel( normal_vel[dit] );
       FluxBox& this_face_phi( a_face_phi[dit] );
@@ -288,7 +316,9 @@ weno5FaceAverages( LevelData<FluxBox>&         a_face_phi,
       } // end loop over directions
    } // end loop over grids
 
-   a_face_phi.exchange();
+   if ( a_exchange ) {
+      a_face_phi.exchange();
+   }
 }
 
 #include "NamespaceFooter.H"